@@ -0,0 +1,117 @@
+#ifndef CWEB_COROUTINE_CODEADLINE_H_
+#define CWEB_COROUTINE_CODEADLINE_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <vector>
+#include <utility>
+
+namespace cweb {
+namespace tcpserver {
+namespace coroutine {
+
+class CoEvent;
+class Coroutine;
+
+//嵌入在 CoEvent 中的截止时间节点，协程挂起等待时不需要分配内存
+struct Deadline {
+    static const size_t kNotQueued = (size_t)-1;
+
+    uint64_t expire_us = 0;
+    size_t index = kNotQueued;      //在堆中的下标
+    CoEvent* event = nullptr;
+    Coroutine* co = nullptr;
+    bool timed_out = false;
+
+    bool Queued() const {return index != kNotQueued;}
+};
+
+/*
+ 每个loop一个的截止时间小顶堆，只在loop线程中访问
+ 节点记录自己在堆中的下标，提前唤醒时 O(logn) 删除；数组只在超过历史峰值时扩容
+ */
+class DeadlineQueue {
+private:
+    std::vector<Deadline*> heap_;
+
+    void swap(size_t i, size_t j) {
+        std::swap(heap_[i], heap_[j]);
+        heap_[i]->index = i;
+        heap_[j]->index = j;
+    }
+
+    void up(size_t n) {
+        while(n > 0) {
+            size_t parent = (n - 1) / 2;
+            if(heap_[parent]->expire_us <= heap_[n]->expire_us) break;
+            swap(parent, n);
+            n = parent;
+        }
+    }
+
+    void down(size_t n) {
+        size_t size = heap_.size();
+        while(true) {
+            size_t child = n * 2 + 1;
+            if(child >= size) break;
+            if(child + 1 < size && heap_[child + 1]->expire_us < heap_[child]->expire_us) {
+                ++child;
+            }
+            if(heap_[n]->expire_us <= heap_[child]->expire_us) break;
+            swap(n, child);
+            n = child;
+        }
+    }
+
+public:
+    DeadlineQueue(size_t reserve = 1024) {
+        heap_.reserve(reserve);
+    }
+
+    void Add(Deadline* deadline) {
+        if(deadline->Queued()) Remove(deadline);
+        deadline->index = heap_.size();
+        heap_.push_back(deadline);
+        up(deadline->index);
+    }
+
+    void Remove(Deadline* deadline) {
+        if(!deadline->Queued()) return;
+        size_t n = deadline->index;
+        size_t last = heap_.size() - 1;
+        if(n != last) {
+            swap(n, last);
+        }
+        heap_.pop_back();
+        deadline->index = Deadline::kNotQueued;
+        if(n < heap_.size()) {
+            down(n);
+            up(n);
+        }
+    }
+
+    //弹出一个已到期的节点，没有时返回nullptr
+    Deadline* PopExpired(uint64_t now_us) {
+        if(heap_.empty() || heap_.front()->expire_us > now_us) return nullptr;
+        Deadline* deadline = heap_.front();
+        Remove(deadline);
+        return deadline;
+    }
+
+    //距最近截止时间的毫秒数(向上取整)，没有时返回-1
+    int NextTimeoutMs(uint64_t now_us) const {
+        if(heap_.empty()) return -1;
+        uint64_t expire_us = heap_.front()->expire_us;
+        if(expire_us <= now_us) return 0;
+        return (int)((expire_us - now_us + 999) / 1000);
+    }
+
+    size_t Size() const {return heap_.size();}
+    bool Empty() const {return heap_.empty();}
+};
+
+}
+}
+}
+
+#endif
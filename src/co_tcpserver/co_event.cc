@@ -2,7 +2,6 @@
 #include "timer.h"
 #include "co_eventloop.h"
 #include "coroutine.h"
-#include "co_eventloop.h"
 
 namespace cweb {
 namespace tcpserver {
@@ -11,7 +10,11 @@ namespace coroutine {
 CoEvent::CoEvent(std::shared_ptr<CoEventLoop> loop, int fd, bool is_socket)
 : Event(loop, fd, is_socket) {}
 
-CoEvent::~CoEvent() {}
+CoEvent::~CoEvent() {
+    CoEventLoop* loop = (CoEventLoop*)loop_.get();
+    loop->RemoveDeadline(&read_deadline_);
+    loop->RemoveDeadline(&write_deadline_);
+}
 
 void CoEvent::HandleEvent(Time receiveTime) {
     //处理读写过程中对段关闭的情况
@@ -24,10 +27,10 @@ void CoEvent::HandleEvent(Time receiveTime) {
         if(read_coroutine_) {
             read_coroutine_->SetState(Coroutine::READY);
         }else {
-            read_coroutine_ = new Coroutine([this, receiveTime](){
+            read_coroutine_ = (std::dynamic_pointer_cast<CoEventLoop>(loop_))->NewCoroutine([this, receiveTime](){
                 read_callback_(receiveTime);
             });
-            (std::dynamic_pointer_cast<CoEventLoop>(loop_))->AddCoroutineWithState(read_coroutine_);
+            (std::dynamic_pointer_cast<CoEventLoop>(loop_))->AddCoroutine(read_coroutine_, Coroutine::IO);
         }
     }
     
@@ -36,8 +39,8 @@ void CoEvent::HandleEvent(Time receiveTime) {
         if(write_coroutine_) {
             write_coroutine_->SetState(Coroutine::READY);
         }else {
-            write_coroutine_ = new Coroutine(write_callback_);
-            (std::dynamic_pointer_cast<CoEventLoop>(loop_))->AddCoroutineWithState(write_coroutine_);
+            write_coroutine_ = (std::dynamic_pointer_cast<CoEventLoop>(loop_))->NewCoroutine(write_callback_);
+            (std::dynamic_pointer_cast<CoEventLoop>(loop_))->AddCoroutine(write_coroutine_, Coroutine::IO);
         }
     }
 }
@@ -53,6 +56,50 @@ void CoEvent::TriggerEvent() {
     }
 }
 
+bool CoEvent::Wait(int events, int64_t timeout_ms) {
+    CoEventLoop* loop = (CoEventLoop*)loop_.get();
+    Coroutine* co = loop->GetCurrentCoroutine();
+    if(!co) return false;
+    
+    if(events & READ_EVENT) {
+        read_coroutine_ = co;
+        EnableReading();
+    }
+    if(events & WRITE_EVENT) {
+        write_coroutine_ = co;
+        EnableWriting();
+    }
+    
+    Deadline* deadline = (events & READ_EVENT) ? &read_deadline_ : &write_deadline_;
+    deadline->timed_out = false;
+    if(timeout_ms >= 0) {
+        deadline->event = this;
+        deadline->co = co;
+        deadline->expire_us = Time::Now().MicroSecondsSinceEpoch() + timeout_ms * 1000;
+        loop->AddDeadline(deadline);
+    }
+    
+    co->SetWait((events & READ_EVENT) ? Coroutine::WAIT_READ : Coroutine::WAIT_WRITE, fd_);
+    co->SetState(Coroutine::HOLD);
+    co->SwapTo(loop->GetMainCoroutine());
+    
+    //读写事件先于截止时间到达
+    loop->RemoveDeadline(deadline);
+    if(events & READ_EVENT) read_coroutine_ = nullptr;
+    if(events & WRITE_EVENT) write_coroutine_ = nullptr;
+    return !deadline->timed_out;
+}
+
+void CoEvent::handleDeadline(Deadline* deadline) {
+    Coroutine* co = deadline->co;
+    //同一轮中读写事件已经唤醒了协程
+    if(co->State() != Coroutine::HOLD) return;
+    deadline->timed_out = true;
+    if(read_coroutine_ == co) DisableReading();
+    if(write_coroutine_ == co) DisableWriting();
+    co->SetState(Coroutine::READY);
+}
+
 void CoEvent::SetReadCoroutine(Coroutine *co) {
     if(read_coroutine_ == nullptr) read_coroutine_ = co;
 }
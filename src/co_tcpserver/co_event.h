@@ -2,6 +2,7 @@
 #define CWEB_COROUTINE_COEVENT_H_
 
 #include "event.h"
+#include "co_deadline.h"
 
 namespace cweb {
 namespace tcpserver {
@@ -23,11 +24,25 @@ public:
     void SetWriteCoroutine(Coroutine* co);
     void TriggerEvent();
     bool Triggred() {return triggered_;}
+    //挂起当前协程直到 events(READ_EVENT/WRITE_EVENT) 就绪，timeout_ms < 0 不超时，超时返回false
+    bool Wait(int events, int64_t timeout_ms = -1);
+    
+    //与 SO_RCVTIMEO/SO_SNDTIMEO 语义一致，hook 的读写挂起超过该时间返回 EAGAIN，< 0 不超时
+    void SetReadTimeout(int64_t ms) {read_timeout_ms_ = ms;}
+    void SetWriteTimeout(int64_t ms) {write_timeout_ms_ = ms;}
+    int64_t ReadTimeout() const {return read_timeout_ms_;}
+    int64_t WriteTimeout() const {return write_timeout_ms_;}
 private:
     bool triggered_ = false;
     int flags_ = 0;
     Coroutine* read_coroutine_ = nullptr;
     Coroutine* write_coroutine_ = nullptr;
+    int64_t read_timeout_ms_ = -1;
+    int64_t write_timeout_ms_ = -1;
+    Deadline read_deadline_;
+    Deadline write_deadline_;
+    
+    void handleDeadline(Deadline* deadline);
 };
 
 }
@@ -4,11 +4,35 @@
 #include "timer.h"
 #include "poller.h"
 #include "pthread_keys.h"
+#include "co_sync.h"
+#include <stdio.h>
+#include <algorithm>
 
 namespace cweb {
 namespace tcpserver {
 namespace coroutine {
 
+// 正在运行的loop，用于调试输出
+static std::mutex& loopsMutex() {
+    static std::mutex mutex;
+    return mutex;
+}
+
+static std::vector<CoEventLoop*>& runningLoops() {
+    static std::vector<CoEventLoop*> loops;
+    return loops;
+}
+
+thread_local CoEventLoop* CoEventLoop::current_ = nullptr;
+
+CoEventLoop::CoEventLoop()
+: stack_pool_(new StackPool(config_.max_cached_stacks, config_.stack_guard_size)),
+  steal_deque_(config_.steal_deque_capacity) {
+    if(config_.shared_stack) {
+        stack_pool_->EnableSharedStacks(config_.shared_stack_count, config_.handler_stack_size);
+    }
+}
+
 Coroutine* CoEventLoop::GetMainCoroutine() {
     return main_coroutine_;
 }
@@ -17,48 +41,94 @@ void CoEventLoop::Run() {
     running_ = true;
     createWakeupfd();
     pthread_setspecific(util::PthreadKeysSingleton::GetInstance()->TLSEventLoop, this);
+    current_ = this;
     pthread_setspecific(util::PthreadKeysSingleton::GetInstance()->TLSMemoryPool, memorypool_.get());
-    // 主线程的 执行体为 loop 循环
+    // 主线程的 执行体为 loop 循环，运行在线程栈上，不分配协程栈
     main_coroutine_ = new Coroutine(std::bind(&CoEventLoop::loop, this));
+    last_trim_ms_ = Time::Now().MicroSecondsSinceEpoch() / 1000;
+    {
+        std::unique_lock<std::mutex> lock(loopsMutex());
+        runningLoops().push_back(this);
+    }
     loop();
+    std::unique_lock<std::mutex> lock(loopsMutex());
+    std::vector<CoEventLoop*>& loops = runningLoops();
+    loops.erase(std::remove(loops.begin(), loops.end(), this), loops.end());
+    current_ = nullptr;
+}
+
+Coroutine* CoEventLoop::newCoroutine(Functor cb, size_t stack_size) {
+    if(free_coroutines_.empty()) {
+        return new Coroutine(std::move(cb), nullptr, stack_size);
+    }
+    Coroutine* co = free_coroutines_.back();
+    free_coroutines_.pop_back();
+    co->Reset(std::move(cb), stack_size);
+    return co;
+}
+
+void CoEventLoop::recycleCoroutine(Coroutine* co) {
+    co->Release();
+    std::unique_lock<std::mutex> lock(mutex_);
+    if(free_coroutines_.size() < config_.max_cached_coroutines) {
+        free_coroutines_.push_back(co);
+        return;
+    }
+    lock.unlock();
+    delete co;
 }
 
-void CoEventLoop::AddTaskWithState(Functor cb, bool stateful) {
-    Coroutine* co = new Coroutine(std::move(cb));
+Coroutine* CoEventLoop::NewCoroutine(Functor cb, size_t stack_size) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    return newCoroutine(std::move(cb), stack_size > 0 ? stack_size : config_.handler_stack_size);
+}
+
+// 只在开启统计时读取时钟
+uint64_t CoEventLoop::enqueueTime() {
+    return config_.sched_stats ? Time::Now().MicroSecondsSinceEpoch() : 0;
+}
+
+void CoEventLoop::AddTaskWithPriority(Functor cb, Coroutine::Priority priority, size_t stack_size) {
+    uint64_t now = enqueueTime();
     {
         std::unique_lock<std::mutex> lock(mutex_);
-        if(stateful) {
-            stateful_ready_coroutines_.Push(co);
-        }else {
-            stateless_ready_coroutines_.Push(co);
-        }
+        Coroutine* co = newCoroutine(std::move(cb), stack_size > 0 ? stack_size : config_.handler_stack_size);
+        co->SetPriority(priority);
+        co->SetEnqueueTime(now);
+        ready_coroutines_[priority].Push(co);
     }
     if(!isInLoopThread()) {
         wakeup();
     }
 }
 
-// stateful 默认为true，一般情况下 加入 stateful_ready_coroutines_ 链表
-// 不知道 stateless_ready_coroutines_ 链表的作用
-void CoEventLoop::AddCoroutineWithState(Coroutine* co, bool stateful) {
+void CoEventLoop::AddCoroutine(Coroutine* co, Coroutine::Priority priority) {
+    co->SetPriority(priority);
+    co->SetEnqueueTime(enqueueTime());
     {
         std::unique_lock<std::mutex> lock(mutex_);
-        if(stateful) {
-            stateful_ready_coroutines_.Push(co);
-        }else {
-            stateless_ready_coroutines_.Push(co);
-        }
+        ready_coroutines_[priority].Push(co);
     }
     if(!isInLoopThread()) {
         wakeup();
     }
 }
 
+void CoEventLoop::AddTaskWithState(Functor cb, bool stateful, size_t stack_size) {
+    AddTaskWithPriority(std::move(cb), stateful ? Coroutine::HANDLER : Coroutine::BACKGROUND, stack_size);
+}
+
+void CoEventLoop::AddCoroutineWithState(Coroutine* co, bool stateful) {
+    AddCoroutine(co, stateful ? Coroutine::HANDLER : Coroutine::BACKGROUND);
+}
+
 void CoEventLoop::AddTask(Functor cb) {
-    Coroutine* co = new Coroutine(std::move(cb));
+    uint64_t now = enqueueTime();
     {
         std::unique_lock<std::mutex> lock(mutex_);
-        stateful_ready_coroutines_.Push(co);
+        Coroutine* co = newCoroutine(std::move(cb), config_.task_stack_size);
+        co->SetEnqueueTime(now);
+        ready_coroutines_[Coroutine::HANDLER].Push(co);
     }
     if(!isInLoopThread()) {
         wakeup();
@@ -66,16 +136,166 @@ void CoEventLoop::AddTask(Functor cb) {
 }
 
 void CoEventLoop::AddTasks(std::vector<Functor>& cbs) {
+    uint64_t now = enqueueTime();
     std::unique_lock<std::mutex> lock(mutex_);
     for(Functor cb : cbs) {
-        Coroutine* co = new Coroutine(std::move(cb));
-        stateful_ready_coroutines_.Push(co);
+        Coroutine* co = newCoroutine(std::move(cb), config_.task_stack_size);
+        co->SetEnqueueTime(now);
+        ready_coroutines_[Coroutine::HANDLER].Push(co);
+    }
+    if(!isInLoopThread()) {
+        wakeup();
+    }
+}
+
+void CoEventLoop::AddInlineTask(Functor cb) {
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        inline_tasks_.push_back(std::move(cb));
     }
     if(!isInLoopThread()) {
         wakeup();
     }
 }
 
+void CoEventLoop::AddStealableTask(Functor cb) {
+    if(!config_.work_stealing) {
+        AddTask(std::move(cb));
+        return;
+    }
+    stealable_tasks_.fetch_add(1, std::memory_order_relaxed);
+    //双端队列只能由所属线程压入
+    if(!isInLoopThread()) {
+        AddInlineTask([this, cb](){
+            pushStealable(NewCoroutine(cb, config_.task_stack_size));
+        });
+        return;
+    }
+    pushStealable(NewCoroutine(std::move(cb), config_.task_stack_size));
+}
+
+void CoEventLoop::QueueWaitSnapshot(Coroutine::Priority priority, util::Histogram& out) {
+    std::unique_lock<std::mutex> lock(stats_mutex_);
+    out.Merge(queue_wait_us_[priority]);
+}
+
+void CoEventLoop::HoldTimeSnapshot(Coroutine::WaitReason reason, util::Histogram& out) {
+    std::unique_lock<std::mutex> lock(stats_mutex_);
+    out.Merge(hold_us_[reason]);
+}
+
+void CoEventLoop::DumpHoldCoroutines(std::string& out, size_t limit) {
+    assert(isInLoopThread());
+    std::vector<Coroutine*> groups[Coroutine::kWaitReasonCount];
+    for(Coroutine* co = hold_coroutines_.Front(); co; co = hold_coroutines_.Next(co)) {
+        groups[co->GetWaitReason()].push_back(co);
+    }
+    
+    uint64_t now = Time::Now().MicroSecondsSinceEpoch();
+    char buf[256];
+    snprintf(buf, sizeof(buf), "loop %p: %zu held\n", (void*)this, hold_coroutines_.Size());
+    out += buf;
+    for(int i = 0; i < Coroutine::kWaitReasonCount; ++i) {
+        if(groups[i].empty()) continue;
+        snprintf(buf, sizeof(buf), "  [%s] %zu\n", Coroutine::WaitReasonName((Coroutine::WaitReason)i), groups[i].size());
+        out += buf;
+        for(size_t j = 0; j < groups[i].size() && j < limit; ++j) {
+            Coroutine* co = groups[i][j];
+            //未开启统计时没有挂起起点
+            long long held_ms = co->HoldSince() ? (long long)(now - co->HoldSince()) / 1000 : -1;
+            snprintf(buf, sizeof(buf), "    co=%p fd=%d held_ms=%lld switches=%llu run_us=%llu hold_us=%llu\n",
+                     (void*)co, co->WaitFd(), held_ms, (unsigned long long)co->Switches(),
+                     (unsigned long long)co->RunTime(), (unsigned long long)co->HoldTime());
+            out += buf;
+        }
+        if(groups[i].size() > limit) {
+            out += "    ...\n";
+        }
+    }
+}
+
+void CoEventLoop::DumpAllHoldCoroutines(std::string& out, size_t limit) {
+    std::vector<CoEventLoop*> loops;
+    {
+        std::unique_lock<std::mutex> lock(loopsMutex());
+        loops = runningLoops();
+    }
+    
+    for(CoEventLoop* loop : loops) {
+        if(loop->isInLoopThread()) {
+            loop->DumpHoldCoroutines(out, limit);
+            continue;
+        }
+        //共享栈模式下挂起期间本协程的栈会被换出，其他loop写入的对象不能放在栈上
+        std::shared_ptr<std::string> part = std::make_shared<std::string>();
+        std::shared_ptr<WaitGroup> wg = std::make_shared<WaitGroup>();
+        wg->Add(1);
+        loop->AddInlineTask([loop, part, wg, limit](){
+            loop->DumpHoldCoroutines(*part, limit);
+            wg->Done();
+        });
+        wg->Wait();
+        out += *part;
+    }
+}
+
+void CoEventLoop::SetStealPeers(const std::vector<CoEventLoop*>& peers) {
+    AddInlineTask([this, peers](){
+        steal_peers_.clear();
+        for(CoEventLoop* peer : peers) {
+            if(peer != this) steal_peers_.push_back(peer);
+        }
+    });
+}
+
+void CoEventLoop::pushStealable(Coroutine* co) {
+    co->SetPriority(Coroutine::BACKGROUND);
+    co->SetEnqueueTime(enqueueTime());
+    if(!steal_deque_.Push(co)) {
+        //队列已满，退化为本loop执行
+        pushRunnable(co, Coroutine::BACKGROUND);
+        return;
+    }
+    notifyIdlePeer();
+}
+
+// 与 loop 中 idle_ 的写入配对，保证窃取者要么看到新任务，要么被唤醒
+void CoEventLoop::notifyIdlePeer() {
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    for(CoEventLoop* peer : steal_peers_) {
+        if(peer->idle_.load(std::memory_order_relaxed) && peer->idle_.exchange(false)) {
+            peer->wakeup();
+            return;
+        }
+    }
+}
+
+// 已有可执行的任务时不能阻塞在 Poll 上(例如 wakeup 管道创建前投递的任务)
+bool CoEventLoop::hasPendingWork() {
+    if(hasRunnable() || steal_deque_.Size() > 0) return true;
+    std::unique_lock<std::mutex> lock(mutex_);
+    for(int i = 0; i < Coroutine::kPriorityCount; ++i) {
+        if(ready_coroutines_[i].Size() > 0) return true;
+    }
+    return !inline_tasks_.empty();
+}
+
+// 轮询其他loop，窃取一个协程加入本loop的后台队列
+bool CoEventLoop::stealFromPeers() {
+    size_t size = steal_peers_.size();
+    for(size_t i = 0; i < size; ++i) {
+        CoEventLoop* peer = steal_peers_[(steal_next_ + i) % size];
+        Coroutine* co = peer->steal_deque_.Steal();
+        if(co) {
+            steal_next_ = (steal_next_ + i + 1) % size;
+            steals_.fetch_add(1, std::memory_order_relaxed);
+            pushRunnable(co, Coroutine::BACKGROUND);
+            return true;
+        }
+    }
+    return false;
+}
+
 void CoEventLoop::UpdateEvent(Event *event) {
     events_[((CoEvent*)event)->fd_] = (CoEvent*)event;
     poller_->UpdateEvent(event);
@@ -99,11 +319,53 @@ Coroutine* CoEventLoop::GetCurrentCoroutine() {
     return running_coroutine_;
 }
 
-// 唤醒协程
+// 唤醒协程，挂起前是请求处理协程的作为 I/O 续体优先执行，后台协程仍按后台优先级
 void CoEventLoop::NotifyCoroutineReady(Coroutine *co) {
     assert(isInLoopThread());
     hold_coroutines_.Erase(co);
-    running_coroutines_.Push(co);
+    uint64_t now = enqueueTime();
+    co->SetEnqueueTime(now);
+    if(co->GetWaitReason() != Coroutine::WAIT_NONE) {
+        held_.store(held_.load(std::memory_order_relaxed) - 1, std::memory_order_relaxed);
+        if(now > 0 && co->HoldSince() > 0) {
+            uint64_t hold = now > co->HoldSince() ? now - co->HoldSince() : 0;
+            co->AddHoldTime(hold);
+            local_hold_us_[co->GetWaitReason()].Record(hold);
+            stats_dirty_ = true;
+        }
+        co->SetHoldSince(0);
+        co->SetWait(Coroutine::WAIT_NONE);
+    }
+    pushRunnable(co, co->GetPriority() == Coroutine::BACKGROUND ? Coroutine::BACKGROUND : Coroutine::IO);
+}
+
+void CoEventLoop::pushRunnable(Coroutine* co, int priority) {
+    runnable_coroutines_[priority].Push(co);
+}
+
+bool CoEventLoop::hasRunnable() {
+    for(int i = 0; i < Coroutine::kPriorityCount; ++i) {
+        if(runnable_coroutines_[i].Size() > 0) return true;
+    }
+    return false;
+}
+
+// 严格按优先级取协程，后台协程被饿过一轮时本轮先执行一个
+// 不使用 LinkedList::Pop，Pop 后链表首尾相连，之后无法 Erase
+Coroutine* CoEventLoop::nextRunnable(int& priority) {
+    if(background_starved_ && runnable_coroutines_[Coroutine::BACKGROUND].Size() > 0) {
+        background_starved_ = false;
+        priority = Coroutine::BACKGROUND;
+    }else {
+        priority = 0;
+        while(priority < Coroutine::kPriorityCount && runnable_coroutines_[priority].Size() == 0) {
+            ++priority;
+        }
+        if(priority == Coroutine::kPriorityCount) return nullptr;
+    }
+    Coroutine* co = runnable_coroutines_[priority].Front();
+    runnable_coroutines_[priority].Erase(co);
+    return co;
 }
 
 //主协程
@@ -111,69 +373,101 @@ void CoEventLoop::loop() {
     while(running_) {
         active_events_.clear();
         int timeout = timermanager_->NextTimeoutInterval();
+        int deadline_timeout = deadlines_.NextTimeoutMs(Time::Now().MicroSecondsSinceEpoch());
+        if(deadline_timeout >= 0 && (timeout < 0 || deadline_timeout < timeout)) {
+            timeout = deadline_timeout;
+        }
+        // 先标记空闲再检查是否有可执行的任务，避免与 notifyIdlePeer 之间丢失唤醒
+        idle_.store(true);
+        if(hasPendingWork() || stealFromPeers()) {
+            timeout = 0;
+        }
+        // 即将阻塞时把本地统计合并出去，空闲的loop也能读到最新数据
+        if(timeout != 0) {
+            flushStats(0, true);
+        }
         Time now = poller_->Poll(timeout, active_events_);
+        idle_.store(false, std::memory_order_relaxed);
   
         handleActiveEvents(now);
+        handleDeadlines(now);
         handleTimeoutTimers();
+        handleInlineTasks();
+        trimStacks();
+        flushStats(now.MicroSecondsSinceEpoch() / 1000, false);
         
-        // 取出可执行的协程
-        running_coroutine_ = running_coroutines_.Front();
+        runCoroutines();
+    }
+}
 
-        if(!running_coroutine_) {
-            // running_coroutines_ 长度为0，将 ready 状态的协程 移动至 runing
-            moveReadyCoroutines();
-            running_coroutine_ = running_coroutines_.Front();
+// 执行就绪协程，批次或时间片用完后回到 Poll，避免不挂起的协程饿死网络事件
+void CoEventLoop::runCoroutines() {
+    moveReadyCoroutines();
+    bool timed = config_.sched_stats || config_.run_slice_us > 0;
+    uint64_t now = timed ? Time::Now().MicroSecondsSinceEpoch() : 0;
+    uint64_t slice_end = config_.run_slice_us > 0 ? now + config_.run_slice_us : 0;
+    size_t batch = 0;
+    bool background_ran = false;
+    int priority = 0;
+    
+    while(running_ && (running_coroutine_ = nextRunnable(priority))) {
+        if(config_.sched_stats && running_coroutine_->EnqueueTime() > 0) {
+            uint64_t enqueue = running_coroutine_->EnqueueTime();
+            local_queue_wait_us_[priority].Record(now > enqueue ? now - enqueue : 0);
+            stats_dirty_ = true;
         }
+        if(priority == Coroutine::BACKGROUND) background_ran = true;
         
-        while(running_coroutine_ && running_) {
-            running_coroutine_->SetLoop(std::dynamic_pointer_cast<CoEventLoop>(shared_from_this()));
-            // 主协程 切换 至 子协程
-            // running_coroutine_ 会设置 状态为 EXEC
-            // 保存 主协程 loop 函数栈， 替换为 子协程 fn 方法栈
-            main_coroutine_->SwapTo(running_coroutine_);
-            
-            // 这里应该是 子协程 替换回 主协程 main_coroutine_ 才继续执行
-            switch (running_coroutine_->State()) {
-                case Coroutine::State::EXEC: {
-                    next_coroutine_ = running_coroutines_.Next(running_coroutine_);
-                    if(!next_coroutine_) {
-                        moveReadyCoroutines();
-                        next_coroutine_ = running_coroutines_.Next(running_coroutine_);
-                    }
-                    
-                    running_coroutine_ = next_coroutine_;
-                }
-                    break;
-                case Coroutine::State::HOLD: {
-                    // 将当前协程挂起，加入 hold_coroutines_
-                    running_coroutines_.Erase(running_coroutine_);
-                    hold_coroutines_.Push(running_coroutine_);
-                    next_coroutine_ = running_coroutines_.Next(running_coroutine_);
-                    if(!next_coroutine_) {
-                        moveReadyCoroutines();
-                        next_coroutine_ = running_coroutines_.Next(running_coroutine_);
-                    }
-                    running_coroutine_ = next_coroutine_;
-                }
-                    break;
-                    
-                case Coroutine::State::TERM:
-                default: {
-                    next_coroutine_ = running_coroutines_.Next(running_coroutine_);
-                    if(!next_coroutine_) {
-                        moveReadyCoroutines();
-                        next_coroutine_ = running_coroutines_.Next(running_coroutine_);
-                    }
-                    
-                    running_coroutines_.Erase(running_coroutine_);
-                    delete running_coroutine_;
-                    running_coroutine_ = next_coroutine_;
-                    
+        running_coroutine_->SetLoop(this);
+        // 主协程 切换 至 子协程，子协程挂起、让出或结束后切换回来
+        main_coroutine_->SwapTo(running_coroutine_);
+        resumes_.store(resumes_.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        if(timed) {
+            uint64_t start = now;
+            now = Time::Now().MicroSecondsSinceEpoch();
+            if(config_.sched_stats) running_coroutine_->AddRunTime(now - start);
+        }
+        
+        switch (running_coroutine_->State()) {
+            case Coroutine::State::READY:
+            case Coroutine::State::EXEC: {
+                // Yield 让出，按自身优先级排到队列末尾，I/O 续体让出后不再享有 IO 优先级
+                yields_.store(yields_.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+                running_coroutine_->SetEnqueueTime(now);
+                pushRunnable(running_coroutine_, running_coroutine_->GetPriority());
+            }
+                break;
+            case Coroutine::State::HOLD: {
+                if(running_coroutine_->GetWaitReason() == Coroutine::WAIT_NONE) {
+                    running_coroutine_->SetWait(Coroutine::WAIT_OTHER);
                 }
-                    break;
+                running_coroutine_->SetHoldSince(config_.sched_stats ? now : 0);
+                held_.store(held_.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+                hold_coroutines_.Push(running_coroutine_);
+            }
+                break;
+                
+            case Coroutine::State::TERM:
+            default: {
+                recycleCoroutine(running_coroutine_);
             }
+                break;
+        }
+        
+        if((config_.run_batch > 0 && ++batch >= config_.run_batch) || (slice_end > 0 && now >= slice_end)) {
+            budget_exhausted_.store(budget_exhausted_.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+            break;
+        }
+        // 本轮的协程都执行完后再取一次期间投递的协程
+        if(!hasRunnable()) {
+            moveReadyCoroutines();
         }
     }
+    running_coroutine_ = nullptr;
+    
+    if(runnable_coroutines_[Coroutine::BACKGROUND].Size() > 0 && !background_ran) {
+        background_starved_ = true;
+    }
 }
 
 void CoEventLoop::handleActiveEvents(Time time) {
@@ -184,27 +478,82 @@ void CoEventLoop::handleActiveEvents(Time time) {
 
 void CoEventLoop::handleTimeoutTimers() {
     //timermanager_->ExecuteAllTimeoutTimer();
+    // 定时器回调(超时唤醒、sleep唤醒等)都不会挂起，直接在主协程中执行，不再为每个定时器创建协程
     std::vector<Timer*> timeouts;
     if(timermanager_->PopAllTimeoutTimer(timeouts)) {
         for(Timer* timeout : timeouts) {
-            AddTask([timeout, this](){
-                timeout->Execute();;
-                RemoveTimer(timeout);
-            });
+            timeout->Execute();
+            RemoveTimer(timeout);
         }
     }
 }
 
-// 将 stateful_ready_coroutines_ 协程 加入 running_coroutines_
+// 在读写事件之后处理，同一轮中已就绪的协程不会被判定超时
+void CoEventLoop::handleDeadlines(Time now) {
+    Deadline* deadline = nullptr;
+    while((deadline = deadlines_.PopExpired(now.MicroSecondsSinceEpoch()))) {
+        deadline->event->handleDeadline(deadline);
+    }
+}
+
+void CoEventLoop::handleInlineTasks() {
+    std::vector<Functor> tasks;
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        if(inline_tasks_.empty()) return;
+        tasks.swap(inline_tasks_);
+    }
+    
+    for(Functor& task : tasks) {
+        task();
+    }
+}
+
+// 每100ms合并一次，读取方看到的统计最多延迟100ms
+void CoEventLoop::flushStats(uint64_t now_ms, bool force) {
+    if(!stats_dirty_) return;
+    if(!force && now_ms - last_stats_flush_ms_ < 100) return;
+    last_stats_flush_ms_ = now_ms;
+    stats_dirty_ = false;
+    
+    std::unique_lock<std::mutex> lock(stats_mutex_);
+    for(int i = 0; i < Coroutine::kPriorityCount; ++i) {
+        if(local_queue_wait_us_[i].Count() == 0) continue;
+        queue_wait_us_[i].Merge(local_queue_wait_us_[i]);
+        local_queue_wait_us_[i].Reset();
+    }
+    for(int i = 0; i < Coroutine::kWaitReasonCount; ++i) {
+        if(local_hold_us_[i].Count() == 0) continue;
+        hold_us_[i].Merge(local_hold_us_[i]);
+        local_hold_us_[i].Reset();
+    }
+}
+
+// 定期把长时间空闲的缓存栈归还物理内存
+void CoEventLoop::trimStacks() {
+    uint64_t now = Time::Now().MicroSecondsSinceEpoch() / 1000;
+    if(now - last_trim_ms_ < config_.stack_trim_idle_ms) return;
+    last_trim_ms_ = now;
+    stack_pool_->Trim(config_.stack_trim_idle_ms);
+}
+
+// 将跨线程投递的就绪协程批量移入本loop的执行队列
 void CoEventLoop::moveReadyCoroutines() {
-    std::unique_lock<std::mutex> lock(mutex_);
-    size_t size = stateful_ready_coroutines_.Size();
-    if(size > 0) {
-        running_coroutines_.Push(stateful_ready_coroutines_);
+    size_t size = 0;
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        for(int i = 0; i < Coroutine::kPriorityCount; ++i) {
+            if(ready_coroutines_[i].Size() > 0) {
+                size += ready_coroutines_[i].Size();
+                runnable_coroutines_[i].Push(ready_coroutines_[i]);
+            }
+        }
     }
     
-    if(size < 5 && stateless_ready_coroutines_.Size() > 0) {
-        running_coroutines_.Push(stateless_ready_coroutines_);
+    // 没有其他就绪协程时，每次只从可窃取队列中取一个，剩余的留给空闲的loop
+    if(size == 0 && !hasRunnable()) {
+        Coroutine* co = steal_deque_.Pop();
+        if(co) pushRunnable(co, Coroutine::BACKGROUND);
     }
 }
 
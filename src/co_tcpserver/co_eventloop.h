@@ -5,6 +5,12 @@
 #include "linked_list.h"
 #include <unordered_map>
 #include "coroutine.h"
+#include "coroutine_stack.h"
+#include "cweb_config.h"
+#include "work_stealing_deque.h"
+#include "co_deadline.h"
+#include "histogram.h"
+#include <atomic>
 #include <pthread.h>
 
 namespace cweb {
@@ -17,36 +23,126 @@ class Coroutine;
 class CoEventLoop : public EventLoop {
 private:
     Coroutine* running_coroutine_ = nullptr;
-    Coroutine* next_coroutine_ = nullptr;
     Coroutine* main_coroutine_ = nullptr;
 
     std::unordered_map<int, CoEvent*> events_;      // <fd : CoEvent*>
-    util::LinkedList<Coroutine> running_coroutines_;
     util::LinkedList<Coroutine> hold_coroutines_;
-    util::LinkedList<Coroutine> stateful_ready_coroutines_;
-    util::LinkedList<Coroutine> stateless_ready_coroutines_;
+    // 按优先级分开的就绪队列：ready_coroutines_ 接收任意线程投递，由mutex_保护；
+    // 每轮批量移入只在loop线程访问的 runnable_coroutines_ 后按优先级执行
+    util::LinkedList<Coroutine> ready_coroutines_[Coroutine::kPriorityCount];
+    util::LinkedList<Coroutine> runnable_coroutines_[Coroutine::kPriorityCount];
+    bool background_starved_ = false;               // 上一轮有后台协程等待却没有执行
     
+    CoroutineConfig config_;
+    std::unique_ptr<StackPool> stack_pool_;
+    uint64_t last_trim_ms_ = 0;
+    
+    std::vector<Coroutine*> free_coroutines_;       // 已结束可复用的协程 由mutex_保护
+    std::vector<Functor> inline_tasks_;             // 直接在主协程中执行的任务 由mutex_保护
+    DeadlineQueue deadlines_;                       // 挂起读写的超时，只在loop线程中访问
+    
+    // 可被其他loop窃取的协程，只存放尚未开始执行的协程(栈、连接都还没有绑定到本loop)
+    util::WorkStealingDeque<Coroutine> steal_deque_;
+    std::vector<CoEventLoop*> steal_peers_;         // 只在loop线程中访问
+    size_t steal_next_ = 0;
+    std::atomic<bool> idle_ = {false};              // 即将阻塞在 Poll 上
+    std::atomic<uint64_t> stealable_tasks_ = {0};
+    std::atomic<uint64_t> steals_ = {0};
+    
+    // 调度统计，计数只由loop线程写入
+    std::atomic<uint64_t> resumes_ = {0};
+    std::atomic<uint64_t> yields_ = {0};
+    std::atomic<uint64_t> budget_exhausted_ = {0};
+    std::atomic<uint64_t> held_ = {0};
+    std::mutex stats_mutex_;
+    util::Histogram queue_wait_us_[Coroutine::kPriorityCount];     // 由stats_mutex_保护
+    util::Histogram hold_us_[Coroutine::kWaitReasonCount];         // 由stats_mutex_保护
+    // 切换路径上只写loop线程本地的直方图，定期或即将阻塞在 Poll 上时合并到上面两组
+    util::Histogram local_queue_wait_us_[Coroutine::kPriorityCount];
+    util::Histogram local_hold_us_[Coroutine::kWaitReasonCount];
+    bool stats_dirty_ = false;
+    uint64_t last_stats_flush_ms_ = 0;
+    
+    static thread_local CoEventLoop* current_;
+    
+    //需持有 mutex_
+    Coroutine* newCoroutine(Functor cb, size_t stack_size);
+    void recycleCoroutine(Coroutine* co);
     void moveReadyCoroutines();
+    bool hasRunnable();
+    Coroutine* nextRunnable(int& priority);
+    void pushRunnable(Coroutine* co, int priority);
+    void runCoroutines();
+    uint64_t enqueueTime();
+    void flushStats(uint64_t now_ms, bool force);
+    void trimStacks();
+    void pushStealable(Coroutine* co);
+    bool hasPendingWork();
+    bool stealFromPeers();
+    void notifyIdlePeer();
 
 protected:
     void loop();
     void handleActiveEvents(Time time);
     void handleTasks();
     void handleTimeoutTimers();
+    void handleInlineTasks();
+    void handleDeadlines(Time now);
     
 public:
+    CoEventLoop();
+    
     CoEvent* GetEvent(int fd);
     virtual void Run() override;
-    void AddTaskWithState(Functor cb, bool stateful = true);
+    //stack_size 为0时使用处理协程的栈大小，AddTask 使用轻量任务栈
+    void AddTaskWithPriority(Functor cb, Coroutine::Priority priority, size_t stack_size = 0);
+    void AddCoroutine(Coroutine* co, Coroutine::Priority priority);
+    //stateful 为 HANDLER 优先级，否则为 BACKGROUND
+    void AddTaskWithState(Functor cb, bool stateful = true, size_t stack_size = 0);
     void AddCoroutineWithState(Coroutine* co, bool stateful = true);
+    //不经过协程，直接在主协程中执行，cb 中不能调用会挂起的 hook 函数(read/write/sleep 等)
+    void AddInlineTask(Functor cb);
+    //计算密集、不绑定连接的任务，本loop忙时可被空闲的loop窃取执行
+    void AddStealableTask(Functor cb);
+    //设置可以互相窃取的loop，线程安全
+    void SetStealPeers(const std::vector<CoEventLoop*>& peers);
+    uint64_t StealableTasks() const {return stealable_tasks_.load(std::memory_order_relaxed);}
+    uint64_t Steals() const {return steals_.load(std::memory_order_relaxed);}
+    int64_t StealQueueSize() const {return steal_deque_.Size();}
+    uint64_t Resumes() const {return resumes_.load(std::memory_order_relaxed);}
+    uint64_t Yields() const {return yields_.load(std::memory_order_relaxed);}
+    //因批次或时间片用完而提前回到 Poll 的次数
+    uint64_t BudgetExhausted() const {return budget_exhausted_.load(std::memory_order_relaxed);}
+    //各优先级协程从进入就绪队列到被执行的等待时间(微秒)，线程安全，最多延迟100ms
+    void QueueWaitSnapshot(Coroutine::Priority priority, util::Histogram& out);
+    //各等待原因的挂起时长(微秒)，线程安全，最多延迟100ms
+    void HoldTimeSnapshot(Coroutine::WaitReason reason, util::Histogram& out);
+    uint64_t HeldCoroutines() const {return held_.load(std::memory_order_relaxed);}
+    //按等待原因分组输出挂起的协程，每组最多 limit 个，只能在loop线程中调用
+    void DumpHoldCoroutines(std::string& out, size_t limit = 100);
+    //输出所有运行中loop的挂起协程，在协程中调用时挂起等待各loop填写，不能在loop的主协程中调用
+    static void DumpAllHoldCoroutines(std::string& out, size_t limit = 100);
+    //优先从缓存中取已结束的协程
+    Coroutine* NewCoroutine(Functor cb, size_t stack_size = 0);
     virtual void AddTask(Functor cb) override;
     virtual void AddTasks(std::vector<Functor>& cbs) override;
     virtual void UpdateEvent(Event* event) override;
     virtual void RemoveEvent(Event* event) override;
     
+    //当前线程运行的loop，不在loop线程中时为nullptr
+    static CoEventLoop* Current() {return current_;}
     void NotifyCoroutineReady(Coroutine* co);
     Coroutine* GetCurrentCoroutine();
     Coroutine* GetMainCoroutine();
+    //只能在loop线程中调用
+    void AddDeadline(Deadline* deadline) {deadlines_.Add(deadline);}
+    void RemoveDeadline(Deadline* deadline) {deadlines_.Remove(deadline);}
+    size_t PendingDeadlines() const {return deadlines_.Size();}
+    int64_t ReadTimeoutMs() const {return config_.read_timeout_ms;}
+    int64_t WriteTimeoutMs() const {return config_.write_timeout_ms;}
+    StackPool* GetStackPool() const {return stack_pool_.get();}
+    size_t HandlerStackSize() const {return config_.handler_stack_size;}
+    size_t TaskStackSize() const {return config_.task_stack_size;}
 
 };
 
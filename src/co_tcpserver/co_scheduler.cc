@@ -1,6 +1,7 @@
 #include "co_scheduler.h"
 #include "co_eventloop.h"
 #include "co_eventloop_thread.h"
+#include "metrics.h"
 
 namespace cweb {
 namespace tcpserver {
@@ -9,12 +10,48 @@ namespace coroutine {
 CoScheduler::CoScheduler(std::shared_ptr<CoEventLoop> baseloop, int threadcnt)
 : Scheduler(baseloop, threadcnt) {}
 
+CoScheduler::~CoScheduler() {
+    util::MetricsRegistrySingleton::GetInstance()->Unregister("coroutine_scheduler");
+}
+
 void CoScheduler::Start() {
+    std::vector<CoEventLoop*> peers;
     for(int i = 0; i < threadcnt_; ++i) {
         std::unique_ptr<CoEventLoopThread> thread(new CoEventLoopThread());
         loops_.push_back(thread->StartLoop());
         threads_.push_back(std::move(thread));
+        peers.push_back((CoEventLoop*)loops_.back().get());
+    }
+    
+    // 工作线程之间互相窃取，accept loop 不参与
+    for(CoEventLoop* loop : peers) {
+        loop->SetStealPeers(peers);
     }
+    
+    util::MetricsRegistrySingleton::GetInstance()->Register("coroutine_scheduler", [peers](std::string& out){
+        for(size_t i = 0; i < peers.size(); ++i) {
+            std::string labels = "loop=\"" + std::to_string(i) + "\"";
+            util::MetricsRegistry::AppendCounter(out, "cweb_coroutine_stealable_tasks_total", labels, peers[i]->StealableTasks());
+            util::MetricsRegistry::AppendCounter(out, "cweb_coroutine_steals_total", labels, peers[i]->Steals());
+            util::MetricsRegistry::AppendGauge(out, "cweb_coroutine_steal_queue_size", labels, (double)peers[i]->StealQueueSize());
+            util::MetricsRegistry::AppendCounter(out, "cweb_coroutine_resumes_total", labels, peers[i]->Resumes());
+            util::MetricsRegistry::AppendCounter(out, "cweb_coroutine_yields_total", labels, peers[i]->Yields());
+            util::MetricsRegistry::AppendCounter(out, "cweb_coroutine_budget_exhausted_total", labels, peers[i]->BudgetExhausted());
+            static const char* classes[Coroutine::kPriorityCount] = {"io", "handler", "background"};
+            for(int c = 0; c < Coroutine::kPriorityCount; ++c) {
+                util::Histogram wait;
+                peers[i]->QueueWaitSnapshot((Coroutine::Priority)c, wait);
+                util::MetricsRegistry::AppendSummary(out, "cweb_coroutine_queue_wait_us", labels + ",class=\"" + classes[c] + "\"", wait);
+            }
+            util::MetricsRegistry::AppendGauge(out, "cweb_coroutine_held", labels, (double)peers[i]->HeldCoroutines());
+            for(int r = Coroutine::WAIT_NONE + 1; r < Coroutine::kWaitReasonCount; ++r) {
+                util::Histogram hold;
+                peers[i]->HoldTimeSnapshot((Coroutine::WaitReason)r, hold);
+                if(hold.Count() == 0) continue;
+                util::MetricsRegistry::AppendSummary(out, "cweb_coroutine_hold_us", labels + ",reason=\"" + Coroutine::WaitReasonName((Coroutine::WaitReason)r) + "\"", hold);
+            }
+        }
+    });
 }
 
 }
@@ -15,6 +15,7 @@ private:
 
 public:
     CoScheduler(std::shared_ptr<CoEventLoop> baseloop, int threadcnt);
+    virtual ~CoScheduler();
     virtual void Start() override;
     
 };
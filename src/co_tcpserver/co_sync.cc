@@ -0,0 +1,138 @@
+#include "co_sync.h"
+#include "coroutine.h"
+#include "co_eventloop.h"
+#include <assert.h>
+
+namespace cweb {
+namespace tcpserver {
+namespace coroutine {
+
+void WaitQueue::Wait(std::unique_lock<std::mutex>& lock) {
+    CoEventLoop* loop = CoEventLoop::Current();
+    Coroutine* co = loop ? loop->GetCurrentCoroutine() : nullptr;
+
+    Waiter waiter;
+    if(co) {
+        waiter.co = co;
+        waiter.loop = loop;
+        waiters_.push_back(waiter);
+        lock.unlock();
+        // 唤醒只会在切回主协程之后发生：同loop的唤醒方此时不可能在运行，其他线程的唤醒投递到本loop的 inline 任务中
+        co->SetWait(Coroutine::WAIT_SYNC);
+        co->SetState(Coroutine::HOLD);
+        co->SwapTo(loop->GetMainCoroutine());
+        return;
+    }
+
+    // 主协程或普通线程，阻塞线程
+    ThreadWaiter thread_waiter;
+    waiter.thread = &thread_waiter;
+    waiters_.push_back(waiter);
+    lock.unlock();
+
+    std::unique_lock<std::mutex> thread_lock(thread_waiter.mutex);
+    while(!thread_waiter.notified) {
+        thread_waiter.cond.wait(thread_lock);
+    }
+}
+
+void WaitQueue::resume(const Waiter& waiter) {
+    if(waiter.thread) {
+        std::unique_lock<std::mutex> lock(waiter.thread->mutex);
+        waiter.thread->notified = true;
+        waiter.thread->cond.notify_one();
+        return;
+    }
+
+    CoEventLoop* current = CoEventLoop::Current();
+    Coroutine* co = waiter.co;
+    if(current == waiter.loop) {
+        co->SetState(Coroutine::READY);
+    }else {
+        waiter.loop->AddInlineTask([co](){
+            co->SetState(Coroutine::READY);
+        });
+    }
+}
+
+bool WaitQueue::NotifyOne() {
+    if(waiters_.empty()) return false;
+    Waiter waiter = waiters_.front();
+    waiters_.pop_front();
+    resume(waiter);
+    return true;
+}
+
+size_t WaitQueue::NotifyAll() {
+    size_t size = waiters_.size();
+    while(!waiters_.empty()) {
+        NotifyOne();
+    }
+    return size;
+}
+
+void CoMutex::lock() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    if(!locked_) {
+        locked_ = true;
+        return;
+    }
+    // 被唤醒时锁已经转交给当前等待者
+    waiters_.Wait(lock);
+}
+
+bool CoMutex::try_lock() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    if(locked_) return false;
+    locked_ = true;
+    return true;
+}
+
+void CoMutex::unlock() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    assert(locked_);
+    if(!waiters_.NotifyOne()) {
+        locked_ = false;
+    }
+}
+
+// 先进入等待队列再释放 CoMutex，唤醒方需要 mutex_ 才能通知，不会丢失唤醒
+void CoCondition::wait(std::unique_lock<CoMutex>& lock) {
+    std::unique_lock<std::mutex> guard(mutex_);
+    lock.unlock();
+    waiters_.Wait(guard);
+    lock.lock();
+}
+
+void CoCondition::notify_one() {
+    std::unique_lock<std::mutex> guard(mutex_);
+    waiters_.NotifyOne();
+}
+
+void CoCondition::notify_all() {
+    std::unique_lock<std::mutex> guard(mutex_);
+    waiters_.NotifyAll();
+}
+
+void WaitGroup::Add(int64_t n) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    count_ += n;
+    assert(count_ >= 0);
+    if(count_ == 0) {
+        waiters_.NotifyAll();
+    }
+}
+
+void WaitGroup::Done() {
+    Add(-1);
+}
+
+void WaitGroup::Wait() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    if(count_ == 0) return;
+    waiters_.Wait(lock);
+}
+
+}
+}
+}
@@ -0,0 +1,172 @@
+#ifndef CWEB_COROUTINE_COSYNC_H_
+#define CWEB_COROUTINE_COSYNC_H_
+
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+#include "noncopyable.h"
+
+namespace cweb {
+namespace tcpserver {
+namespace coroutine {
+
+/*
+ 协程同步原语
+ 在协程中等待时只挂起当前协程(HOLD)，由唤醒方通过 NotifyCoroutineReady 恢复，其他线程的唤醒投递到协程所在loop执行
+ 在主协程或非loop线程中等待时退化为阻塞线程，因此线程版代码、初始化代码也可以直接使用
+ 等待者信息保存在原语内部而不是协程栈上，共享栈模式下同样可用
+ */
+class Coroutine;
+class CoEventLoop;
+
+struct ThreadWaiter {
+    std::mutex mutex;
+    std::condition_variable cond;
+    bool notified = false;
+};
+
+struct Waiter {
+    Coroutine* co = nullptr;
+    CoEventLoop* loop = nullptr;
+    ThreadWaiter* thread = nullptr;
+};
+
+//等待队列，所有方法都需要在持有外部锁时调用
+class WaitQueue : public util::Noncopyable {
+private:
+    std::deque<Waiter> waiters_;
+
+    static void resume(const Waiter& waiter);
+
+public:
+    //加入队列并释放 lock，被唤醒后返回，返回时不持有锁
+    void Wait(std::unique_lock<std::mutex>& lock);
+    bool NotifyOne();
+    size_t NotifyAll();
+    bool Empty() const {return waiters_.empty();}
+    size_t Size() const {return waiters_.size();}
+};
+
+//接口与 std::mutex 一致，可配合 std::unique_lock / std::lock_guard 使用
+//解锁时直接把锁交给队首等待者，避免被唤醒的协程再次竞争
+class CoMutex : public util::Noncopyable {
+private:
+    std::mutex mutex_;
+    bool locked_ = false;
+    WaitQueue waiters_;
+
+public:
+    void lock();
+    bool try_lock();
+    void unlock();
+};
+
+//接口与 std::condition_variable 一致
+class CoCondition : public util::Noncopyable {
+private:
+    std::mutex mutex_;
+    WaitQueue waiters_;
+
+public:
+    void wait(std::unique_lock<CoMutex>& lock);
+
+    template <typename Predicate>
+    void wait(std::unique_lock<CoMutex>& lock, Predicate pred) {
+        while(!pred()) {
+            wait(lock);
+        }
+    }
+
+    void notify_one();
+    void notify_all();
+};
+
+//有缓冲通道，满时 Push 挂起，空时 Pop 挂起，关闭后唤醒所有等待者
+template <typename T>
+class Channel : public util::Noncopyable {
+private:
+    std::mutex mutex_;
+    std::deque<T> queue_;
+    size_t capacity_;
+    bool closed_ = false;
+    WaitQueue senders_;
+    WaitQueue receivers_;
+
+public:
+    Channel(size_t capacity = 1) : capacity_(capacity > 0 ? capacity : 1) {}
+
+    //通道已关闭时返回false
+    bool Push(T val) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        while(!closed_ && queue_.size() >= capacity_) {
+            senders_.Wait(lock);
+            lock.lock();
+        }
+        if(closed_) return false;
+        queue_.push_back(std::move(val));
+        receivers_.NotifyOne();
+        return true;
+    }
+
+    //通道已关闭且为空时返回false
+    bool Pop(T& val) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        while(!closed_ && queue_.empty()) {
+            receivers_.Wait(lock);
+            lock.lock();
+        }
+        if(queue_.empty()) return false;
+        val = std::move(queue_.front());
+        queue_.pop_front();
+        senders_.NotifyOne();
+        return true;
+    }
+
+    bool TryPush(T val) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        if(closed_ || queue_.size() >= capacity_) return false;
+        queue_.push_back(std::move(val));
+        receivers_.NotifyOne();
+        return true;
+    }
+
+    bool TryPop(T& val) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        if(queue_.empty()) return false;
+        val = std::move(queue_.front());
+        queue_.pop_front();
+        senders_.NotifyOne();
+        return true;
+    }
+
+    void Close() {
+        std::unique_lock<std::mutex> lock(mutex_);
+        closed_ = true;
+        senders_.NotifyAll();
+        receivers_.NotifyAll();
+    }
+
+    size_t Size() {
+        std::unique_lock<std::mutex> lock(mutex_);
+        return queue_.size();
+    }
+};
+
+//等待一组任务完成
+class WaitGroup : public util::Noncopyable {
+private:
+    std::mutex mutex_;
+    int64_t count_ = 0;
+    WaitQueue waiters_;
+
+public:
+    void Add(int64_t n = 1);
+    void Done();
+    void Wait();
+};
+
+}
+}
+}
+
+#endif
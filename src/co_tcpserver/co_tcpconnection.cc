@@ -3,8 +3,10 @@
 #include "co_eventloop.h"
 #include "socket.h"
 #include "logger.h"
+#include "trace.h"
 
 using namespace cweb::log;
+using namespace cweb::util;
 
 namespace cweb {
 namespace tcpserver {
@@ -72,14 +74,25 @@ void CoTcpConnection::handleTimeout() {
 }
 
 void CoTcpConnection::handleMessage() {
+    //其他协程关闭连接后本协程才被唤醒，唤醒后还要访问 event_，连接要等读循环退出后才能释放
+    std::shared_ptr<TcpConnection> self = shared_from_this();
     event_.reset(new CoEvent(std::dynamic_pointer_cast<CoEventLoop>(ownerloop_), socket_->Fd(), true));
-    event_->SetTimeoutCallback(std::bind(&CoTcpConnection::handleTimeout, this));
+    std::shared_ptr<CoEventLoop> loop = std::dynamic_pointer_cast<CoEventLoop>(ownerloop_);
+    ((CoEvent*)event_.get())->SetReadTimeout(loop->ReadTimeoutMs());
+    ((CoEvent*)event_.get())->SetWriteTimeout(loop->WriteTimeoutMs());
     ownerloop_->UpdateEvent(event_.get());
     connect_state_ = CONNECT;
     connected_callback_(shared_from_this());
     while(Connected()) {
+        ((CoEvent*)event_.get())->SetReadTimeout(idle_timeout_ms_ >= 0 ? idle_timeout_ms_ : loop->ReadTimeoutMs());
+        uint64_t read_start = TracerSingleton::GetInstance()->Enabled() ? Tracer::NowMicros() : 0;
         ssize_t n = inputbuffer_->Readv(socket_->Fd());
         if(n > 0) {
+            //协程版 read 会挂起等待数据，耗时包含等待时间
+            trace_sampled_ = read_start > 0 && TracerSingleton::GetInstance()->Sample();
+            if(trace_sampled_) {
+                TracerSingleton::GetInstance()->Record("read", read_start, Tracer::NowMicros() - read_start);
+            }
             Time time = Time::Now();
             LOG(LOGLEVEL_INFO, CWEB_MODULE, "cotcpconnection", "conn: %s 获取数据", id_.c_str());
             //sleep(3);
@@ -94,6 +107,10 @@ void CoTcpConnection::handleMessage() {
             LOG(LOGLEVEL_INFO, CWEB_MODULE, "cotcpconnection", "conn: %s 对端主动关闭", id_.c_str());
             handleClose();
             break;
+        }else if(errno == EAGAIN) {
+            //读超时由调用方决定如何处理，空闲连接直接关闭
+            handleTimeout();
+            break;
         }else {
             LOG(LOGLEVEL_WARN, CWEB_MODULE, "cotcpconnection", "conn: %s 数据读取时出错", id_.c_str());
             handleClose();
@@ -5,10 +5,12 @@
 #include "co_event.h"
 #include "socket.h"
 #include "logger.h"
+#include "trace.h"
 #include <boost/uuid/uuid.hpp>
 #include <boost/uuid/uuid_io.hpp>
 
 using namespace cweb::log;
+using namespace cweb::util;
 
 namespace cweb {
 namespace tcpserver {
@@ -45,6 +47,8 @@ void CoTcpServer::handleAccept() {
         InetAddress* peeraddr = new InetAddress();
 
         int connfd = accept_socket_->Accept(peeraddr);
+        //accept 在无连接时会挂起协程，只统计拿到连接之后的部分
+        TRACE_SCOPE(TracerSingleton::GetInstance()->Sample(), "accept");
     
         Socket* socket = nullptr;
         if(connfd > 0) socket = new Socket(connfd);
@@ -63,12 +67,12 @@ void CoTcpServer::handleAccept() {
         conn->SetCloseCallback(std::bind(&CoTcpServer::handleConnectionClose, this, std::placeholders::_1));
         conn->SetConnectedCallback(connected_callback_);
         living_connections_[id] = conn;
-        loop->AddTask(std::bind(&CoTcpConnection::handleMessage, conn.get()));
+        loop->AddTaskWithState(std::bind(&CoTcpConnection::handleMessage, conn.get()));
     }
 }
 
 void CoTcpServer::handleConnectionClose(std::shared_ptr<TcpConnection> conn) {
-    accept_loop_->AddTask(std::bind(&CoTcpServer::removeConnectionInLoop, this, conn));
+    std::dynamic_pointer_cast<CoEventLoop>(accept_loop_)->AddInlineTask(std::bind(&CoTcpServer::removeConnectionInLoop, this, conn));
 }
 
 void CoTcpServer::removeConnectionInLoop(std::shared_ptr<TcpConnection> conn) {
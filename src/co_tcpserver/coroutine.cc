@@ -1,38 +1,132 @@
 #include "coroutine.h"
 #include "co_eventloop.h"
 #include "coroutine_context.h"
-#include "pthread_keys.h"
+#include "coroutine_stack.h"
+#include <assert.h>
 
 namespace cweb {
 namespace tcpserver {
 namespace coroutine {
 
-static const size_t kCoroutineContextSize = 4096 * 1024;
+static const size_t kDefaultStackSize = 256 * 1024;
 
-Coroutine::Coroutine(std::function<void()> func, std::shared_ptr<CoEventLoop> loop) : func_(std::move(func)), context_(new CoroutineContext(kCoroutineContextSize, coroutineFunc, this)), loop_(loop) {}
+Coroutine::Coroutine(std::function<void()> func, CoEventLoop* loop, size_t stack_size)
+: func_(std::move(func)),
+  context_(new CoroutineContext()),
+  stack_size_(stack_size > 0 ? stack_size : kDefaultStackSize),
+  loop_(loop) {}
 
 Coroutine::~Coroutine() {
+    if(shared_stack_ && shared_stack_->occupant == this) {
+        shared_stack_->occupant = nullptr;
+    }
+    delete snapshot_;
+    if(stack_) {
+        if(stack_pool_) {
+            stack_pool_->Deallocate(stack_);
+        }else {
+            StackPool::UnmapStack(stack_);
+        }
+    }
     delete context_;
 }
 
+void Coroutine::Release() {
+    if(shared_stack_) {
+        if(shared_stack_->occupant == this) shared_stack_->occupant = nullptr;
+        shared_stack_ = nullptr;
+        snapshot_->Clear();
+    }
+    func_ = nullptr;
+    loop_ = nullptr;
+    event_ = nullptr;
+}
+
+// 可能在其他线程中调用，这里不操作栈池，栈大小变化时在 initContext 中处理
+void Coroutine::Reset(std::function<void()> func, size_t stack_size) {
+    func_ = std::move(func);
+    stack_size_ = stack_size > 0 ? stack_size : kDefaultStackSize;
+    state_ = READY;
+    priority_ = HANDLER;
+    wait_reason_ = WAIT_NONE;
+    wait_fd_ = -1;
+    switches_ = run_us_ = hold_us_ = hold_since_us_ = 0;
+    context_ready_ = false;
+    pre = next = nullptr;
+}
+
+// 栈延迟到首次切入时在loop线程中分配，主协程运行在线程栈上不需要分配
+void Coroutine::initContext() {
+    CoEventLoop* loop = CoEventLoop::Current();
+    stack_pool_ = loop ? loop->GetStackPool() : nullptr;
+    if(stack_pool_ && stack_pool_->SharedStackEnabled()) {
+        shared_stack_ = stack_pool_->NextSharedStack();
+    }
+    if(shared_stack_) {
+        if(!snapshot_) snapshot_ = new StackSnapshot();
+        //先换出当前占用者，再在共享栈上构造初始帧
+        occupySharedStack();
+        context_->Init(shared_stack_->stack->Bottom(), shared_stack_->stack->size, coroutineFunc, this);
+    }else {
+        //复用的协程栈大小一致时直接沿用
+        if(stack_ && stack_->size != StackPool::RoundSize(stack_size_)) {
+            if(stack_pool_) {
+                stack_pool_->Deallocate(stack_);
+            }else {
+                StackPool::UnmapStack(stack_);
+            }
+            stack_ = nullptr;
+        }
+        if(!stack_) {
+            stack_ = stack_pool_ ? stack_pool_->Allocate(stack_size_) : StackPool::MapStack(stack_size_);
+        }
+        assert(stack_ != nullptr);
+        context_->Init(stack_->Bottom(), stack_->size, coroutineFunc, this);
+    }
+    context_ready_ = true;
+}
+
+// 所有切入都发生在主协程(线程栈)上，此时拷贝共享栈不会破坏正在执行的栈帧
+void Coroutine::occupySharedStack() {
+    Coroutine* occupant = (Coroutine*)shared_stack_->occupant;
+    if(occupant == this) return;
+    if(occupant) {
+        occupant->snapshot_->Save(shared_stack_->stack, occupant->context_->StackPointer());
+    }
+    shared_stack_->occupant = this;
+    snapshot_->Restore(shared_stack_->stack);
+}
+
+void Coroutine::prepareSwapIn() {
+    if(!context_ready_) {
+        initContext();
+    }else if(shared_stack_) {
+        occupySharedStack();
+    }
+}
+
 void Coroutine::SwapIn() {
+    prepareSwapIn();
+    Coroutine* main = CoEventLoop::Current()->GetMainCoroutine();
+    main->context_ready_ = true;
     // 切换状态 EXEC
     state_ = EXEC;
+    ++switches_;
     // 切换上下文
-    CoroutineContext::ContextSwap(
-        ((CoEventLoop*)pthread_getspecific(util::PthreadKeysSingleton::GetInstance()->TLSEventLoop))
-            ->GetMainCoroutine()->context_, context_);
+    CoroutineContext::ContextSwap(main->context_, context_);
 }
 
 void Coroutine::SwapOut() {
-    CoroutineContext::ContextSwap(context_, 
-        ((CoEventLoop*)pthread_getspecific(util::PthreadKeysSingleton::GetInstance()->TLSEventLoop))
-            ->GetMainCoroutine()->context_);
+    CoroutineContext::ContextSwap(context_, CoEventLoop::Current()->GetMainCoroutine()->context_);
 }
 
 void Coroutine::SwapTo(Coroutine *co) {
+    co->prepareSwapIn();
+    // 切出的协程上下文在 context_swap 中保存
+    context_ready_ = true;
     // co 设置状态 状态 执行
     co->SetState(EXEC);
+    ++co->switches_;
     // 切换上下文
     CoroutineContext::ContextSwap(context_, co->context_);
 }
@@ -44,6 +138,21 @@ void Coroutine::SetState(enum State state) {
     state_ = state;
 }
 
+const char* Coroutine::WaitReasonName(enum WaitReason reason) {
+    static const char* names[kWaitReasonCount] = {"none", "read", "write", "accept", "sleep", "sync", "other"};
+    return reason >= 0 && reason < kWaitReasonCount ? names[reason] : "unknown";
+}
+
+// 直接置为 READY 切回主协程，由loop重新排队；已在就绪队列中时 SetState(READY) 不会重复唤醒
+bool Coroutine::Yield() {
+    CoEventLoop* loop = CoEventLoop::Current();
+    Coroutine* co = loop ? loop->GetCurrentCoroutine() : nullptr;
+    if(!co) return false;
+    co->state_ = READY;
+    co->SwapTo(loop->GetMainCoroutine());
+    return true;
+}
+
 void Coroutine::coroutineFunc(void *vp) {
     Coroutine* co = (Coroutine*)vp;
     co->run();
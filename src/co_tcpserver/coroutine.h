@@ -12,6 +12,10 @@ namespace coroutine {
 
 class CoroutineContext;
 class CoEventLoop;
+class StackPool;
+struct CoroutineStack;
+struct SharedStack;
+class StackSnapshot;
 class CoEvent;
 class Coroutine : public util::LinkedListNode {
     
@@ -23,23 +27,86 @@ public:
         TERM            // 执行结束
     };
     
-    Coroutine(std::function<void()> func, std::shared_ptr<CoEventLoop> loop = nullptr);
+    //调度优先级，数值越小越先执行
+    enum Priority {
+        IO = 0,         // 读写就绪后被唤醒的协程(I/O 续体)
+        HANDLER,        // 新的请求处理、跨线程投递的任务
+        BACKGROUND,     // 后台任务、可窃取的计算任务
+        kPriorityCount
+    };
+    
+    //挂起原因，用于剖析和调试输出
+    enum WaitReason {
+        WAIT_NONE = 0,
+        WAIT_READ,
+        WAIT_WRITE,
+        WAIT_ACCEPT,
+        WAIT_SLEEP,
+        WAIT_SYNC,      // 协程锁、WaitGroup、Channel 等
+        WAIT_OTHER,
+        kWaitReasonCount
+    };
+    static const char* WaitReasonName(enum WaitReason reason);
+    
+    //stack_size 为0时使用默认的处理协程栈大小
+    Coroutine(std::function<void()> func, CoEventLoop* loop = nullptr, size_t stack_size = 0);
     ~Coroutine();
+    //回收复用：Release 在协程结束后由loop调用，释放方法体持有的资源；Reset 绑定新的方法体
+    void Release();
+    void Reset(std::function<void()> func, size_t stack_size = 0);
     void SwapIn();
     void SwapOut();
     void SwapTo(Coroutine* co);
     
     void SetState(State state);
     State State() const {return state_;}
-    void SetLoop(std::shared_ptr<CoEventLoop> loop) {loop_ = loop;}
+    //每次切入前由loop设置，不持有loop
+    void SetLoop(CoEventLoop* loop) {loop_ = loop;}
+    void SetPriority(enum Priority priority) {priority_ = priority;}
+    enum Priority GetPriority() const {return priority_;}
+    void SetEnqueueTime(uint64_t us) {enqueue_us_ = us;}
+    uint64_t EnqueueTime() const {return enqueue_us_;}
+    
+    //挂起前记录等待原因和fd
+    void SetWait(enum WaitReason reason, int fd = -1) {wait_reason_ = reason; wait_fd_ = fd;}
+    enum WaitReason GetWaitReason() const {return wait_reason_;}
+    int WaitFd() const {return wait_fd_;}
+    //剖析计数：切入次数、累计运行时间、累计挂起时间(微秒)，时间只在开启 sched_stats 时统计
+    uint64_t Switches() const {return switches_;}
+    uint64_t RunTime() const {return run_us_;}
+    uint64_t HoldTime() const {return hold_us_;}
+    uint64_t HoldSince() const {return hold_since_us_;}
+    void AddRunTime(uint64_t us) {run_us_ += us;}
+    void SetHoldSince(uint64_t us) {hold_since_us_ = us;}
+    void AddHoldTime(uint64_t us) {hold_us_ += us;}
+    
+    //让出当前协程，排到同优先级就绪队列的末尾；不在协程中调用时返回false
+    static bool Yield();
     
 private:
     enum State state_ = READY;
+    enum Priority priority_ = HANDLER;
+    uint64_t enqueue_us_ = 0;               // 进入就绪队列的时间，统计排队时延
+    enum WaitReason wait_reason_ = WAIT_NONE;
+    int wait_fd_ = -1;
+    uint64_t switches_ = 0;
+    uint64_t run_us_ = 0;
+    uint64_t hold_us_ = 0;
+    uint64_t hold_since_us_ = 0;
     CoroutineContext* context_;             // 协程上下文
+    size_t stack_size_;
+    CoroutineStack* stack_ = nullptr;       // 首次切入时才从所在loop的栈池分配
+    StackPool* stack_pool_ = nullptr;
+    SharedStack* shared_stack_ = nullptr;   // 共享栈模式下使用的栈
+    StackSnapshot* snapshot_ = nullptr;     // 共享栈模式下被换出时保存的栈内容
+    bool context_ready_ = false;            // 上下文已初始化或已保存过寄存器(主协程)
     std::function<void()> func_;            // 执行的方法体
-    std::shared_ptr<CoEventLoop> loop_;     // 绑定的循环对象
+    CoEventLoop* loop_ = nullptr;           // 绑定的循环对象
     CoEvent* event_ = nullptr;
     void run();
+    void initContext();
+    void prepareSwapIn();
+    void occupySharedStack();
     static void coroutineFunc(void* vp);
 };
 
@@ -20,19 +20,21 @@ namespace coroutine {
 
 void context_swap(CoroutineContext* from, CoroutineContext* to);
 
-CoroutineContext::CoroutineContext() {}
+CoroutineContext::CoroutineContext() {
+    memset(regs, 0, sizeof(regs));
+}
 
 // fn 为 Coroutine 的 coroutineFunc 方法
-CoroutineContext::CoroutineContext(size_t size, void (*fn)(void*), const void* vp) : ss_size(size) {
-    Init(size, fn, vp);
+CoroutineContext::CoroutineContext(char* stack, size_t size, void (*fn)(void*), const void* vp) {
+    Init(stack, size, fn, vp);
 }
 
-CoroutineContext::~CoroutineContext() {
-    free(ss_sp);
-}
+CoroutineContext::~CoroutineContext() {}
 
-void CoroutineContext::Init(size_t size, void (*fn)(void*), const void* vp) {
-    ss_sp = (char*)malloc(size); //堆 低->高
+// stack 为栈的低地址，由 StackPool 分配
+void CoroutineContext::Init(char* stack, size_t size, void (*fn)(void*), const void* vp) {
+    ss_sp = stack;
+    ss_size = size;
     //移动到高地址 栈 高->低
     char* sp = ss_sp + ss_size - sizeof(void*);
     
@@ -9,6 +9,7 @@ namespace cweb {
 namespace tcpserver {
 namespace coroutine {
 
+//栈内存由外部(StackPool)管理，上下文只记录寄存器与栈区间
 class CoroutineContext {
 public:
     void* regs[9];
@@ -17,8 +18,10 @@ public:
     
     CoroutineContext();
     ~CoroutineContext();
-    CoroutineContext(size_t size, void (*fn)(void*), const void* vp);
-    void Init(size_t size, void (*fn)(void*), const void* vp);
+    CoroutineContext(char* stack, size_t size, void (*fn)(void*), const void* vp);
+    void Init(char* stack, size_t size, void (*fn)(void*), const void* vp);
+    //切出后保存的栈顶指针 regs[RSP]
+    char* StackPointer() const {return (char*)regs[7];}
     static void ContextSwap(CoroutineContext *from, CoroutineContext *to);
 };
 
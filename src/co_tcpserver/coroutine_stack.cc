@@ -0,0 +1,163 @@
+#include "coroutine_stack.h"
+#include "logger.h"
+#include <sys/mman.h>
+#include <string.h>
+#include <stdlib.h>
+#include <sys/time.h>
+#include <unistd.h>
+#include <assert.h>
+
+using namespace cweb::log;
+
+namespace cweb {
+namespace tcpserver {
+namespace coroutine {
+
+static uint64_t nowMs() {
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return (uint64_t)tv.tv_sec * 1000 + tv.tv_usec / 1000;
+}
+
+StackPool::StackPool(size_t max_cached, size_t guard_size) : max_cached_(max_cached), guard_size_(guard_size) {}
+
+StackSnapshot::~StackSnapshot() {
+    free(buffer_);
+}
+
+void StackSnapshot::Save(const CoroutineStack* stack, const char* sp) {
+    size_ = stack->Top() - sp;
+    assert(size_ <= stack->size);
+    if(size_ > capacity_) {
+        //按256字节向上取整，避免栈深度小幅波动时反复 realloc
+        capacity_ = (size_ + 255) & ~(size_t)255;
+        buffer_ = (char*)realloc(buffer_, capacity_);
+    }
+    memcpy(buffer_, sp, size_);
+}
+
+void StackSnapshot::Restore(CoroutineStack* stack) {
+    if(size_ == 0) return;
+    memcpy(stack->Top() - size_, buffer_, size_);
+}
+
+StackPool::~StackPool() {
+    for(auto iter = free_stacks_.begin(); iter != free_stacks_.end(); ++iter) {
+        for(CoroutineStack* stack : iter->second) {
+            UnmapStack(stack);
+        }
+    }
+    for(SharedStack* shared : shared_stacks_) {
+        UnmapStack(shared->stack);
+        delete shared;
+    }
+}
+
+size_t StackPool::PageSize() {
+    static size_t pagesize = (size_t)sysconf(_SC_PAGESIZE);
+    return pagesize;
+}
+
+size_t StackPool::RoundSize(size_t size) {
+    size_t pagesize = PageSize();
+    if(size < kMinStackSize) size = kMinStackSize;
+    return (size + pagesize - 1) / pagesize * pagesize;
+}
+
+CoroutineStack* StackPool::MapStack(size_t size, size_t guard_size) {
+    size = RoundSize(size);
+    //至少一页
+    size_t guard = (guard_size + PageSize() - 1) / PageSize() * PageSize();
+    if(guard == 0) guard = PageSize();
+    size_t mapped_size = size + guard;
+    void* base = mmap(NULL, mapped_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if(base == MAP_FAILED) {
+        LOG(LOGLEVEL_ERROR, CWEB_MODULE, "stackpool", "协程栈分配失败, size: %lu", size);
+        return nullptr;
+    }
+    //最低的 guard 字节作为保护区，设置失败时不使用没有保护的栈
+    if(mprotect(base, guard, PROT_NONE) != 0) {
+        LOG(LOGLEVEL_ERROR, CWEB_MODULE, "stackpool", "协程栈保护区设置失败, size: %lu", size);
+        munmap(base, mapped_size);
+        return nullptr;
+    }
+    
+    CoroutineStack* stack = new CoroutineStack();
+    stack->base = (char*)base;
+    stack->mapped_size = mapped_size;
+    stack->size = size;
+    return stack;
+}
+
+void StackPool::UnmapStack(CoroutineStack* stack) {
+    if(stack == nullptr) return;
+    munmap(stack->base, stack->mapped_size);
+    delete stack;
+}
+
+CoroutineStack* StackPool::Allocate(size_t size) {
+    size = RoundSize(size);
+    auto iter = free_stacks_.find(size);
+    if(iter != free_stacks_.end() && iter->second.size() > 0) {
+        CoroutineStack* stack = iter->second.back();
+        iter->second.pop_back();
+        --cached_;
+        ++reused_;
+        stack->trimmed = false;
+        return stack;
+    }
+    
+    ++allocated_;
+    return MapStack(size, guard_size_);
+}
+
+void StackPool::Deallocate(CoroutineStack* stack) {
+    if(stack == nullptr) return;
+    if(cached_ >= max_cached_) {
+        UnmapStack(stack);
+        return;
+    }
+    stack->released_ms = nowMs();
+    free_stacks_[stack->size].push_back(stack);
+    ++cached_;
+}
+
+void StackPool::EnableSharedStacks(size_t count, size_t size) {
+    shared_count_ = count;
+    shared_size_ = RoundSize(size);
+}
+
+SharedStack* StackPool::NextSharedStack() {
+    if(shared_count_ == 0) return nullptr;
+    if(shared_stacks_.size() < shared_count_) {
+        CoroutineStack* stack = MapStack(shared_size_, guard_size_);
+        if(stack == nullptr) return nullptr;
+        SharedStack* shared = new SharedStack();
+        shared->stack = stack;
+        shared_stacks_.push_back(shared);
+        return shared;
+    }
+    SharedStack* shared = shared_stacks_[shared_next_];
+    shared_next_ = (shared_next_ + 1) % shared_stacks_.size();
+    return shared;
+}
+
+void StackPool::Trim(uint64_t idle_ms) {
+    uint64_t now = nowMs();
+    for(auto iter = free_stacks_.begin(); iter != free_stacks_.end(); ++iter) {
+        //后进先出，越靠前越冷
+        for(CoroutineStack* stack : iter->second) {
+            if(now - stack->released_ms < idle_ms) break;
+            if(stack->trimmed) continue;
+#ifdef MADV_DONTNEED
+            madvise(stack->Bottom(), stack->size, MADV_DONTNEED);
+#endif
+            stack->trimmed = true;
+            ++trimmed_;
+        }
+    }
+}
+
+}
+}
+}
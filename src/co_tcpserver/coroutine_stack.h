@@ -0,0 +1,117 @@
+#ifndef CWEB_COROUTINE_COROUTINESTACK_H_
+#define CWEB_COROUTINE_COROUTINESTACK_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <map>
+#include <vector>
+#include "noncopyable.h"
+
+namespace cweb {
+namespace tcpserver {
+namespace coroutine {
+
+/*
+ mmap 分配的协程栈，低地址处有 PROT_NONE 保护区(默认 16KB)
+ 栈溢出时直接触发段错误，而不是悄悄覆盖相邻内存；大于保护区的栈帧可能越过保护区，
+ 因此编译时开启 -fstack-clash-protection 逐页探测(见 CMakeLists.txt)
+
+    base_                 base_ + guard         top
+     |  guard(PROT_NONE)  |     usable size      |
+                          <------ 栈向低地址增长 ---
+ */
+struct CoroutineStack {
+    char* base = nullptr;           //mmap 起始地址
+    size_t mapped_size = 0;         //含保护区
+    size_t size = 0;                //可用大小
+    uint64_t released_ms = 0;       //归还到池中的时间
+    bool trimmed = false;           //物理页是否已归还给系统
+    
+    char* Bottom() const {return base + (mapped_size - size);}
+    char* Top() const {return base + mapped_size;}
+};
+
+/*
+ 共享栈模式：多个协程轮流在同一块栈上运行
+ 切换到不同协程时，把当前占用者已使用的部分(rsp 到栈顶)拷贝到它自己的堆缓冲区，再把新协程的内容拷回
+ 挂起的协程只占用实际使用的栈字节，适合大量空闲长连接
+ 注意：协程挂起后其栈上变量的地址不再有效，不能把栈上对象的指针交给其他协程
+ */
+struct SharedStack {
+    CoroutineStack* stack = nullptr;
+    void* occupant = nullptr;       //当前栈上内容所属的协程
+};
+
+//被换出协程的栈内容
+class StackSnapshot : public util::Noncopyable {
+private:
+    char* buffer_ = nullptr;
+    size_t size_ = 0;
+    size_t capacity_ = 0;
+    
+public:
+    ~StackSnapshot();
+    
+    //保存 [sp, 栈顶) 的内容
+    void Save(const CoroutineStack* stack, const char* sp);
+    void Restore(CoroutineStack* stack);
+    void Clear() {size_ = 0;}
+    size_t Size() const {return size_;}
+    size_t Capacity() const {return capacity_;}
+};
+
+//每个loop一个栈池，只在loop线程中使用，无锁
+class StackPool : public util::Noncopyable {
+public:
+    static const size_t kGuardSize = 16 * 1024;
+    //小于该大小的栈按该大小分配
+    static const size_t kMinStackSize = 32 * 1024;
+    
+private:
+    size_t max_cached_;
+    size_t guard_size_;
+    size_t cached_ = 0;
+    std::map<size_t, std::vector<CoroutineStack*>> free_stacks_;     //<size : 空闲栈> 后进先出，优先复用热栈
+    
+    std::vector<SharedStack*> shared_stacks_;
+    size_t shared_count_ = 0;
+    size_t shared_size_ = 0;
+    size_t shared_next_ = 0;
+    
+    size_t allocated_ = 0;
+    size_t reused_ = 0;
+    size_t trimmed_ = 0;
+    
+public:
+    StackPool(size_t max_cached = 128, size_t guard_size = kGuardSize);
+    ~StackPool();
+    
+    CoroutineStack* Allocate(size_t size);
+    void Deallocate(CoroutineStack* stack);
+    //空闲超过 idle_ms 的栈 MADV_DONTNEED 归还物理页，保留虚拟地址以便复用
+    void Trim(uint64_t idle_ms);
+    
+    //开启共享栈模式，count 块大小为 size 的栈，首次使用时映射
+    void EnableSharedStacks(size_t count, size_t size);
+    bool SharedStackEnabled() const {return shared_count_ > 0;}
+    //轮询分配共享栈
+    SharedStack* NextSharedStack();
+    
+    size_t Cached() const {return cached_;}
+    size_t Allocated() const {return allocated_;}
+    size_t Reused() const {return reused_;}
+    size_t Trimmed() const {return trimmed_;}
+    
+    static size_t PageSize();
+    //按页取整，不小于 kMinStackSize
+    static size_t RoundSize(size_t size);
+    //不经过栈池直接映射/释放，保护区无法设置时返回 nullptr
+    static CoroutineStack* MapStack(size_t size, size_t guard_size = kGuardSize);
+    static void UnmapStack(CoroutineStack* stack);
+};
+
+}
+}
+}
+
+#endif
@@ -2,12 +2,28 @@
 #include "httpserver.h"
 #include "httpsession.h"
 #include "bytedata.h"
+#include "eventloop.h"
+#include "offload_pool.h"
+#include "httpresponse.h"
+#include "http_header.h"
 #include <random>
 #include <fstream>
 
+#ifdef COROUTINE
+#include "co_sync.h"
+#include "co_eventloop.h"
+using namespace cweb::tcpserver::coroutine;
+#endif
+
 namespace cweb {
 
 Context::~Context() {
+    session_->FinishResponse(request_->Sequence());
+    //流式响应和稍后响应的请求在这里才结束，耗时和响应大小包含全部数据
+    if(metrics_) {
+        metrics_->Record(Method(), route_pattern_.size() ? route_pattern_ : "<unmatched>", Time::Now() - start_, BodySize(), response_bytes_);
+    }
+    
     if(redis_) {
         RedisPoolSingleton::GetInstance()->ReleaseConnection(redis_);
     }
@@ -25,6 +41,10 @@ const std::string& Context::Path() const {
     return request_->Path();
 }
 
+size_t Context::BodySize() const {
+    return request_->BinaryValue().size;
+}
+
 const std::string& Context::Param(const std::string &key) {
     static std::string empty;
     auto iter = params_.find(key);
@@ -34,8 +54,12 @@ const std::string& Context::Param(const std::string &key) {
     return empty;
 }
 
-const std::string& Context::Query(const std::string &key) const {
-    return request_->Query(key);
+std::string Context::Query(const std::string &key) const {
+    return request_->Query(key).ToString();
+}
+
+StringPiece Context::Header(const std::string &key) const {
+    return request_->Header(key);
 }
 
 const std::string& Context::PostForm(const std::string &key) const {
@@ -55,10 +79,72 @@ const BinaryData& Context::BinaryValue() const {
 }
 
 void Context::SaveUploadedFile(const BinaryData &file, const std::string &path, const std::string& filename) {
-    std::ofstream ofs;
-    ofs.open(path + filename, std::ofstream::out | std::ofstream::app);
-    ofs.write(file.data, file.size);
-    ofs.close();
+    std::string filepath = path + filename;
+    const char* data = file.data;
+    size_t size = file.size;
+    Offload([filepath, data, size](){
+        std::ofstream ofs;
+        ofs.open(filepath, std::ofstream::out | std::ofstream::app);
+        ofs.write(data, size);
+        ofs.close();
+    });
+}
+
+void Context::Offload(std::function<void()> fn) {
+#ifdef COROUTINE
+    //等待状态放在堆上，唤醒方在工作线程
+    std::shared_ptr<WaitGroup> wg = std::make_shared<WaitGroup>();
+    wg->Add(1);
+    if(OffloadPoolSingleton::GetInstance()->Submit([fn, wg](){
+        fn();
+        wg->Done();
+    })) {
+        wg->Wait();
+        return;
+    }
+#endif
+    fn();
+}
+
+void Context::Offload(std::function<void()> fn, std::function<void()> then) {
+#ifdef COROUTINE
+    Offload(std::move(fn));
+    then();
+#else
+    //持有 Context 直到 then 执行完，连接和loop随之保持有效
+    std::shared_ptr<Context> self = shared_from_this();
+    EventLoop* loop = Loop();
+    if(!OffloadPoolSingleton::GetInstance()->Submit([self, loop, fn, then](){
+        fn();
+        loop->AddTask([self, then](){
+            then();
+        });
+    })) {
+        fn();
+        then();
+    }
+#endif
+}
+
+void Context::Compute(std::vector<std::function<void()>> tasks) {
+#ifdef COROUTINE
+    CoEventLoop* loop = CoEventLoop::Current();
+    if(loop && !tasks.empty()) {
+        std::shared_ptr<WaitGroup> wg = std::make_shared<WaitGroup>();
+        wg->Add(tasks.size());
+        for(std::function<void()>& task : tasks) {
+            loop->AddStealableTask([task, wg](){
+                task();
+                wg->Done();
+            });
+        }
+        wg->Wait();
+        return;
+    }
+#endif
+    for(std::function<void()>& task : tasks) {
+        task();
+    }
 }
 
 std::shared_ptr<Redis> Context::Redis() {
@@ -73,21 +159,56 @@ std::shared_ptr<MySQL> Context::MySQL() {
     return mysql_;
 }
 
+EventLoop* Context::Loop() const {
+    return session_->OwnerLoop();
+}
+
 std::shared_ptr<WebSocket> Context::Upgrade() const {
     return std::dynamic_pointer_cast<WebSocket>(session_);
 }
 
+ContentEncoding Context::acceptedEncoding(size_t size) const {
+    if(!compress_ || size < HttpCompressionSingleton::GetInstance()->MinSize()) return EncodingIdentity;
+    return NegotiateEncoding(request_->Header(HeaderAcceptEncoding));
+}
+
 void Context::STRING(HttpStatusCode code, const std::string& data) {
-    session_->SendString(code, data);
+    ContentEncoding encoding = acceptedEncoding(data.size());
+    std::string compressed;
+    if(encoding != EncodingIdentity && HttpCompressionSingleton::GetInstance()->Compress(encoding, compress_level_, data.data(), data.size(), compressed)) {
+        response_bytes_ += session_->SendBody(code, "text/plain; charset=utf-8", compressed, ContentEncodingName(encoding), request_->Sequence());
+        return;
+    }
+    response_bytes_ += session_->SendBody(code, "text/plain; charset=utf-8", data, nullptr, request_->Sequence(), compress_);
 }
 
 void Context::JSON(HttpStatusCode code, const std::string& data) {
-    session_->SendJson(code, data);
+    ContentEncoding encoding = acceptedEncoding(data.size());
+    std::string compressed;
+    if(encoding != EncodingIdentity && HttpCompressionSingleton::GetInstance()->Compress(encoding, compress_level_, data.data(), data.size(), compressed)) {
+        response_bytes_ += session_->SendBody(code, "application/json; charset=utf-8", compressed, ContentEncodingName(encoding), request_->Sequence());
+        return;
+    }
+    response_bytes_ += session_->SendBody(code, "application/json; charset=utf-8", data, nullptr, request_->Sequence(), compress_);
 }
 
-//单文件传输
+//单文件传输，GET 请求支持 Range；开启压缩时文本类文件发送缓存的压缩结果，带 Range 的请求不压缩
 void Context::FILE(HttpStatusCode code, const std::string &filepath, std::string filename) {
-    session_->SendFile(code, filepath, filename);
+    StringPiece range;
+    if(request_->Method() == "GET") {
+        range = request_->Header(HeaderRange);
+    }
+    //可压缩的文件类型按 Accept-Encoding 协商，未压缩的响应也带 Vary
+    bool negotiated = compress_ && CompressibleType(HttpResponse::MimeType(filepath));
+    ContentEncoding encoding = negotiated && range.Empty() ? acceptedEncoding(HttpCompressionSingleton::GetInstance()->MinSize()) : EncodingIdentity;
+    if(encoding != EncodingIdentity) {
+        std::shared_ptr<const std::string> compressed = HttpCompressionSingleton::GetInstance()->CompressedFile(filepath, encoding, compress_level_);
+        if(compressed) {
+            response_bytes_ += session_->SendFile(code, filepath, compressed, ContentEncodingName(encoding), filename, request_->Sequence());
+            return;
+        }
+    }
+    response_bytes_ += session_->SendFileRange(code, filepath, range, request_->Header(HeaderIfRange), filename, request_->Sequence(), negotiated);
 }
 
 //MULTIPART 数据
@@ -103,8 +224,25 @@ Content-Type: image/jpeg
 <JPEG file data>
 ------BOUNDARY_STRING--*/
 void Context::MULTIPART(HttpStatusCode code, const std::vector<MultipartPart *>& parts) {
-    session_->SendMultipart(code, parts);
+    response_bytes_ += session_->SendMultipart(code, parts, request_->Sequence());
+}
+
+//响应体的字节数由 writer 累加到 response_bytes_
+std::shared_ptr<ChunkedWriter> Context::Stream(HttpStatusCode code, const std::string& content_type) {
+    bool chunked = request_->MinorVersion() > 0;
+    response_bytes_ += session_->SendChunkedHeader(code, content_type, chunked, request_->Sequence());
+    return std::make_shared<ChunkedWriter>(session_, request_->Sequence(), chunked, shared_from_this(), &response_bytes_);
 }
 
+void Context::Stream(HttpStatusCode code, const std::string& content_type, ChunkedWriter::Producer producer) {
+    Stream(code, content_type)->Pump(std::move(producer));
+}
+
+ContextHandler Compress(int level) {
+    return [level](std::shared_ptr<Context> c) {
+        c->EnableCompression(level);
+        c->Next();
+    };
+}
 
 }
@@ -10,8 +10,13 @@
 #include "httpserver.h"
 #include "httprequest.h"
 #include "websocket.h"
+#include "chunked_writer.h"
+#include "http_compress.h"
 #include "redis.h"
 #include "mysql.h"
+#include "trace.h"
+#include "await.h"
+#include "timer.h"
 
 using namespace cweb::tcpserver;
 using namespace cweb::httpserver;
@@ -28,8 +33,18 @@ private:
     //shared 避免下层通道关闭后 上层无感知导致send空指针
     std::shared_ptr<HttpSession> session_;
     std::unordered_map<std::string, std::string> params_;
+    std::string route_pattern_ = "";
+    size_t response_bytes_ = 0;
+    //由 Router 设置，响应结束(Context 释放)时记录路由统计
+    RouteMetrics* metrics_ = nullptr;
+    Time start_ = Time(0);
     std::shared_ptr<Redis> redis_ = nullptr;
     std::shared_ptr<MySQL> mysql_ = nullptr;
+    bool compress_ = false;
+    int compress_level_ = -1;
+    
+    //客户端接受且值得压缩时返回编码
+    ContentEncoding acceptedEncoding(size_t size) const;
     
 public:
     friend class Router;
@@ -39,6 +54,8 @@ public:
     void Next() {
         ++index_;
         if(index_ < handlers_.size()) {
+            //最后一个为路由处理函数，其余为中间件
+            TRACE_SCOPE(request_->TraceSampled(), index_ + 1 < handlers_.size() ? "middleware" : "handler", index_);
             (handlers_[index_])(shared_from_this());
         }
     }
@@ -49,7 +66,14 @@ public:
     
     const std::string& Method() const;
     const std::string& Path() const;
-    const std::string& Query(const std::string& key) const;
+    //命中的路由模式，如 /api/dynamic/:param
+    const std::string& RoutePattern() const {return route_pattern_;}
+    size_t BodySize() const;
+    size_t ResponseBytes() const {return response_bytes_;}
+    //返回拷贝，可在请求结束后继续使用
+    std::string Query(const std::string& key) const;
+    //不拷贝，指向请求内部的数据，只在请求处理期间有效
+    StringPiece Header(const std::string& key) const;
     const std::string& Param(const std::string& key);
     const std::string& PostForm(const std::string& key) const;
     MultipartPart* MultipartForm(const std::string& key) const;
@@ -60,14 +84,50 @@ public:
     std::shared_ptr<MySQL> MySQL();
     
     std::shared_ptr<WebSocket> Upgrade() const;
+    //连接所属的loop
+    EventLoop* Loop() const;
+
+    //之后的 STRING、JSON、FILE 按 Accept-Encoding 压缩，一般通过 Compress 中间件开启
+    void EnableCompression(int level = -1) {
+        compress_ = true;
+        compress_level_ = level;
+    }
 
     void SaveUploadedFile(const BinaryData& file, const std::string& path, const std::string& filename);
     
+    //在卸载线程池中执行阻塞操作，协程模式下挂起当前协程直到 fn 执行完，线程模式下直接执行
+    //共享栈模式下协程栈在挂起期间会被换出，fn 不能引用协程栈上的变量，需按值捕获
+    void Offload(std::function<void()> fn);
+    //fn 执行完后 then 回到连接所属的loop中执行，线程模式下不阻塞I/O线程
+    void Offload(std::function<void()> fn, std::function<void()> then);
+    //计算密集的任务放入本loop的可窃取队列，空闲的loop窃取并行执行，当前协程挂起直到全部执行完
+    //任务在其他loop线程中执行，按值捕获；线程模式下依次直接执行
+    void Compute(std::vector<std::function<void()>> tasks);
+    
+    //可以在处理函数返回后持有 Context，在任意线程中稍后响应；同一连接上的响应按请求顺序发送
     void STRING(HttpStatusCode code, const std::string& data);
     void JSON(HttpStatusCode code, const std::string& data);
     void FILE(HttpStatusCode code, const std::string& filepath, std::string filename = "");
     void MULTIPART(HttpStatusCode code, const std::vector<MultipartPart*>& parts);
+    //流式响应，先发送响应头，返回的 writer 持有 Context，Close 或释放后请求才处理结束
+    std::shared_ptr<ChunkedWriter> Stream(HttpStatusCode code, const std::string& content_type = "text/plain; charset=utf-8");
+    //按发送速度拉取 producer 生成的数据，返回 false 结束
+    void Stream(HttpStatusCode code, const std::string& content_type, ChunkedWriter::Producer producer);
 };
 
+//响应压缩中间件，level < 0 使用 CompressConfig::level
+ContextHandler Compress(int level = -1);
+
+#ifdef CWEB_CO_AWAIT
+//无栈协程处理函数，协程帧持有 Context 直到执行完，期间可以 co_await await::Offload 等
+typedef std::function<await::Task<void>(std::shared_ptr<Context>)> AsyncContextHandler;
+
+inline ContextHandler AsyncHandler(AsyncContextHandler handler) {
+    return [handler](std::shared_ptr<Context> c) {
+        handler(c).Detach();
+    };
+}
+#endif
+
 }
 #endif /* context_hpp */
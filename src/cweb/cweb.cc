@@ -4,6 +4,8 @@
 #include "redis.h"
 #include "mysql.h"
 #include "logger.h"
+#include "metrics.h"
+#include "trace.h"
 #ifdef COROUTINE
 #include "co_eventloop.h"
 #else
@@ -16,6 +18,7 @@ using namespace cweb::tcpserver::coroutine;
 
 using namespace cweb::db;
 using namespace cweb::log;
+using namespace cweb::util;
 
 namespace cweb {
 
@@ -35,6 +38,7 @@ Cweb::Cweb(uint16_t port, bool loopbackonly, bool ipv6) {
     }
     LoggerManagerSingleton::GetInstance();
     router_.reset(new Router());
+    MetricsRegistrySingleton::GetInstance()->Register("route", std::bind(&RouteMetrics::Render, router_->Metrics(), std::placeholders::_1));
     httpserver_.reset(new HttpServer(mainloop, port, loopbackonly, ipv6));
     httpserver_->SetRequestCallback(std::bind(&Cweb::serverHTTP, this, std::placeholders::_1, std::placeholders::_2));
 }
@@ -48,11 +52,13 @@ Cweb::Cweb(const std::string& ip, uint16_t port, bool ipv6) {
         LOG(LOGLEVEL_DEBUG, CWEB_MODULE, "cweb", "mysql init error");
     }
     router_.reset(new Router());
+    MetricsRegistrySingleton::GetInstance()->Register("route", std::bind(&RouteMetrics::Render, router_->Metrics(), std::placeholders::_1));
     httpserver_.reset(new HttpServer(mainloop, ip, port, ipv6));
     httpserver_->SetRequestCallback(std::bind(&Cweb::serverHTTP, this, std::placeholders::_1, std::placeholders::_2));
 }
 
 Cweb::~Cweb() {
+    MetricsRegistrySingleton::GetInstance()->Unregister("route");
     for(class Group* group : groups_) {
         delete group;
     }
@@ -78,6 +84,47 @@ void Cweb::serverHTTP(std::shared_ptr<HttpSession> session, std::unique_ptr<Http
     router_->Handle(c);
 }
 
+void Cweb::Metrics(const std::string& path) {
+    router_->AddRouter("GET", path, [](std::shared_ptr<Context> c) {
+        std::string data;
+        MetricsRegistrySingleton::GetInstance()->Render(data);
+        c->STRING(StatusOK, data);
+    });
+}
+
+void Cweb::Trace(const std::string& path) {
+    router_->AddRouter("GET", path, [](std::shared_ptr<Context> c) {
+        Tracer* tracer = TracerSingleton::GetInstance();
+        std::string enable = c->Query("enable");
+        if(enable == "1") {
+            std::string rate = c->Query("rate");
+            tracer->Clear();
+            tracer->Enable(rate.size() ? (uint32_t)strtoul(rate.c_str(), nullptr, 10) : 1);
+            c->STRING(StatusOK, "tracing enabled");
+        }else if(enable == "0") {
+            tracer->Disable();
+            c->STRING(StatusOK, "tracing disabled");
+        }else {
+            std::string data;
+            tracer->DumpChromeTrace(data);
+            c->JSON(StatusOK, data);
+        }
+    });
+}
+
+void Cweb::Coroutines(const std::string& path) {
+    router_->AddRouter("GET", path, [](std::shared_ptr<Context> c) {
+#ifdef COROUTINE
+        std::string limit = c->Query("limit");
+        std::string data;
+        CoEventLoop::DumpAllHoldCoroutines(data, limit.size() ? strtoul(limit.c_str(), nullptr, 10) : 100);
+        c->STRING(StatusOK, data);
+#else
+        c->STRING(StatusOK, "coroutine disabled");
+#endif
+    });
+}
+
 void Cweb::Run(int threadcnt) {
     LOG(LOGLEVEL_DEBUG, CWEB_MODULE, "cweb", "server start success");
     httpserver_->Start(threadcnt);
@@ -2,6 +2,7 @@
 #define CWEB_CWEB_CWEB_H_
 
 #include <vector>
+#include <map>
 #include "router.h"
 #include "httpsession.h"
 #include "httpserver.h"
@@ -83,6 +84,19 @@ public:
         return group;
     }
     
+    //注册指标接口，输出 Prometheus 文本格式
+    void Metrics(const std::string& path = "/metrics");
+    //按路由模式汇总的耗时、请求体、响应大小直方图
+    void RouteStatistics(std::map<std::string, RouteStats>& stats) {
+        router_->Metrics()->Snapshot(stats);
+    }
+    
+    //请求追踪接口：?enable=1&rate=N 开启并按 1/N 采样，?enable=0 关闭，无参数时导出 Chrome trace_event JSON
+    void Trace(const std::string& path = "/debug/trace");
+    
+    //协程版输出各loop挂起的协程，按等待原因分组，?limit=N 限制每组输出的个数
+    void Coroutines(const std::string& path = "/debug/coroutines");
+    
     void Run(int threadcnt);
     void Quit();
 };
@@ -0,0 +1,80 @@
+#include "route_metrics.h"
+#include "metrics.h"
+
+namespace cweb {
+
+RouteMetrics::RouteMetrics() {
+    pthread_key_create(&shard_key_, NULL);
+}
+
+RouteMetrics::~RouteMetrics() {
+    for(Shard* shard : shards_) {
+        delete shard;
+    }
+    pthread_key_delete(shard_key_);
+}
+
+RouteMetrics::Shard* RouteMetrics::localShard() {
+    Shard* shard = (Shard*)pthread_getspecific(shard_key_);
+    if(shard == nullptr) {
+        shard = new Shard();
+        pthread_setspecific(shard_key_, shard);
+        std::unique_lock<std::mutex> lock(mutex_);
+        shards_.push_back(shard);
+    }
+    return shard;
+}
+
+void RouteMetrics::Record(const std::string& method, const std::string& pattern, uint64_t latency_us, size_t request_bytes, size_t response_bytes) {
+    Shard* shard = localShard();
+    std::unique_lock<std::mutex> lock(shard->mutex);
+    //首次命中时才分配直方图，冷路由不占内存
+    RouteStats& stats = shard->routes[method + " " + pattern];
+    stats.latency_us.Record(latency_us);
+    stats.request_bytes.Record(request_bytes);
+    stats.response_bytes.Record(response_bytes);
+}
+
+void RouteMetrics::Snapshot(std::map<std::string, RouteStats>& out) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    for(Shard* shard : shards_) {
+        std::unique_lock<std::mutex> shard_lock(shard->mutex);
+        for(auto iter = shard->routes.begin(); iter != shard->routes.end(); ++iter) {
+            auto res = out.insert(std::make_pair(iter->first, iter->second));
+            if(!res.second) {
+                res.first->second.Merge(iter->second);
+            }
+        }
+    }
+}
+
+void RouteMetrics::Reset() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    for(Shard* shard : shards_) {
+        std::unique_lock<std::mutex> shard_lock(shard->mutex);
+        shard->routes.clear();
+    }
+}
+
+static std::string escapeLabel(const std::string& value) {
+    std::string res;
+    for(char c : value) {
+        if(c == '"' || c == '\\') res += '\\';
+        res += c;
+    }
+    return res;
+}
+
+void RouteMetrics::Render(std::string& out) {
+    std::map<std::string, RouteStats> routes;
+    Snapshot(routes);
+    for(auto iter = routes.begin(); iter != routes.end(); ++iter) {
+        size_t pos = iter->first.find(' ');
+        std::string labels = "method=\"" + iter->first.substr(0, pos) + "\",route=\"" + escapeLabel(iter->first.substr(pos + 1)) + "\"";
+        util::MetricsRegistry::AppendSummary(out, "cweb_route_latency_us", labels, iter->second.latency_us);
+        util::MetricsRegistry::AppendSummary(out, "cweb_route_request_bytes", labels, iter->second.request_bytes);
+        util::MetricsRegistry::AppendSummary(out, "cweb_route_response_bytes", labels, iter->second.response_bytes);
+    }
+}
+
+}
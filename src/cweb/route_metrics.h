@@ -0,0 +1,57 @@
+#ifndef CWEB_CWEB_ROUTEMETRICS_H_
+#define CWEB_CWEB_ROUTEMETRICS_H_
+
+#include <string>
+#include <map>
+#include <vector>
+#include <mutex>
+#include <unordered_map>
+#include <pthread.h>
+#include "histogram.h"
+
+namespace cweb {
+
+struct RouteStats {
+    util::Histogram latency_us;        //开始处理到响应结束的耗时(微秒)
+    util::Histogram request_bytes;     //请求体大小
+    util::Histogram response_bytes;    //响应大小
+
+    void Merge(const RouteStats& other) {
+        latency_us.Merge(other.latency_us);
+        request_bytes.Merge(other.request_bytes);
+        response_bytes.Merge(other.response_bytes);
+    }
+};
+
+/*
+ 按路由模式(而非原始路径)统计，key 为 "METHOD pattern"
+ 每个loop线程一个分片，记录时只锁本线程分片(无竞争)，读取时合并所有分片
+ */
+class RouteMetrics {
+private:
+    struct Shard {
+        std::mutex mutex;
+        std::unordered_map<std::string, RouteStats> routes;
+    };
+
+    pthread_key_t shard_key_;
+    std::mutex mutex_;
+    std::vector<Shard*> shards_;
+
+    Shard* localShard();
+
+public:
+    RouteMetrics();
+    ~RouteMetrics();
+
+    void Record(const std::string& method, const std::string& pattern, uint64_t latency_us, size_t request_bytes, size_t response_bytes);
+    //合并各loop分片
+    void Snapshot(std::map<std::string, RouteStats>& out);
+    void Reset();
+    //Prometheus 文本格式
+    void Render(std::string& out);
+};
+
+}
+
+#endif
@@ -1,6 +1,8 @@
 #include "router.h"
 #include "context.h"
 #include "logger.h"
+#include "timer.h"
+#include "trace.h"
 
 using namespace cweb::log;
 namespace cweb {
@@ -17,6 +19,9 @@ void Router::AddRouter(const std::string &method, const std::string &pattern, Co
 }
 
 void Router::Handle(std::shared_ptr<Context> c) {
+    //按路由模式统计，未命中的请求归为一类，避免原始路径导致指标膨胀；在响应结束时记录
+    c->metrics_ = metrics_.get();
+    c->start_ = Time::Now();
     if(findRoute(c.get())) {
         LOG(LOGLEVEL_INFO, CWEB_MODULE, "router", "请求命中路由: %s", c->Path().c_str());
         c->Next();
@@ -27,6 +32,7 @@ void Router::Handle(std::shared_ptr<Context> c) {
 }
 
 bool Router::findRoute(Context *c) {
+    TRACE_SCOPE(c->request_->TraceSampled(), "route_match");
     if(roots_.find(c->Method()) == roots_.end()) return false;
    
     std::vector<std::string> parts;
@@ -43,6 +49,7 @@ bool Router::findRoute(Context *c) {
             }
         }
         c->AddHandler(node->handler_);
+        c->route_pattern_ = node->pattern_;
         return true;
     }
     
@@ -6,6 +6,7 @@
 #include <unordered_map>
 #include <functional>
 #include <memory>
+#include "route_metrics.h"
 
 namespace cweb {
 
@@ -158,9 +159,11 @@ public:
 class Router {
 private:
     std::unordered_map<std::string, Trie*> roots_;
+    std::unique_ptr<RouteMetrics> metrics_;
     bool findRoute(Context *c);
 
 public:
+    Router() : metrics_(new RouteMetrics()) {}
     virtual ~Router() {
         for(auto it = roots_.begin(); it != roots_.end(); ++it) {
             delete it->second;
@@ -170,6 +173,8 @@ public:
     void AddRouter(const std::string& method, const std::string& pattern, ContextHandler handler);
     
     void Handle(std::shared_ptr<Context> c);
+    
+    RouteMetrics* Metrics() const {return metrics_.get();}
 };
 
 
@@ -52,6 +52,83 @@ public:
     uint64_t timeout_ms = 100;
 };
 
+class CoroutineConfig {
+public:
+    //连接、请求处理协程的栈大小
+    size_t handler_stack_size = 256 * 1024;
+    //定时器、跨线程任务等轻量协程的栈大小，不小于 StackPool::kMinStackSize(32KB)
+    size_t task_stack_size = 64 * 1024;
+    //栈底 PROT_NONE 保护区的大小，按页取整
+    size_t stack_guard_size = 16 * 1024;
+    //每个loop缓存的空闲栈上限
+    size_t max_cached_stacks = 128;
+    //空闲超过该时间的栈归还物理内存
+    uint64_t stack_trim_idle_ms = 10 * 1000;
+    //共享栈模式：协程在少量共享栈上运行，挂起时只保存已使用的栈内容，适合大量空闲长连接
+    bool shared_stack = false;
+    size_t shared_stack_count = 4;
+    //每个loop缓存的已结束协程对象上限，复用时连同栈一起复用
+    size_t max_cached_coroutines = 1024;
+    //空闲的loop从其他loop窃取未绑定连接的协程
+    bool work_stealing = true;
+    size_t steal_deque_capacity = 1024;
+    //连接读写挂起的超时，超时后 read/write 返回 EAGAIN 由调用方处理，< 0 不超时
+    int64_t read_timeout_ms = 10 * 1000;
+    int64_t write_timeout_ms = 10 * 1000;
+    //每轮事件循环最多恢复的协程次数，用完后回到 Poll 处理网络事件，0 不限制
+    size_t run_batch = 256;
+    //每轮事件循环执行协程的时间片(微秒)，超过后回到 Poll，0 不限制
+    uint64_t run_slice_us = 2000;
+    //调度统计：各优先级的排队时延、协程运行与挂起时间，每次切换多读一次时钟
+    bool sched_stats = true;
+};
+
+class OffloadConfig {
+public:
+    //阻塞操作卸载线程池的线程数
+    size_t threads = 4;
+    //排队任务上限，超过后由调用方直接执行
+    size_t queue_capacity = 1024;
+};
+
+class HttpConfig {
+public:
+    //单个连接最多处理的请求数，达到后响应 Connection: close，0 不限制
+    size_t max_keepalive_requests = 1000;
+    //从收到请求开始到请求头接收完整的时限，防止慢速发送请求头占用连接
+    int64_t header_timeout_ms = 10 * 1000;
+    //两次请求之间的空闲时限，超时关闭连接，通过 Keep-Alive: timeout 告知客户端
+    int64_t keepalive_timeout_ms = 60 * 1000;
+    //使用 SIMD 扫描的快速请求解析，分块、升级等请求仍由 http_parser 处理，扫描实现见 http_scan.h
+    bool fast_parser = true;
+    //流式响应在待发送数据(含投递途中和等待前面请求而缓存的)超过该值时 ChunkedWriter::Writable 返回 false，生成方应等待 OnWritable
+    size_t stream_high_water_bytes = 1024 * 1024;
+};
+
+class CompressConfig {
+public:
+    //zlib 压缩级别 1-9，越大压缩率越高、CPU 开销越大
+    int level = 6;
+    //小于该大小的动态响应不压缩
+    size_t min_size = 1024;
+    //静态文件预压缩结果的缓存上限，按最近使用淘汰
+    size_t file_cache_bytes = 64 * 1024 * 1024;
+    //超过该大小的文件不压缩，避免在loop中长时间压缩
+    size_t max_file_size = 4 * 1024 * 1024;
+};
+
+class FileCacheConfig {
+public:
+    //超过该时间后下一次访问检查文件的修改时间和大小，期间文件的修改不可见
+    uint64_t ttl_ms = 1000;
+    //缓存的文件数上限，按最近使用淘汰
+    size_t max_files = 1024;
+    //不超过该大小的文件读入内存，更大的文件 mmap
+    size_t small_file_size = 256 * 1024;
+    //读入内存的文件内容总大小上限
+    size_t memory_bytes = 64 * 1024 * 1024;
+};
+
 class ElasticSearchConfig {
     
 };
@@ -4,15 +4,28 @@
 #include "lockfree_queue.h"
 #include <memory>
 #include <mutex>
+#include <condition_variable>
+#ifdef COROUTINE
+#include "co_sync.h"
+#endif
 
 using namespace cweb::util;
 
 template <typename T>
 class DBConnectionPool {
 protected:
+#ifdef COROUTINE
+    //连接耗尽时只挂起当前协程，不阻塞整个loop线程
+    typedef cweb::tcpserver::coroutine::CoMutex Mutex;
+    typedef cweb::tcpserver::coroutine::CoCondition Condition;
+#else
+    typedef std::mutex Mutex;
+    typedef std::condition_variable Condition;
+#endif
+
     std::shared_ptr<LockfreeQueue<std::shared_ptr<T>>> connections_;
-    std::mutex mutex_;
-    std::condition_variable cond_;
+    Mutex mutex_;
+    Condition cond_;
 
 public:
     DBConnectionPool() {}
@@ -22,7 +35,7 @@ public:
     
     std::shared_ptr<T> GetConnection() {
         std::shared_ptr<T> conn;
-        std::unique_lock<std::mutex> lock(mutex_);
+        std::unique_lock<Mutex> lock(mutex_);
         while(!connections_->MultiplePop(conn)) {
             cond_.wait(lock);
         }
@@ -32,7 +45,9 @@ public:
     
     bool ReleaseConnection(std::shared_ptr<T> conn) {
         connections_->MultiplePush(conn);
-        cond_.notify_all();
+        //持锁通知，避免与 GetConnection 中检查和等待之间的窗口丢失唤醒
+        std::unique_lock<Mutex> lock(mutex_);
+        cond_.notify_one();
         return true;
     }
 };
@@ -0,0 +1,64 @@
+#include "chunked_writer.h"
+#include "httpsession.h"
+
+namespace cweb {
+namespace httpserver {
+
+ChunkedWriter::ChunkedWriter(std::shared_ptr<HttpSession> session, uint64_t seq, bool chunked, std::shared_ptr<void> owner, size_t* owner_bytes)
+: session_(session), seq_(seq), chunked_(chunked), owner_(owner), owner_bytes_(owner_bytes) {}
+
+ChunkedWriter::~ChunkedWriter() {
+    Close();
+}
+
+bool ChunkedWriter::Write(const StringPiece& data) {
+    if(Closed()) return false;
+    if(data.Empty()) return true;
+    size_t size = session_->SendChunk(data, chunked_, seq_);
+    bytes_ += size;
+    if(owner_bytes_) *owner_bytes_ += size;
+    return true;
+}
+
+void ChunkedWriter::Close() {
+    if(closed_) return;
+    closed_ = true;
+    if(chunked_) {
+        size_t size = session_->SendChunk(StringPiece(), chunked_, seq_);
+        bytes_ += size;
+        if(owner_bytes_) *owner_bytes_ += size;
+    }
+    //释放 Context 后该请求的响应结束，后续请求的响应才会发送
+    owner_.reset();
+}
+
+bool ChunkedWriter::Closed() const {
+    return closed_ || !session_->Connected();
+}
+
+bool ChunkedWriter::Writable() const {
+    return !Closed() && session_->Writable(seq_);
+}
+
+void ChunkedWriter::OnWritable(std::function<void()> cb) {
+    session_->OnWriteComplete(std::move(cb), seq_);
+}
+
+void ChunkedWriter::Pump(Producer producer) {
+    while(!Closed()) {
+        if(!session_->Writable(seq_)) {
+            std::shared_ptr<ChunkedWriter> self = shared_from_this();
+            OnWritable([self, producer]() {
+                self->Pump(producer);
+            });
+            return;
+        }
+        if(!producer(*this)) {
+            Close();
+            return;
+        }
+    }
+}
+
+}
+}
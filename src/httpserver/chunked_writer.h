@@ -0,0 +1,58 @@
+#ifndef CWEB_HTTP_CHUNKEDWRITER_H_
+#define CWEB_HTTP_CHUNKEDWRITER_H_
+
+#include <memory>
+#include <functional>
+#include "bytebuffer.h"
+
+using namespace cweb::tcpserver;
+
+namespace cweb {
+namespace httpserver {
+
+class HttpSession;
+
+/*
+ Transfer-Encoding: chunked 的流式响应，响应头已由 HttpSession::SendChunkedHeader 发出，
+ 每次 Write 作为一个 chunk 和其他响应一样按请求顺序发送，Close 或析构时发送结束块并释放 owner(一般是 Context)
+ 可交给任意线程，同一时刻只在一个线程中使用
+ HTTP/1.0 的请求不分块，发送完关闭连接
+ */
+class ChunkedWriter : public std::enable_shared_from_this<ChunkedWriter> {
+private:
+    std::shared_ptr<HttpSession> session_;
+    uint64_t seq_;
+    bool chunked_;
+    std::shared_ptr<void> owner_;
+    //owner 中的响应字节计数，释放 owner 前累加
+    size_t* owner_bytes_;
+    bool closed_ = false;
+    size_t bytes_ = 0;
+    
+public:
+    //返回 false 时停止生成，Pump 随后关闭
+    typedef std::function<bool(ChunkedWriter&)> Producer;
+    
+    ChunkedWriter(std::shared_ptr<HttpSession> session, uint64_t seq, bool chunked, std::shared_ptr<void> owner, size_t* owner_bytes = nullptr);
+    ~ChunkedWriter();
+    
+    //数据不拷贝直接发送，需要缓存时由 HttpSession 拷贝；空数据忽略，已关闭或连接已断开返回 false
+    bool Write(const StringPiece& data);
+    void Close();
+    bool Closed() const;
+    //已发送的字节数，包含分块的格式
+    size_t Bytes() const {return bytes_;}
+    
+    //待发送的数据(含其他线程投递途中和排在前面的请求之后缓存的)未超过 HttpConfig::stream_high_water_bytes，否则应停止写入等待 OnWritable
+    bool Writable() const;
+    //轮到该响应发送且待发送的数据全部写出后在连接所属loop中回调，连接关闭时不回调
+    void OnWritable(std::function<void()> cb);
+    //可写时反复调用 producer 生成数据，超过高水位后暂停，写出后在loop中继续，producer 返回 false 后关闭
+    //协程版写满时写入的协程挂起，之后的数据在 session 中排队，同样计入高水位
+    void Pump(Producer producer);
+};
+
+}
+}
+
+#endif
@@ -0,0 +1,162 @@
+#include "file_cache.h"
+#include "httpresponse.h"
+#include "metrics.h"
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <chrono>
+#include <stdio.h>
+
+namespace cweb {
+namespace httpserver {
+
+FileContent::~FileContent() {
+    if(map_) munmap(map_, size_);
+}
+
+std::shared_ptr<const FileContent> FileContent::Load(const std::string& filepath, size_t size, bool in_memory) {
+    int fd = open(filepath.c_str(), O_RDONLY);
+    if(fd < 0) return nullptr;
+    std::shared_ptr<FileContent> content(new FileContent());
+    content->size_ = size;
+    if(size == 0) {
+        //空文件不能 mmap
+    }else if(in_memory) {
+        content->buffer_.resize(size);
+        size_t offset = 0;
+        while(offset < size) {
+            ssize_t n = read(fd, &content->buffer_[offset], size - offset);
+            if(n <= 0) break;
+            offset += n;
+        }
+        if(offset != size) content = nullptr;
+        else content->data_ = content->buffer_.data();
+    }else {
+        //映射建立后不再需要 fd
+        void* map = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if(map == MAP_FAILED) {
+            content = nullptr;
+        }else {
+            content->map_ = map;
+            content->data_ = (const char*)map;
+        }
+    }
+    close(fd);
+    return content;
+}
+
+FileCache::FileCache() {
+    util::MetricsRegistrySingleton::GetInstance()->Register("file_cache", [this](std::string& out){
+        util::MetricsRegistry::AppendCounter(out, "cweb_file_cache_hits_total", "", hits_.load(std::memory_order_relaxed));
+        util::MetricsRegistry::AppendCounter(out, "cweb_file_cache_misses_total", "", misses_.load(std::memory_order_relaxed));
+        util::MetricsRegistry::AppendCounter(out, "cweb_file_cache_reloads_total", "", reloads_.load(std::memory_order_relaxed));
+        std::unique_lock<std::mutex> lock(mutex_);
+        util::MetricsRegistry::AppendGauge(out, "cweb_file_cache_files", "", (double)files_.size());
+        util::MetricsRegistry::AppendGauge(out, "cweb_file_cache_memory_bytes", "", (double)memory_bytes_);
+    });
+}
+
+FileCache::~FileCache() {
+    util::MetricsRegistrySingleton::GetInstance()->Unregister("file_cache");
+}
+
+uint64_t FileCache::nowMs() {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+std::shared_ptr<const CachedFile> FileCache::Get(const std::string& filepath) {
+    uint64_t now = nowMs();
+    std::shared_ptr<const CachedFile> cached;
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        auto iter = files_.find(filepath);
+        if(iter != files_.end()) {
+            Entry& entry = iter->second;
+            lru_.splice(lru_.begin(), lru_, entry.lru);
+            if(now - entry.checked_ms < config_.ttl_ms) {
+                hits_.fetch_add(1, std::memory_order_relaxed);
+                return entry.file;
+            }
+            cached = entry.file;
+        }
+    }
+
+    //超时或未命中，stat 和加载不加锁
+    struct stat st;
+    if(stat(filepath.c_str(), &st) != 0 || !S_ISREG(st.st_mode)) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        auto iter = files_.find(filepath);
+        if(iter != files_.end()) erase(iter);
+        misses_.fetch_add(1, std::memory_order_relaxed);
+        return nullptr;
+    }
+
+    std::shared_ptr<const CachedFile> file;
+    if(cached && cached->mtime == st.st_mtime && cached->size == st.st_size) {
+        hits_.fetch_add(1, std::memory_order_relaxed);
+        file = cached;
+    }else {
+        if(cached) reloads_.fetch_add(1, std::memory_order_relaxed);
+        else misses_.fetch_add(1, std::memory_order_relaxed);
+        file = load(filepath, st.st_size, st.st_mtime);
+        if(!file) return nullptr;
+    }
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    insert(file, now);
+    return file;
+}
+
+std::shared_ptr<const CachedFile> FileCache::load(const std::string& filepath, off_t size, time_t mtime) {
+    std::shared_ptr<CachedFile> file = std::make_shared<CachedFile>();
+    file->path = filepath;
+    file->size = size;
+    file->mtime = mtime;
+    file->mime = HttpResponse::MimeType(filepath);
+    char etag[48];
+    int n = snprintf(etag, sizeof(etag), "\"%llx-%llx\"", (unsigned long long)mtime, (unsigned long long)size);
+    file->etag.assign(etag, n);
+    file->last_modified = HttpResponse::HttpDate(mtime);
+    file->content = FileContent::Load(filepath, size, (size_t)size <= config_.small_file_size);
+    if(!file->content) return nullptr;
+    return file;
+}
+
+void FileCache::insert(std::shared_ptr<const CachedFile> file, uint64_t now) {
+    auto iter = files_.find(file->path);
+    if(iter != files_.end()) {
+        Entry& entry = iter->second;
+        if(entry.file != file) {
+            if(entry.file->content->InMemory()) memory_bytes_ -= entry.file->content->Size();
+            if(file->content->InMemory()) memory_bytes_ += file->content->Size();
+            entry.file = std::move(file);
+        }
+        entry.checked_ms = now;
+        lru_.splice(lru_.begin(), lru_, entry.lru);
+    }else {
+        lru_.push_front(file->path);
+        Entry& entry = files_[file->path];
+        if(file->content->InMemory()) memory_bytes_ += file->content->Size();
+        entry.file = std::move(file);
+        entry.checked_ms = now;
+        entry.lru = lru_.begin();
+    }
+    evict();
+}
+
+void FileCache::erase(EntryMap::iterator iter) {
+    Entry& entry = iter->second;
+    if(entry.file->content->InMemory()) memory_bytes_ -= entry.file->content->Size();
+    lru_.erase(entry.lru);
+    files_.erase(iter);
+}
+
+void FileCache::evict() {
+    while(files_.size() > 1 && (files_.size() > config_.max_files || memory_bytes_ > config_.memory_bytes)) {
+        erase(files_.find(lru_.back()));
+    }
+}
+
+}
+}
@@ -0,0 +1,92 @@
+#ifndef CWEB_HTTP_FILECACHE_H_
+#define CWEB_HTTP_FILECACHE_H_
+
+#include <string>
+#include <list>
+#include <mutex>
+#include <memory>
+#include <atomic>
+#include <unordered_map>
+#include <sys/types.h>
+#include "noncopyable.h"
+#include "singleton.h"
+#include "cweb_config.h"
+
+namespace cweb {
+namespace httpserver {
+
+//文件内容，小文件读入内存，大文件 mmap，最后一个引用释放时 munmap
+class FileContent : public util::Noncopyable {
+public:
+    ~FileContent();
+    static std::shared_ptr<const FileContent> Load(const std::string& filepath, size_t size, bool in_memory);
+
+    const char* Data() const {return data_;}
+    size_t Size() const {return size_;}
+    bool InMemory() const {return map_ == nullptr;}
+
+private:
+    FileContent() {}
+    std::string buffer_;
+    void* map_ = nullptr;
+    const char* data_ = nullptr;
+    size_t size_ = 0;
+};
+
+//不可变，文件修改后缓存中换成新的对象，正在发送的响应继续持有旧内容
+struct CachedFile {
+    std::string path;
+    off_t size;
+    time_t mtime;
+    const char* mime;
+    std::string etag;               //"修改时间-大小"，带引号
+    std::string last_modified;
+    std::shared_ptr<const FileContent> content;
+};
+
+/*
+ 静态文件缓存：stat 结果、MIME 类型和文件内容(小文件在内存中，大文件保持映射)
+ 命中且未超过 FileCacheConfig::ttl_ms 时不访问文件系统，超时后 stat 一次，修改时间或大小变化时重新加载
+ 命中、未命中和重新加载次数通过 /metrics 输出(cweb_file_cache_*)
+ */
+class FileCache : public util::Noncopyable {
+public:
+    FileCache();
+    ~FileCache();
+
+    //不是普通文件或打开失败返回 nullptr
+    std::shared_ptr<const CachedFile> Get(const std::string& filepath);
+
+private:
+    struct Entry {
+        std::shared_ptr<const CachedFile> file;
+        uint64_t checked_ms;
+        std::list<std::string>::iterator lru;
+    };
+    typedef std::unordered_map<std::string, Entry> EntryMap;
+
+    FileCacheConfig config_;
+    std::mutex mutex_;
+    //最近使用的在前
+    std::list<std::string> lru_;
+    EntryMap files_;
+    size_t memory_bytes_ = 0;
+
+    std::atomic<uint64_t> hits_ = {0};
+    std::atomic<uint64_t> misses_ = {0};
+    std::atomic<uint64_t> reloads_ = {0};
+
+    static uint64_t nowMs();
+    std::shared_ptr<const CachedFile> load(const std::string& filepath, off_t size, time_t mtime);
+    //需持有 mutex_
+    void insert(std::shared_ptr<const CachedFile> file, uint64_t now);
+    void erase(EntryMap::iterator iter);
+    void evict();
+};
+
+typedef cweb::util::Singleton<FileCache> FileCacheSingleton;
+
+}
+}
+
+#endif
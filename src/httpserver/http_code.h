@@ -6,11 +6,39 @@
 
 namespace cweb {
 
+//状态行见 HttpResponse::StatusLine，未列出的标准状态码可以直接转换使用
 enum HttpStatusCode {
+    StatusSwitchingProtocols = 101,
+    
     StatusOK = 200,
+    StatusCreated = 201,
+    StatusAccepted = 202,
+    StatusNoContent = 204,
+    StatusPartialContent = 206,
+    
     StatusMovedPermanently = 301,
+    StatusFound = 302,
+    StatusSeeOther = 303,
+    StatusNotModified = 304,
+    StatusTemporaryRedirect = 307,
+    StatusPermanentRedirect = 308,
+    
     StatusBadRequest = 400,
+    StatusUnauthorized = 401,
+    StatusForbidden = 403,
     StatusNotFound = 404,
+    StatusMethodNotAllowed = 405,
+    StatusRequestTimeout = 408,
+    StatusPayloadTooLarge = 413,
+    StatusRangeNotSatisfiable = 416,
+    StatusTooManyRequests = 429,
+    StatusRequestHeaderFieldsTooLarge = 431,
+    
+    StatusInternalServerError = 500,
+    StatusNotImplemented = 501,
+    StatusBadGateway = 502,
+    StatusServiceUnavailable = 503,
+    StatusGatewayTimeout = 504,
 };
 
 }
@@ -0,0 +1,238 @@
+#include "http_compress.h"
+#include "metrics.h"
+#include "file_cache.h"
+#include <zlib.h>
+#include <string.h>
+#include <strings.h>
+#include <chrono>
+
+namespace cweb {
+namespace httpserver {
+
+static StringPiece trim(const char* begin, const char* end) {
+    while(begin < end && (*begin == ' ' || *begin == '\t')) ++begin;
+    while(end > begin && (end[-1] == ' ' || end[-1] == '\t')) --end;
+    return StringPiece(begin, end - begin);
+}
+
+// q 值只有三位小数，按千分制比较
+static int parseQuality(const char* begin, const char* end) {
+    int q = 1000;
+    while(begin < end) {
+        const char* semi = (const char*)memchr(begin, ';', end - begin);
+        StringPiece param = trim(begin, semi ? semi : end);
+        begin = semi ? semi + 1 : end;
+        if(param.Size() < 2 || (param.Data()[0] != 'q' && param.Data()[0] != 'Q') || param.Data()[1] != '=') continue;
+        const char* p = param.Data() + 2;
+        const char* pend = param.Data() + param.Size();
+        q = 0;
+        if(p < pend && *p == '1') {
+            q = 1000;
+        }else if(p < pend && *p == '0') {
+            ++p;
+            if(p < pend && *p == '.') ++p;
+            int scale = 100;
+            while(p < pend && *p >= '0' && *p <= '9' && scale > 0) {
+                q += (*p - '0') * scale;
+                scale /= 10;
+                ++p;
+            }
+        }
+    }
+    return q;
+}
+
+ContentEncoding NegotiateEncoding(const StringPiece& accept_encoding) {
+    //-1 表示没有出现
+    int quality[kContentEncodingCount] = {-1, -1, -1};
+    int any = -1;
+    const char* p = accept_encoding.Data();
+    const char* end = p + accept_encoding.Size();
+    while(p < end) {
+        const char* comma = (const char*)memchr(p, ',', end - p);
+        const char* item_end = comma ? comma : end;
+        const char* semi = (const char*)memchr(p, ';', item_end - p);
+        StringPiece name = trim(p, semi ? semi : item_end);
+        int q = semi ? parseQuality(semi + 1, item_end) : 1000;
+        if(name.EqualsIgnoreCase("gzip") || name.EqualsIgnoreCase("x-gzip")) {
+            quality[EncodingGzip] = q;
+        }else if(name.EqualsIgnoreCase("deflate")) {
+            quality[EncodingDeflate] = q;
+        }else if(name == StringPiece("*", 1)) {
+            any = q;
+        }
+        p = comma ? comma + 1 : end;
+    }
+    
+    ContentEncoding best = EncodingIdentity;
+    int best_q = 0;
+    for(int i = EncodingGzip; i < kContentEncodingCount; ++i) {
+        int q = quality[i] >= 0 ? quality[i] : any;
+        if(q > best_q) {
+            best = (ContentEncoding)i;
+            best_q = q;
+        }
+    }
+    return best;
+}
+
+const char* ContentEncodingName(ContentEncoding encoding) {
+    switch(encoding) {
+        case EncodingGzip: return "gzip";
+        case EncodingDeflate: return "deflate";
+        default: return "identity";
+    }
+}
+
+static bool containsIgnoreCase(const StringPiece& s, const char* word) {
+    size_t len = strlen(word);
+    for(size_t i = 0; i + len <= s.Size(); ++i) {
+        if(strncasecmp(s.Data() + i, word, len) == 0) return true;
+    }
+    return false;
+}
+
+bool CompressibleType(const StringPiece& content_type) {
+    static const char* kTypes[] = {"json", "javascript", "xml", "wasm"};
+    if(content_type.Size() >= 5 && strncasecmp(content_type.Data(), "text/", 5) == 0) return true;
+    for(const char* type : kTypes) {
+        if(containsIgnoreCase(content_type, type)) return true;
+    }
+    return false;
+}
+
+// 每个线程复用一个 z_stream，避免每次压缩都分配约 256KB 的窗口和哈希表
+struct Deflater {
+    z_stream stream;
+    bool initialized = false;
+    int level = 0;
+    int window_bits = 0;
+    
+    ~Deflater() {
+        if(initialized) deflateEnd(&stream);
+    }
+    
+    bool Reset(int new_level, int new_window_bits) {
+        if(initialized && level == new_level && window_bits == new_window_bits) {
+            return deflateReset(&stream) == Z_OK;
+        }
+        if(initialized) deflateEnd(&stream);
+        memset(&stream, 0, sizeof(stream));
+        initialized = deflateInit2(&stream, new_level, Z_DEFLATED, new_window_bits, 8, Z_DEFAULT_STRATEGY) == Z_OK;
+        level = new_level;
+        window_bits = new_window_bits;
+        return initialized;
+    }
+};
+
+static thread_local Deflater deflater;
+
+HttpCompression::HttpCompression() {
+    for(int i = 0; i < kContentEncodingCount; ++i) {
+        compressed_[i] = 0;
+    }
+    util::MetricsRegistrySingleton::GetInstance()->Register("compress", [this](std::string& out){
+        for(int i = EncodingGzip; i < kContentEncodingCount; ++i) {
+            std::string labels = std::string("encoding=\"") + ContentEncodingName((ContentEncoding)i) + "\"";
+            util::MetricsRegistry::AppendCounter(out, "cweb_compress_total", labels, compressed_[i].load(std::memory_order_relaxed));
+        }
+        util::MetricsRegistry::AppendCounter(out, "cweb_compress_input_bytes_total", "", input_bytes_.load(std::memory_order_relaxed));
+        util::MetricsRegistry::AppendCounter(out, "cweb_compress_output_bytes_total", "", output_bytes_.load(std::memory_order_relaxed));
+        util::MetricsRegistry::AppendCounter(out, "cweb_compress_cpu_us_total", "", cpu_us_.load(std::memory_order_relaxed));
+        util::MetricsRegistry::AppendCounter(out, "cweb_compress_file_cache_hits_total", "", file_hits_.load(std::memory_order_relaxed));
+        util::MetricsRegistry::AppendCounter(out, "cweb_compress_file_cache_misses_total", "", file_misses_.load(std::memory_order_relaxed));
+        std::unique_lock<std::mutex> lock(mutex_);
+        util::MetricsRegistry::AppendGauge(out, "cweb_compress_file_cache_bytes", "", (double)file_bytes_);
+    });
+}
+
+HttpCompression::~HttpCompression() {
+    util::MetricsRegistrySingleton::GetInstance()->Unregister("compress");
+}
+
+bool HttpCompression::Compress(ContentEncoding encoding, int level, const char* data, size_t size, std::string& out) {
+    if(encoding == EncodingIdentity || size > UINT32_MAX) return false;
+    if(level < 0) level = config_.level;
+    auto start = std::chrono::steady_clock::now();
+    
+    //gzip 为 deflate 数据加 gzip 头尾，HTTP 的 deflate 指 zlib 格式
+    if(!deflater.Reset(level, encoding == EncodingGzip ? 15 + 16 : 15)) return false;
+    z_stream& stream = deflater.stream;
+    out.resize(deflateBound(&stream, (uLong)size));
+    stream.next_in = (Bytef*)data;
+    stream.avail_in = (uInt)size;
+    stream.next_out = (Bytef*)&out[0];
+    stream.avail_out = (uInt)out.size();
+    int ret = deflate(&stream, Z_FINISH);
+    out.resize(stream.total_out);
+    
+    uint64_t us = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+    cpu_us_.fetch_add(us, std::memory_order_relaxed);
+    //压缩后没有变小的按原样发送
+    if(ret != Z_STREAM_END || out.size() >= size) return false;
+    compressed_[encoding].fetch_add(1, std::memory_order_relaxed);
+    input_bytes_.fetch_add(size, std::memory_order_relaxed);
+    output_bytes_.fetch_add(out.size(), std::memory_order_relaxed);
+    return true;
+}
+
+std::shared_ptr<const std::string> HttpCompression::CompressedFile(const std::string& filepath, ContentEncoding encoding, int level) {
+    if(encoding == EncodingIdentity) return nullptr;
+    //修改时间和大小来自 FileCache，命中时不访问文件系统
+    std::shared_ptr<const CachedFile> file = FileCacheSingleton::GetInstance()->Get(filepath);
+    if(!file || (size_t)file->size < config_.min_size || (size_t)file->size > config_.max_file_size) return nullptr;
+    if(level < 0) level = config_.level;
+    
+    std::string key = filepath;
+    key += '\0';
+    key += (char)('0' + encoding);
+    key += (char)('0' + level);
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        auto iter = file_index_.find(key);
+        if(iter != file_index_.end() && iter->second->mtime == file->mtime && iter->second->size == file->size) {
+            files_.splice(files_.begin(), files_, iter->second);
+            file_hits_.fetch_add(1, std::memory_order_relaxed);
+            return iter->second->data;
+        }
+    }
+    file_misses_.fetch_add(1, std::memory_order_relaxed);
+    
+    //压缩不加锁，同一文件并发未命中时各自压缩一次，结果相同
+    std::string compressed;
+    std::shared_ptr<const std::string> data;
+    if(Compress(encoding, level, file->content->Data(), file->content->Size(), compressed)) {
+        data = std::make_shared<const std::string>(std::move(compressed));
+    }
+    
+    //压缩后没有变小的也缓存，之后直接按原样发送
+    std::unique_lock<std::mutex> lock(mutex_);
+    auto iter = file_index_.find(key);
+    if(iter != file_index_.end()) {
+        if(iter->second->data) file_bytes_ -= iter->second->data->size();
+        files_.erase(iter->second);
+        file_index_.erase(iter);
+    }
+    FileEntry entry;
+    entry.key = key;
+    entry.mtime = file->mtime;
+    entry.size = file->size;
+    entry.data = data;
+    files_.push_front(std::move(entry));
+    file_index_[key] = files_.begin();
+    if(data) file_bytes_ += data->size();
+    evictFiles();
+    return data;
+}
+
+void HttpCompression::evictFiles() {
+    while(file_bytes_ > config_.file_cache_bytes && files_.size() > 1) {
+        FileEntry& entry = files_.back();
+        if(entry.data) file_bytes_ -= entry.data->size();
+        file_index_.erase(entry.key);
+        files_.pop_back();
+    }
+}
+
+}
+}
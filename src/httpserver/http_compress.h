@@ -0,0 +1,80 @@
+#ifndef CWEB_HTTP_HTTPCOMPRESS_H_
+#define CWEB_HTTP_HTTPCOMPRESS_H_
+
+#include <string>
+#include <list>
+#include <mutex>
+#include <memory>
+#include <atomic>
+#include <unordered_map>
+#include <sys/stat.h>
+#include "bytebuffer.h"
+#include "singleton.h"
+#include "cweb_config.h"
+
+using namespace cweb::tcpserver;
+
+namespace cweb {
+namespace httpserver {
+
+enum ContentEncoding {
+    EncodingIdentity,
+    EncodingGzip,
+    EncodingDeflate,
+    kContentEncodingCount
+};
+
+//按 Accept-Encoding 的 q 值选择，同等时优先 gzip，都不接受时为 EncodingIdentity
+ContentEncoding NegotiateEncoding(const StringPiece& accept_encoding);
+const char* ContentEncodingName(ContentEncoding encoding);
+//文本类的响应才值得压缩，图片、视频等已经是压缩格式
+bool CompressibleType(const StringPiece& content_type);
+
+/*
+ 响应压缩：动态响应按需压缩，静态文件的压缩结果按路径和修改时间缓存，内容不可变，多个响应共享
+ 压缩次数、前后字节数和耗时通过 /metrics 输出(cweb_compress_*)
+ */
+class HttpCompression : public util::Noncopyable {
+public:
+    HttpCompression();
+    ~HttpCompression();
+    
+    //level < 0 使用 CompressConfig::level
+    bool Compress(ContentEncoding encoding, int level, const char* data, size_t size, std::string& out);
+    //文件已修改时重新压缩，文件不存在、过小、过大或压缩后没有变小返回 nullptr
+    std::shared_ptr<const std::string> CompressedFile(const std::string& filepath, ContentEncoding encoding, int level);
+    
+    size_t MinSize() const {return config_.min_size;}
+    
+private:
+    struct FileEntry {
+        std::string key;
+        time_t mtime;
+        off_t size;
+        std::shared_ptr<const std::string> data;
+    };
+    
+    CompressConfig config_;
+    std::mutex mutex_;
+    //最近使用的在前
+    std::list<FileEntry> files_;
+    std::unordered_map<std::string, std::list<FileEntry>::iterator> file_index_;
+    size_t file_bytes_ = 0;
+    
+    std::atomic<uint64_t> compressed_[kContentEncodingCount];
+    std::atomic<uint64_t> input_bytes_ = {0};
+    std::atomic<uint64_t> output_bytes_ = {0};
+    std::atomic<uint64_t> cpu_us_ = {0};
+    std::atomic<uint64_t> file_hits_ = {0};
+    std::atomic<uint64_t> file_misses_ = {0};
+    
+    //需持有 mutex_
+    void evictFiles();
+};
+
+typedef cweb::util::Singleton<HttpCompression> HttpCompressionSingleton;
+
+}
+}
+
+#endif
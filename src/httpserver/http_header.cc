@@ -0,0 +1,163 @@
+#include "http_header.h"
+#include <strings.h>
+
+namespace cweb {
+
+struct HeaderName {
+    const char* name;
+    size_t len;
+};
+
+static constexpr HeaderName kHeaderNames[kHttpHeaderCount] = {
+    {"Accept", 6},
+    {"Accept-Charset", 14},
+    {"Accept-Encoding", 15},
+    {"Accept-Language", 15},
+    {"Accept-Ranges", 13},
+    {"Access-Control-Allow-Credentials", 32},
+    {"Access-Control-Allow-Headers", 28},
+    {"Access-Control-Allow-Methods", 28},
+    {"Access-Control-Allow-Origin", 27},
+    {"Access-Control-Expose-Headers", 29},
+    {"Access-Control-Max-Age", 22},
+    {"Access-Control-Request-Headers", 30},
+    {"Access-Control-Request-Method", 29},
+    {"Age", 3},
+    {"Allow", 5},
+    {"Authorization", 13},
+    {"Cache-Control", 13},
+    {"Connection", 10},
+    {"Content-Disposition", 19},
+    {"Content-Encoding", 16},
+    {"Content-Language", 16},
+    {"Content-Length", 14},
+    {"Content-Location", 16},
+    {"Content-Range", 13},
+    {"Content-Type", 12},
+    {"Cookie", 6},
+    {"Date", 4},
+    {"ETag", 4},
+    {"Expect", 6},
+    {"Expires", 7},
+    {"Forwarded", 9},
+    {"From", 4},
+    {"Host", 4},
+    {"If-Match", 8},
+    {"If-Modified-Since", 17},
+    {"If-None-Match", 13},
+    {"If-Range", 8},
+    {"If-Unmodified-Since", 19},
+    {"Keep-Alive", 10},
+    {"Last-Modified", 13},
+    {"Link", 4},
+    {"Location", 8},
+    {"Max-Forwards", 12},
+    {"Origin", 6},
+    {"Pragma", 6},
+    {"Proxy-Authenticate", 18},
+    {"Proxy-Authorization", 19},
+    {"Range", 5},
+    {"Referer", 7},
+    {"Retry-After", 11},
+    {"Sec-WebSocket-Accept", 20},
+    {"Sec-WebSocket-Extensions", 24},
+    {"Sec-WebSocket-Key", 17},
+    {"Sec-WebSocket-Protocol", 22},
+    {"Sec-WebSocket-Version", 21},
+    {"Server", 6},
+    {"Set-Cookie", 10},
+    {"TE", 2},
+    {"Trailer", 7},
+    {"Transfer-Encoding", 17},
+    {"Upgrade", 7},
+    {"User-Agent", 10},
+    {"Vary", 4},
+    {"Via", 3},
+    {"WWW-Authenticate", 16},
+    {"X-Forwarded-For", 15},
+    {"X-Forwarded-Host", 16},
+    {"X-Forwarded-Proto", 17},
+    {"X-Real-IP", 9},
+    {"X-Request-ID", 12},
+};
+
+/*
+ 完美哈希：由长度和首、中、末、倒数第三个字符(|0x20 不区分大小写)线性组合得到 0~255 的槽位，
+ 表中每个 header 占据不同的槽位，查找时只需一次哈希和一次比较。
+ kHeaderSlots[headerHash(name)] 为 header 的下标，其余为 kEmptySlot，由下面的 static_assert 在编译期校验；
+ 增删 header 后需重新搜索系数使其不冲突，并重新生成 kHeaderSlots
+ */
+static constexpr unsigned kHashLen = 136;
+static constexpr unsigned kHashFirst = 18;
+static constexpr unsigned kHashMiddle = 241;
+static constexpr unsigned kHashLast = 130;
+static constexpr unsigned kHashLast3 = 172;
+static constexpr unsigned char kEmptySlot = 255;
+
+static constexpr unsigned char kHeaderSlots[256] = {
+    255, 255, 255, 255,  51,  43, 255, 255, 255,   7, 255, 255, 255,  49, 255,  25,
+      5, 255, 255,  56, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255,  35,
+     24, 255, 255,  28,  14,  36,  65, 255,  40, 255, 255, 255, 255,  58, 255,  32,
+    255, 255, 255, 255, 255,  50, 255,  53, 255, 255, 255, 255, 255,  30, 255,  12,
+    255, 255, 255, 255,  23, 255, 255,  63,  46, 255,  10, 255, 255,  48, 255,  18,
+    255,   6, 255,  39, 255, 255,  11, 255, 255, 255,  42, 255,  62, 255, 255, 255,
+    255,  54, 255, 255, 255,  19, 255,  59, 255,  64, 255, 255,  47, 255, 255, 255,
+    255, 255, 255, 255,  41,  34, 255, 255, 255, 255, 255, 255, 255,  44, 255, 255,
+    255,  16, 255, 255, 255, 255, 255, 255,  55, 255,  22, 255, 255, 255,  67, 255,
+     66, 255, 255, 255, 255, 255, 255,  57,  20, 255, 255, 255, 255, 255, 255,  61,
+    255,   1, 255, 255, 255,  68, 255, 255, 255,  29, 255, 255, 255, 255, 255, 255,
+    255,   4,  37,  33, 255, 255, 255, 255, 255,   2,  60, 255, 255,  31, 255, 255,
+    255, 255, 255, 255, 255, 255, 255,  21, 255,  27, 255, 255, 255, 255,  45, 255,
+    255, 255,  26, 255, 255, 255, 255,  13, 255,   9, 255,   0, 255, 255, 255, 255,
+    255,  17, 255, 255, 255, 255,   8, 255, 255,  69, 255, 255,   3, 255, 255, 255,
+    255, 255, 255,  52, 255, 255, 255, 255, 255, 255, 255,  15, 255,  38, 255, 255,
+};
+
+static constexpr unsigned lowerChar(const char* name, size_t i) {
+    return (unsigned char)name[i] | 0x20;
+}
+
+static constexpr unsigned headerHash(const char* name, size_t len) {
+    return ((unsigned)len * kHashLen
+            + lowerChar(name, 0) * kHashFirst
+            + lowerChar(name, len / 2) * kHashMiddle
+            + lowerChar(name, len - 1) * kHashLast
+            + (len >= 3 ? lowerChar(name, len - 3) : 0) * kHashLast3) & 255;
+}
+
+//C++11 的 constexpr 函数只能有一条 return，用递归遍历
+static constexpr size_t nameLength(const char* name) {
+    return *name ? 1 + nameLength(name + 1) : 0;
+}
+
+//每个 header 的长度正确，且其哈希槽位指向自己(两个 header 不可能占据同一槽位)
+static constexpr bool headersInSlots(size_t i) {
+    return i == kHttpHeaderCount
+        || (kHeaderNames[i].len == nameLength(kHeaderNames[i].name)
+            && kHeaderSlots[headerHash(kHeaderNames[i].name, kHeaderNames[i].len)] == i
+            && headersInSlots(i + 1));
+}
+
+//表中没有多余的槽位
+static constexpr size_t usedSlots(size_t i) {
+    return i == 256 ? 0 : (kHeaderSlots[i] != kEmptySlot) + usedSlots(i + 1);
+}
+
+static_assert(headersInSlots(0), "kHeaderSlots does not match kHeaderNames, regenerate the perfect hash");
+static_assert(usedSlots(0) == kHttpHeaderCount, "kHeaderSlots has slots for unknown headers");
+
+HttpHeader LookupHttpHeader(const char* name, size_t len) {
+    if(len == 0) return HeaderUnknown;
+    unsigned char slot = kHeaderSlots[headerHash(name, len)];
+    if(slot == kEmptySlot) return HeaderUnknown;
+    const HeaderName& candidate = kHeaderNames[slot];
+    if(candidate.len != len || strncasecmp(candidate.name, name, len) != 0) return HeaderUnknown;
+    return (HttpHeader)slot;
+}
+
+const char* HttpHeaderName(HttpHeader header) {
+    if(header >= kHttpHeaderCount) return "";
+    return kHeaderNames[header].name;
+}
+
+}
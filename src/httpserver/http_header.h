@@ -0,0 +1,91 @@
+#ifndef CWEB_HTTP_HTTPHEADER_H_
+#define CWEB_HTTP_HTTPHEADER_H_
+
+#include <stddef.h>
+
+namespace cweb {
+
+//常用的 http header，解析时归类一次，之后按下标访问
+enum HttpHeader {
+    HeaderAccept,
+    HeaderAcceptCharset,
+    HeaderAcceptEncoding,
+    HeaderAcceptLanguage,
+    HeaderAcceptRanges,
+    HeaderAccessControlAllowCredentials,
+    HeaderAccessControlAllowHeaders,
+    HeaderAccessControlAllowMethods,
+    HeaderAccessControlAllowOrigin,
+    HeaderAccessControlExposeHeaders,
+    HeaderAccessControlMaxAge,
+    HeaderAccessControlRequestHeaders,
+    HeaderAccessControlRequestMethod,
+    HeaderAge,
+    HeaderAllow,
+    HeaderAuthorization,
+    HeaderCacheControl,
+    HeaderConnection,
+    HeaderContentDisposition,
+    HeaderContentEncoding,
+    HeaderContentLanguage,
+    HeaderContentLength,
+    HeaderContentLocation,
+    HeaderContentRange,
+    HeaderContentType,
+    HeaderCookie,
+    HeaderDate,
+    HeaderETag,
+    HeaderExpect,
+    HeaderExpires,
+    HeaderForwarded,
+    HeaderFrom,
+    HeaderHost,
+    HeaderIfMatch,
+    HeaderIfModifiedSince,
+    HeaderIfNoneMatch,
+    HeaderIfRange,
+    HeaderIfUnmodifiedSince,
+    HeaderKeepAlive,
+    HeaderLastModified,
+    HeaderLink,
+    HeaderLocation,
+    HeaderMaxForwards,
+    HeaderOrigin,
+    HeaderPragma,
+    HeaderProxyAuthenticate,
+    HeaderProxyAuthorization,
+    HeaderRange,
+    HeaderReferer,
+    HeaderRetryAfter,
+    HeaderSecWebSocketAccept,
+    HeaderSecWebSocketExtensions,
+    HeaderSecWebSocketKey,
+    HeaderSecWebSocketProtocol,
+    HeaderSecWebSocketVersion,
+    HeaderServer,
+    HeaderSetCookie,
+    HeaderTE,
+    HeaderTrailer,
+    HeaderTransferEncoding,
+    HeaderUpgrade,
+    HeaderUserAgent,
+    HeaderVary,
+    HeaderVia,
+    HeaderWWWAuthenticate,
+    HeaderXForwardedFor,
+    HeaderXForwardedHost,
+    HeaderXForwardedProto,
+    HeaderXRealIP,
+    HeaderXRequestID,
+    kHttpHeaderCount,
+    HeaderUnknown = kHttpHeaderCount
+};
+
+//不区分大小写，不在表中的返回 HeaderUnknown
+HttpHeader LookupHttpHeader(const char* name, size_t len);
+//标准写法的 header 名
+const char* HttpHeaderName(HttpHeader header);
+
+}
+
+#endif
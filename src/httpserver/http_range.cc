@@ -0,0 +1,87 @@
+#include "http_range.h"
+#include <string.h>
+#include <strings.h>
+
+namespace cweb {
+namespace httpserver {
+
+static StringPiece trim(const char* begin, const char* end) {
+    while(begin < end && (*begin == ' ' || *begin == '\t')) ++begin;
+    while(end > begin && (end[-1] == ' ' || end[-1] == '\t')) --end;
+    return StringPiece(begin, end - begin);
+}
+
+//至少一位数字，超过 19 位可能溢出按格式错误处理
+static bool parseNumber(const char* begin, const char* end, uint64_t& value) {
+    if(begin == end || end - begin > 19) return false;
+    value = 0;
+    for(const char* p = begin; p < end; ++p) {
+        if(*p < '0' || *p > '9') return false;
+        value = value * 10 + (*p - '0');
+    }
+    return true;
+}
+
+static RangeResult parseRange(const StringPiece& range, uint64_t size, std::vector<ByteRange>& ranges) {
+    StringPiece value = trim(range.Data(), range.Data() + range.Size());
+    if(value.Size() < 6 || strncasecmp(value.Data(), "bytes=", 6) != 0) return RangeNone;
+
+    const char* p = value.Data() + 6;
+    const char* end = value.Data() + value.Size();
+    size_t count = 0;
+    while(p < end) {
+        const char* comma = (const char*)memchr(p, ',', end - p);
+        StringPiece spec = trim(p, comma ? comma : end);
+        p = comma ? comma + 1 : end;
+        //允许空的列表元素，如 "bytes=0-1,,2-3"
+        if(spec.Empty()) continue;
+        if(++count > kMaxRanges) return RangeNone;
+
+        const char* begin = spec.Data();
+        const char* spec_end = begin + spec.Size();
+        const char* dash = (const char*)memchr(begin, '-', spec.Size());
+        if(!dash) return RangeNone;
+
+        uint64_t first = 0;
+        uint64_t last = 0;
+        if(dash == begin) {
+            //后缀形式 -n 表示最后 n 个字节
+            if(!parseNumber(dash + 1, spec_end, last)) return RangeNone;
+            if(last == 0 || size == 0) continue;
+            if(last > size) last = size;
+            ranges.push_back({size - last, last});
+            continue;
+        }
+
+        if(!parseNumber(begin, dash, first)) return RangeNone;
+        if(dash + 1 == spec_end) {
+            last = size == 0 ? 0 : size - 1;
+        }else {
+            if(!parseNumber(dash + 1, spec_end, last) || last < first) return RangeNone;
+            if(last >= size) last = size - 1;
+        }
+        if(first >= size) continue;
+        ranges.push_back({first, last - first + 1});
+    }
+    if(count == 0) return RangeNone;
+    return ranges.empty() ? RangeNotSatisfiable : RangeSatisfiable;
+}
+
+RangeResult ParseRange(const StringPiece& range, uint64_t size, std::vector<ByteRange>& ranges) {
+    ranges.clear();
+    RangeResult result = parseRange(range, size, ranges);
+    if(result == RangeNone) ranges.clear();
+    return result;
+}
+
+bool IfRangeMatches(const StringPiece& if_range, const StringPiece& etag, const StringPiece& last_modified) {
+    StringPiece value = trim(if_range.Data(), if_range.Data() + if_range.Size());
+    if(value.Empty()) return true;
+    //弱 ETag 不能用于 If-Range
+    if(value.Data()[0] == '"') return value == etag;
+    if(value.Size() >= 2 && value.Data()[0] == 'W' && value.Data()[1] == '/') return false;
+    return value == last_modified;
+}
+
+}
+}
@@ -0,0 +1,35 @@
+#ifndef CWEB_HTTP_HTTPRANGE_H_
+#define CWEB_HTTP_HTTPRANGE_H_
+
+#include <vector>
+#include <stdint.h>
+#include "bytebuffer.h"
+
+using namespace cweb::tcpserver;
+
+namespace cweb {
+namespace httpserver {
+
+struct ByteRange {
+    uint64_t offset;
+    uint64_t length;
+};
+
+enum RangeResult {
+    RangeNone,              //没有 Range 或格式不支持，按完整内容响应
+    RangeSatisfiable,       //206
+    RangeNotSatisfiable     //416
+};
+
+//超过该数量的 Range 按完整内容响应，避免拆成大量小块
+static const size_t kMaxRanges = 16;
+
+//解析 "bytes=0-499, 500-, -200"，size 为完整内容的长度，按请求的顺序输出
+RangeResult ParseRange(const StringPiece& range, uint64_t size, std::vector<ByteRange>& ranges);
+//If-Range 为空或与 ETag(强校验)、Last-Modified 完全相同时 Range 才生效
+bool IfRangeMatches(const StringPiece& if_range, const StringPiece& etag, const StringPiece& last_modified);
+
+}
+}
+
+#endif
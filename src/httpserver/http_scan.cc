@@ -0,0 +1,185 @@
+#include "http_scan.h"
+
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#define CWEB_HTTP_SCAN_X86 1
+#include <immintrin.h>
+#endif
+
+namespace cweb {
+namespace httpserver {
+
+static inline bool urlStop(unsigned char c) {
+    return c <= 0x20 || c == 0x7f;
+}
+
+static inline bool nameStop(unsigned char c) {
+    return c <= 0x20 || c >= 0x7f || c == ':';
+}
+
+static inline bool valueStop(unsigned char c) {
+    return (c < 0x20 && c != '\t') || c == 0x7f;
+}
+
+template<bool (*Stop)(unsigned char)>
+static const char* scanScalar(const char* p, const char* end) {
+    while(p < end && !Stop((unsigned char)*p)) {
+        ++p;
+    }
+    return p;
+}
+
+#ifdef CWEB_HTTP_SCAN_X86
+
+// pcmpestri 的范围比较，每两个字节为一个闭区间
+alignas(16) static const char kUrlRanges[16] = "\x00\x20\x7f\x7f";
+alignas(16) static const char kNameRanges[16] = "\x00\x20\x3a\x3a\x7f\xff";
+alignas(16) static const char kValueRanges[16] = "\x00\x08\x0a\x1f\x7f\x7f";
+
+template<bool (*Stop)(unsigned char)>
+__attribute__((target("sse4.2")))
+static const char* scanSSE42(const char* p, const char* end, const char* ranges, int ranges_size) {
+    __m128i r = _mm_load_si128((const __m128i*)ranges);
+    while(end - p >= 16) {
+        __m128i b = _mm_loadu_si128((const __m128i*)p);
+        int index = _mm_cmpestri(r, ranges_size, b, 16, _SIDD_LEAST_SIGNIFICANT | _SIDD_CMP_RANGES | _SIDD_UBYTE_OPS);
+        if(index != 16) return p + index;
+        p += 16;
+    }
+    return scanScalar<Stop>(p, end);
+}
+
+// 无符号 b <= limit 等价于 min(b, limit) == b
+__attribute__((target("avx2")))
+static inline __m256i lessEqualAVX2(__m256i b, char limit) {
+    return _mm256_cmpeq_epi8(_mm256_min_epu8(b, _mm256_set1_epi8(limit)), b);
+}
+
+__attribute__((target("avx2")))
+static const char* scanUrlAVX2(const char* p, const char* end) {
+    const __m256i del = _mm256_set1_epi8(0x7f);
+    while(end - p >= 32) {
+        __m256i b = _mm256_loadu_si256((const __m256i*)p);
+        __m256i stop = _mm256_or_si256(lessEqualAVX2(b, 0x20), _mm256_cmpeq_epi8(b, del));
+        unsigned mask = (unsigned)_mm256_movemask_epi8(stop);
+        if(mask != 0) return p + __builtin_ctz(mask);
+        p += 32;
+    }
+    return scanScalar<urlStop>(p, end);
+}
+
+__attribute__((target("avx2")))
+static const char* scanNameAVX2(const char* p, const char* end) {
+    const __m256i del = _mm256_set1_epi8(0x7f);
+    const __m256i colon = _mm256_set1_epi8(':');
+    const __m256i printable = _mm256_set1_epi8(0x21);
+    while(end - p >= 32) {
+        __m256i b = _mm256_loadu_si256((const __m256i*)p);
+        //有符号比较 b < 0x21 同时包含了控制字符、空格和 >= 0x80 的字节
+        __m256i stop = _mm256_cmpgt_epi8(printable, b);
+        stop = _mm256_or_si256(stop, _mm256_cmpeq_epi8(b, del));
+        stop = _mm256_or_si256(stop, _mm256_cmpeq_epi8(b, colon));
+        unsigned mask = (unsigned)_mm256_movemask_epi8(stop);
+        if(mask != 0) return p + __builtin_ctz(mask);
+        p += 32;
+    }
+    return scanScalar<nameStop>(p, end);
+}
+
+__attribute__((target("avx2")))
+static const char* scanValueAVX2(const char* p, const char* end) {
+    const __m256i del = _mm256_set1_epi8(0x7f);
+    const __m256i tab = _mm256_set1_epi8('\t');
+    while(end - p >= 32) {
+        __m256i b = _mm256_loadu_si256((const __m256i*)p);
+        __m256i stop = _mm256_andnot_si256(_mm256_cmpeq_epi8(b, tab), lessEqualAVX2(b, 0x1f));
+        stop = _mm256_or_si256(stop, _mm256_cmpeq_epi8(b, del));
+        unsigned mask = (unsigned)_mm256_movemask_epi8(stop);
+        if(mask != 0) return p + __builtin_ctz(mask);
+        p += 32;
+    }
+    return scanScalar<valueStop>(p, end);
+}
+
+static const char* scanUrlSSE42(const char* p, const char* end) {
+    return scanSSE42<urlStop>(p, end, kUrlRanges, 4);
+}
+
+static const char* scanNameSSE42(const char* p, const char* end) {
+    return scanSSE42<nameStop>(p, end, kNameRanges, 6);
+}
+
+static const char* scanValueSSE42(const char* p, const char* end) {
+    return scanSSE42<valueStop>(p, end, kValueRanges, 6);
+}
+
+#endif
+
+typedef const char* (*ScanFunc)(const char*, const char*);
+
+struct Scanners {
+    HttpScanImpl impl;
+    ScanFunc url;
+    ScanFunc name;
+    ScanFunc value;
+};
+
+static bool supported(HttpScanImpl impl) {
+#ifdef CWEB_HTTP_SCAN_X86
+    __builtin_cpu_init();
+    if(impl == ScanAVX2) return __builtin_cpu_supports("avx2");
+    if(impl == ScanSSE42) return __builtin_cpu_supports("sse4.2");
+#else
+    if(impl != ScanScalar) return false;
+#endif
+    return true;
+}
+
+static Scanners makeScanners(HttpScanImpl impl) {
+    if(impl == ScanAVX2 && !supported(ScanAVX2)) impl = ScanSSE42;
+    if(impl == ScanSSE42 && !supported(ScanSSE42)) impl = ScanScalar;
+
+    Scanners scanners = {ScanScalar, scanScalar<urlStop>, scanScalar<nameStop>, scanScalar<valueStop>};
+#ifdef CWEB_HTTP_SCAN_X86
+    if(impl == ScanAVX2) {
+        scanners = {ScanAVX2, scanUrlAVX2, scanNameAVX2, scanValueAVX2};
+    }else if(impl == ScanSSE42) {
+        scanners = {ScanSSE42, scanUrlSSE42, scanNameSSE42, scanValueSSE42};
+    }
+#endif
+    return scanners;
+}
+
+//只在启动或测试时修改
+static Scanners scanners = makeScanners(ScanAVX2);
+
+HttpScanImpl SetHttpScanImpl(HttpScanImpl impl) {
+    scanners = makeScanners(impl);
+    return scanners.impl;
+}
+
+HttpScanImpl GetHttpScanImpl() {
+    return scanners.impl;
+}
+
+const char* HttpScanImplName(HttpScanImpl impl) {
+    switch(impl) {
+        case ScanAVX2: return "avx2";
+        case ScanSSE42: return "sse4.2";
+        default: return "scalar";
+    }
+}
+
+const char* ScanUrl(const char* p, const char* end) {
+    return scanners.url(p, end);
+}
+
+const char* ScanHeaderName(const char* p, const char* end) {
+    return scanners.name(p, end);
+}
+
+const char* ScanHeaderValue(const char* p, const char* end) {
+    return scanners.value(p, end);
+}
+
+}
+}
@@ -0,0 +1,34 @@
+#ifndef CWEB_HTTP_HTTPSCAN_H_
+#define CWEB_HTTP_HTTPSCAN_H_
+
+#include <stddef.h>
+
+namespace cweb {
+namespace httpserver {
+
+/*
+ 请求头解析中查找分隔符的扫描函数，x86 上按 CPU 支持选择 AVX2(32字节)或 SSE4.2(16字节)，
+ 其他平台及不足一个步长的尾部逐字节扫描。返回第一个终止字符的位置，没有则返回 end
+ */
+enum HttpScanImpl {
+    ScanScalar,
+    ScanSSE42,
+    ScanAVX2
+};
+
+//启动时自动选择 CPU 支持的最快实现，可强制指定(不支持时退回支持的实现)，用于测试和对比
+HttpScanImpl SetHttpScanImpl(HttpScanImpl impl);
+HttpScanImpl GetHttpScanImpl();
+const char* HttpScanImplName(HttpScanImpl impl);
+
+//url 结束：空格、控制字符、DEL
+const char* ScanUrl(const char* p, const char* end);
+//header 名结束：':'、空格、控制字符、DEL、非 ASCII
+const char* ScanHeaderName(const char* p, const char* end);
+//header 值结束：除 HT 外的控制字符、DEL，正常情况下为 CR/LF
+const char* ScanHeaderValue(const char* p, const char* end);
+
+}
+}
+
+#endif
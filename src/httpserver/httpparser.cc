@@ -1,22 +1,14 @@
 #include "httpparser.h"
-#include "httpsession.h"
 #include "httprequest.h"
+#include "http_scan.h"
+#include "trace.h"
 #include <algorithm>
+#include <string.h>
 
 namespace cweb {
 namespace httpserver {
 
-static std::string header_key_temp_ = "";
-
-static std::unordered_map<unsigned int, std::string> Methods = {
-    {0, "DELETE"},
-    {1, "GET"},
-    {2, "HEAD"},
-    {3, "POST"},
-    {4, "PUT"}
-};
-
-HttpParser::HttpParser(std::weak_ptr<HttpSession> session) : session_(session) {
+HttpParser::HttpParser(MessageCallback cb, bool fast) : message_callback_(std::move(cb)), fast_(fast) {
     parser_.reset(new http_parser());
     parser_settings_.reset(new http_parser_settings());
     http_parser_init(parser_.get(), HTTP_REQUEST);
@@ -27,91 +19,379 @@ HttpParser::HttpParser(std::weak_ptr<HttpSession> session) : session_(session) {
     parser_settings_->on_url = handleURL;
     parser_settings_->on_header_field = handleHeaderField;
     parser_settings_->on_header_value = handleHeaderValue;
+    parser_settings_->on_headers_complete = handleHeadersComplete;
     parser_settings_->on_body = handleBody;
     parser_settings_->on_message_complete = handleMessageComplete;
 }
 
-HttpParser::ParserProcess HttpParser::Parse(const void *data, size_t len) {
-    size_t n = http_parser_execute(parser_.get(), parser_settings_.get(), (const char*)data, len);
-    if(n != len) {
+HttpParser::~HttpParser() {}
+
+HttpParser::ParserProcess HttpParser::Parse(const void *data, size_t len, size_t& consumed) {
+    //同一段数据中的多个请求(pipelining)会依次回调 handleMessageComplete
+    consumed = 0;
+    if(fast_) {
+        consumed = parseFast((const char*)data, len);
+        if(fast_) return parser_process_;
+        //从不支持的请求开始交给 http_parser
+    }
+    consumed += http_parser_execute(parser_.get(), parser_settings_.get(), (const char*)data + consumed, len - consumed);
+    if(HTTP_PARSER_ERRNO(parser_.get()) != HPE_OK) {
         parser_process_ = FAIL;
     }
     return parser_process_;
 }
 
 bool HttpParser::CheckVersion(int major, int minor) const {
+    if(fast_) return major == 1 && minor == http_minor_;
     return parser_->http_major == major && parser_->http_minor == minor;
 }
 
 bool HttpParser::IsUpgrade() const {
-    return parser_->upgrade;
+    return !fast_ && parser_->upgrade;
+}
+
+bool HttpParser::KeepAlive() const {
+    if(fast_) return keep_alive_;
+    return http_should_keep_alive(parser_.get()) != 0;
 }
 
 
+// 请求头通常在几百字节内，预留后一般只分配一次
+static const size_t kHeadReserve = 512;
+static const size_t kHeaderReserve = 16;
+
 int HttpParser::handleMessageBegin(http_parser* parser) {
-    ((HttpParser*)(parser->data))->parser_process_ = PROCESS;
-    ((HttpParser*)(parser->data))->request_.reset(new HttpRequest());
+    HttpParser* self = (HttpParser*)(parser->data);
+    self->parser_process_ = PROCESS;
+    self->request_.reset(new HttpRequest());
+    self->request_->head_.reserve(kHeadReserve);
+    self->request_->headers_.reserve(kHeaderReserve);
+    self->header_field_pending_ = false;
+    self->header_value_pending_ = false;
+    self->in_headers_ = true;
+    self->in_message_ = true;
     return 0;
 }
 
 int HttpParser::handleURL(http_parser* parser, const char *at, size_t length) {
     HttpParser* self = (HttpParser*)(parser->data);
-    self->request_->method_ = Methods[parser->method];
-    self->request_->url_.assign(at, length);
-    const char* start = at;
-    const char* end = at + length;
-    const char* flag = std::find(start, end, '?');
-    if(start != flag) {
-        self->request_->path_.assign(start, flag);
+    HttpRequest::Span& url = self->request_->url_;
+    if(url.length == 0) {
+        url.offset = (uint32_t)self->request_->head_.size();
     }
-    
-    const char* equal = nullptr;
-    start = flag + 1;
-    
-    if(start >= end) return 0;
-    
-    do {
-        flag = std::find(start, end, '&');
-        equal = std::find(start, flag, '=');
-        if(flag == end && equal == flag) {
-            self->parser_process_ = FAIL;
-            return 0;
-        }
-        self->request_->querys_[std::string(start, equal)] = std::string(equal+1, flag);
-        start = flag + 1;
-    }while(flag != end);
+    self->request_->head_.append(at, length);
+    url.length += length;
     return 0;
 }
 
 int HttpParser::handleHeaderField(http_parser* parser, const char *at, size_t length) {
-    header_key_temp_.assign(at, length);
+    HttpParser* self = (HttpParser*)(parser->data);
+    std::vector<HttpRequest::Field>& headers = self->request_->headers_;
+    //上一个回调不是 field 说明开始了新的 header
+    if(!self->header_field_pending_) {
+        headers.push_back(HttpRequest::Field());
+        headers.back().first.offset = (uint32_t)self->request_->head_.size();
+        self->header_field_pending_ = true;
+        self->header_value_pending_ = false;
+    }
+    self->request_->head_.append(at, length);
+    headers.back().first.length += length;
     return 0;
 }
 
 int HttpParser::handleHeaderValue(http_parser* parser, const char *at, size_t length) {
     HttpParser* self = (HttpParser*)(parser->data);
-    self->request_->headers_[header_key_temp_] = std::string(at, length);
-    header_key_temp_.clear();
+    std::vector<HttpRequest::Field>& headers = self->request_->headers_;
+    if(headers.empty()) return 0;
+    if(!self->header_value_pending_) {
+        self->classifyHeader();
+        headers.back().second.offset = (uint32_t)self->request_->head_.size();
+        self->header_value_pending_ = true;
+        self->header_field_pending_ = false;
+    }
+    self->request_->head_.append(at, length);
+    headers.back().second.length += length;
+    return 0;
+}
+
+int HttpParser::handleHeadersComplete(http_parser* parser) {
+    HttpParser* self = (HttpParser*)(parser->data);
+    if(self->header_field_pending_) {
+        self->classifyHeader();
+    }
+    self->header_field_pending_ = false;
+    self->header_value_pending_ = false;
+    self->trimHeaderValues();
+    self->request_->method_ = http_method_str((enum http_method)parser->method);
+    self->parseURL();
+    self->in_headers_ = false;
     return 0;
 }
 
+// header 名接收完整后归类，重复的常用 header 以第一个为准
+void HttpParser::classifyHeader() {
+    const HttpRequest::Field& field = request_->headers_.back();
+    HttpHeader header = LookupHttpHeader(request_->head_.data() + field.first.offset, field.first.length);
+    if(header != HeaderUnknown && request_->known_headers_[header] == 0) {
+        request_->known_headers_[header] = (uint16_t)request_->headers_.size();
+    }
+}
+
+// http_parser 只跳过值前面的空白，末尾的空白(OWS)与快速解析一样去掉
+void HttpParser::trimHeaderValues() {
+    const char* head = request_->head_.data();
+    for(HttpRequest::Field& field : request_->headers_) {
+        const char* value = head + field.second.offset;
+        uint32_t& length = field.second.length;
+        while(length > 0 && (value[length - 1] == ' ' || value[length - 1] == '\t')) --length;
+    }
+}
+
+void HttpParser::parseURL() {
+    const std::string& head = request_->head_;
+    HttpRequest::Span url = request_->url_;
+    const char* base = head.data();
+    const char* start = base + url.offset;
+    const char* end = start + url.length;
+    const char* flag = std::find(start, end, '?');
+    if(start != flag) {
+        request_->path_.assign(start, flag);
+    }
+    
+    start = flag + 1;
+    while(start < end) {
+        flag = std::find(start, end, '&');
+        const char* equal = std::find(start, flag, '=');
+        //没有'='的参数忽略，只记录在 head_ 中的偏移
+        if(equal != flag) {
+            HttpRequest::Field query;
+            query.first.offset = (uint32_t)(start - base);
+            query.first.length = (uint32_t)(equal - start);
+            query.second.offset = (uint32_t)(equal + 1 - base);
+            query.second.length = (uint32_t)(flag - equal - 1);
+            request_->querys_.push_back(query);
+        }
+        start = flag + 1;
+    }
+}
+
 int HttpParser::handleBody(http_parser* parser, const char *at, size_t length) {
     HttpParser* self = (HttpParser*)(parser->data);
     //TODO 文件上传场景 缓存到磁盘中 multipart场景
     //copy
+    if(self->request_->raw_body_ == nullptr) {
+        self->request_->raw_body_.reset(new ByteBuffer());
+    }
     self->request_->raw_body_->Append(at, length);
     return 0;
 }
 
 int HttpParser::handleMessageComplete(http_parser* parser) {
     HttpParser* self = (HttpParser*)(parser->data);
-    self->parser_process_ = SUCCESS;
-    if(auto session = self->session_.lock()) {
-        session->handleParsedMessage(std::move(self->request_));
-    }
+    self->completeMessage();
     return 0;
 }
 
+void HttpParser::completeMessage() {
+    parser_process_ = SUCCESS;
+    in_message_ = false;
+    if(message_callback_) {
+        message_callback_(std::move(request_));
+    }
+}
+
+// 与 http_parser 的 HTTP_MAX_HEADER_SIZE 一致，超过后交给 http_parser 报错
+static const size_t kMaxHeadSize = 80 * 1024;
+
+size_t HttpParser::parseFast(const char* data, size_t len) {
+    size_t pos = 0;
+    while(pos < len) {
+        if(body_remaining_ > 0) {
+            size_t n = std::min(body_remaining_, len - pos);
+            request_->raw_body_->Append(data + pos, n);
+            pos += n;
+            body_remaining_ -= n;
+            if(body_remaining_ > 0) break;
+            completeMessage();
+            continue;
+        }
+        
+        //请求之间多余的空行忽略
+        if(!in_headers_ && (data[pos] == '\r' || data[pos] == '\n')) {
+            ++pos;
+            continue;
+        }
+        
+        const char* begin = data + pos;
+        const char* head_end = findHeadEnd(begin, data + len);
+        if(head_end == nullptr) {
+            parser_process_ = PROCESS;
+            in_headers_ = in_message_ = true;
+            if(len - pos > kMaxHeadSize) {
+                fast_ = false;
+            }
+            break;
+        }
+        
+        size_t body_length = 0;
+        if(!parseHead(begin, head_end, body_length)) {
+            fast_ = false;
+            break;
+        }
+        pos = head_end - data;
+        in_headers_ = false;
+        if(body_length == 0) {
+            completeMessage();
+        }else {
+            body_remaining_ = body_length;
+            request_->raw_body_.reset(new ByteBuffer());
+        }
+    }
+    
+    if(!fast_) {
+        //未消费的请求从头交给 http_parser
+        in_headers_ = in_message_ = false;
+        head_scanned_ = 0;
+        request_.reset();
+    }
+    return pos;
+}
+
+// 返回空行之后的位置，请求头不完整返回 nullptr，已查找过的部分下次不再查找
+const char* HttpParser::findHeadEnd(const char* begin, const char* end) {
+    const char* p = begin + (head_scanned_ > 2 ? head_scanned_ - 2 : 0);
+    while(p < end) {
+        p = (const char*)memchr(p, '\n', end - p);
+        if(p == nullptr) break;
+        ++p;
+        if(p < end && *p == '\n') {
+            head_scanned_ = 0;
+            return p + 1;
+        }
+        if(p + 1 < end && p[0] == '\r' && p[1] == '\n') {
+            head_scanned_ = 0;
+            return p + 2;
+        }
+    }
+    head_scanned_ = end - begin;
+    return nullptr;
+}
+
+static inline bool skipEOL(const char*& p, const char* end) {
+    if(p < end && *p == '\n') {
+        ++p;
+        return true;
+    }
+    if(p + 1 < end && p[0] == '\r' && p[1] == '\n') {
+        p += 2;
+        return true;
+    }
+    return false;
+}
+
+// Connection 等逗号分隔的值中是否包含 token，不区分大小写
+static bool hasToken(StringPiece value, const char* token) {
+    size_t len = strlen(token);
+    const char* p = value.Data();
+    const char* end = p + value.Size();
+    while(p < end) {
+        while(p < end && (*p == ' ' || *p == '\t' || *p == ',')) ++p;
+        const char* start = p;
+        while(p < end && *p != ',') ++p;
+        const char* stop = p;
+        while(stop > start && (stop[-1] == ' ' || stop[-1] == '\t')) --stop;
+        if((size_t)(stop - start) == len && strncasecmp(start, token, len) == 0) return true;
+    }
+    return false;
+}
+
+// [begin, end) 为完整的请求头，返回 false 表示需要交给 http_parser
+bool HttpParser::parseHead(const char* begin, const char* end, size_t& body_length) {
+    const char* p = begin;
+    const char* method = p;
+    while(p < end && *p >= 'A' && *p <= 'Z') ++p;
+    if(p == method || p >= end || *p != ' ') return false;
+    const char* method_end = p++;
+    
+    const char* url = p;
+    p = ScanUrl(p, end);
+    if(p == url || p >= end || *p != ' ') return false;
+    const char* url_end = p++;
+    
+    if(end - p < 8 || memcmp(p, "HTTP/1.", 7) != 0 || (p[7] != '0' && p[7] != '1')) return false;
+    int minor = p[7] - '0';
+    p += 8;
+    if(!skipEOL(p, end)) return false;
+    
+    //请求头整体拷贝一次，url、header 记录相对 begin 的偏移
+    request_.reset(new HttpRequest());
+    request_->head_.assign(begin, end - begin);
+    request_->headers_.reserve(kHeaderReserve);
+    request_->url_.offset = (uint32_t)(url - begin);
+    request_->url_.length = (uint32_t)(url_end - url);
+    
+    bool connection_close = false;
+    bool connection_keep_alive = false;
+    while(true) {
+        if(skipEOL(p, end)) break;
+        const char* name = p;
+        p = ScanHeaderName(p, end);
+        if(p == name || p >= end || *p != ':') return false;
+        const char* name_end = p++;
+        while(p < end && (*p == ' ' || *p == '\t')) ++p;
+        const char* value = p;
+        p = ScanHeaderValue(p, end);
+        const char* value_end = p;
+        if(!skipEOL(p, end)) return false;
+        //多行 header(obs-fold)交给 http_parser
+        if(p < end && (*p == ' ' || *p == '\t')) return false;
+        while(value_end > value && (value_end[-1] == ' ' || value_end[-1] == '\t')) --value_end;
+        
+        HttpRequest::Field field;
+        field.first.offset = (uint32_t)(name - begin);
+        field.first.length = (uint32_t)(name_end - name);
+        field.second.offset = (uint32_t)(value - begin);
+        field.second.length = (uint32_t)(value_end - value);
+        request_->headers_.push_back(field);
+        HttpHeader header = LookupHttpHeader(name, name_end - name);
+        if(header != HeaderUnknown) {
+            //重复的 Content-Length 可能被用于请求走私
+            if(header == HeaderContentLength && request_->known_headers_[header] != 0) return false;
+            if(request_->known_headers_[header] == 0) {
+                request_->known_headers_[header] = (uint16_t)request_->headers_.size();
+            }
+            if(header == HeaderConnection) {
+                StringPiece tokens(value, value_end - value);
+                connection_close = connection_close || hasToken(tokens, "close");
+                connection_keep_alive = connection_keep_alive || hasToken(tokens, "keep-alive");
+            }
+        }
+    }
+    
+    //分块传输和协议升级交给 http_parser
+    if(request_->known_headers_[HeaderTransferEncoding] != 0 || request_->known_headers_[HeaderUpgrade] != 0) return false;
+    if(method_end - method == 7 && memcmp(method, "CONNECT", 7) == 0) return false;
+    
+    body_length = 0;
+    if(request_->known_headers_[HeaderContentLength] != 0) {
+        StringPiece content_length = request_->Header(HeaderContentLength);
+        if(content_length.Empty() || content_length.Size() > 18) return false;
+        for(size_t i = 0; i < content_length.Size(); ++i) {
+            char c = content_length.Data()[i];
+            if(c < '0' || c > '9') return false;
+            body_length = body_length * 10 + (c - '0');
+        }
+    }
+    
+    http_minor_ = minor;
+    keep_alive_ = minor == 1 ? !connection_close : connection_keep_alive;
+    parser_process_ = PROCESS;
+    in_message_ = true;
+    request_->method_.assign(method, method_end);
+    parseURL();
+    return true;
+}
+
 
 }
 }
@@ -3,13 +3,17 @@
 
 #include "http_parser.h"
 #include <memory>
+#include <functional>
 
 namespace cweb {
 namespace httpserver {
 
-class HttpSession;
 class HttpRequest;
 class HttpParser {
+public:
+    //解析出完整的请求后回调，同一次 Parse 中的多个请求依次回调
+    typedef std::function<void(std::unique_ptr<HttpRequest>)> MessageCallback;
+
 private:
     enum ParserProcess {
         PROCESS,
@@ -17,24 +21,52 @@ private:
         FAIL
     };
     
-    std::weak_ptr<HttpSession> session_;
+    MessageCallback message_callback_;
     std::unique_ptr<http_parser> parser_;
     std::unique_ptr<http_parser_settings> parser_settings_;
     std::unique_ptr<HttpRequest> request_;
     ParserProcess parser_process_ = PROCESS;
+    //url、header 可能跨多次读取分段回调，依次追加到请求的 head_ 中，headers 结束时再解析 url
+    bool header_field_pending_ = false;
+    bool header_value_pending_ = false;
+    bool in_headers_ = false;
+    bool in_message_ = false;
+    //快速解析：请求头完整后一次性解析，不支持的请求(分块、升级、格式不规范等)转交 http_parser，此后该连接都使用 http_parser
+    bool fast_ = false;
+    size_t head_scanned_ = 0;       //未完整的请求头已查找过结束标志的长度
+    size_t body_remaining_ = 0;
+    int http_minor_ = 1;
+    bool keep_alive_ = true;
     //wsparser
+    
+    void parseURL();
+    void classifyHeader();
+    void trimHeaderValues();
+    void completeMessage();
+    size_t parseFast(const char* data, size_t len);
+    const char* findHeadEnd(const char* begin, const char* end);
+    bool parseHead(const char* begin, const char* end, size_t& body_length);
 
 public:
-    HttpParser(std::weak_ptr<HttpSession> session);
-    ParserProcess Parse(const void* data, size_t len);
+    //fast 使用基于 SIMD 扫描的快速解析，见 HttpConfig::fast_parser
+    HttpParser(MessageCallback cb, bool fast = false);
+    ~HttpParser();
+    //consumed 为已解析的字节数，升级协议时其后的数据不属于 http
+    ParserProcess Parse(const void* data, size_t len, size_t& consumed);
     bool CheckVersion(int major, int minor) const;
     bool IsUpgrade() const;
+    //按版本和 Connection 头判断当前请求后是否保持连接，1.1 默认保持，1.0 需 keep-alive
+    bool KeepAlive() const;
+    //已收到请求的开始但请求头还不完整
+    bool ReadingHeaders() const {return in_headers_;}
+    bool InMessage() const {return in_message_;}
     
 private:
     static int handleMessageBegin(http_parser* parser);
     static int handleURL(http_parser* parser, const char *at, size_t length);
     static int handleHeaderField(http_parser* parser, const char *at, size_t length);
     static int handleHeaderValue(http_parser* parser, const char *at, size_t length);
+    static int handleHeadersComplete(http_parser* parser);
     static int handleBody(http_parser* parser, const char *at, size_t length);
     static int handleMessageComplete(http_parser* parser);
     
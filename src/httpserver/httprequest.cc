@@ -6,7 +6,6 @@
 namespace cweb {
 namespace httpserver {
 
-static std::string header_field_temp = "";
 
 HttpRequestBody* HttpRequestBody::HttpRequestBodyFactory(const std::string &content_type) {
     if(content_type == "application/json") {
@@ -46,10 +45,19 @@ void MultipartPart::SetFile(int fd, size_t size) {
 
 MultipartPart::MultipartPart() : data_(new BinaryData()) {}
 
+const std::string& MultipartPart::Header(HttpHeader header) const {
+    static std::string empty;
+    for(auto iter = headers.begin(); iter != headers.end(); ++iter) {
+        if(LookupHttpHeader(iter->first.data(), iter->first.size()) == header) {
+            return iter->second;
+        }
+    }
+    return empty;
+}
+
 bool MultipartPart::ParseBody() {
-    auto iter = headers.find("Content-Type");
-    if(iter == headers.end()) return true;
-    content_type_ = iter->second;
+    content_type_ = Header(HeaderContentType);
+    if(content_type_.empty()) return true;
     body_.reset(HttpRequestBody::HttpRequestBodyFactory(content_type_));
     if(body_ != nullptr) {
         return body_->SetData(data_->data, data_->size);
@@ -155,13 +163,14 @@ int HttpRequestMultipartBody::handlePartBegin(multipartparser *parser) {
 }
 
 int HttpRequestMultipartBody::handleHeaderField(multipartparser *parser, const char *data, size_t size) {
-    header_field_temp.append(data, size);
+    HttpRequestMultipartBody* body = (HttpRequestMultipartBody*)parser->data;
+    body->header_field_.append(data, size);
     return 0;
 }
 
 int HttpRequestMultipartBody::handleHeaderValue(multipartparser *parser, const char *data, size_t size) {
     HttpRequestMultipartBody* body = (HttpRequestMultipartBody*)parser->data;
-    if(header_field_temp == "Content-Disposition") {
+    if(LookupHttpHeader(body->header_field_.data(), body->header_field_.size()) == HeaderContentDisposition) {
         std::string disposition(data, size);
         std::size_t name_pos = disposition.find("name=\"");
         if(name_pos != std::string::npos) {
@@ -175,8 +184,8 @@ int HttpRequestMultipartBody::handleHeaderValue(multipartparser *parser, const c
             body->multiparts_.back()->dispositions["filename"] = disposition.substr(filename_pos, disposition.find("\"", filename_pos) - filename_pos);
         }
     }
-    body->multiparts_.back()->headers[header_field_temp] = std::string(data, size);
-    header_field_temp.clear();
+    body->multiparts_.back()->headers[body->header_field_] = std::string(data, size);
+    body->header_field_.clear();
     return 0;
 }
 
@@ -200,13 +209,18 @@ MultipartPart* HttpRequestMultipartBody::MultipartForm(const std::string& key) c
     return &empty;
 }
 
-HttpRequest::HttpRequest() : raw_body_(new ByteBuffer()) {}
+HttpRequest::HttpRequest() {}
 
 bool HttpRequest::ParseBody() {
+    //没有请求体的请求不分配 raw_body_
+    if(raw_body_ == nullptr) {
+        data_.reset(new BinaryData());
+        return true;
+    }
     data_.reset(new BinaryData(raw_body_->Peek(), raw_body_->ReadableBytes()));
-    auto iter = headers_.find("Content-Type");
-    if(iter == headers_.end()) return true;
-    content_type_ = iter->second;
+    StringPiece content_type = Header(HeaderContentType);
+    if(content_type.Empty()) return true;
+    content_type_ = content_type.ToString();
     body_.reset(HttpRequestBody::HttpRequestBodyFactory(content_type_));
     if(body_ != nullptr) {
         return body_->SetData(raw_body_->Peek(), raw_body_->ReadableBytes());
@@ -214,6 +228,28 @@ bool HttpRequest::ParseBody() {
     return true;
 }
 
+StringPiece HttpRequest::Query(const StringPiece& key) const {
+    for(const Field& field : querys_) {
+        if(view(field.first) == key) {
+            return view(field.second);
+        }
+    }
+    return StringPiece();
+}
+
+StringPiece HttpRequest::Header(const StringPiece& key) const {
+    HttpHeader header = LookupHttpHeader(key.Data(), key.Size());
+    if(header != HeaderUnknown) {
+        return Header(header);
+    }
+    for(const Field& field : headers_) {
+        if(view(field.first).EqualsIgnoreCase(key)) {
+            return view(field.second);
+        }
+    }
+    return StringPiece();
+}
+
 const std::string& HttpRequest::PostForm(const std::string &key) const {
     static std::string empty;
     if(content_type_ != "application/x-www-form-urlencoded") return empty;
@@ -8,6 +8,7 @@
 #include "bytebuffer.h"
 #include "json.h"
 #include "multipartparser.h"
+#include "http_header.h"
 
 using namespace cweb::tcpserver;
 
@@ -81,6 +82,8 @@ public:
     
     bool ParseBody();
     
+    //按常用 header 查找，不区分大小写
+    const std::string& Header(HttpHeader header) const;
     const std::string& HeaderStr();
     int Fd() const {return fd_;}
     const char* Data() {return data_->data;}
@@ -93,6 +96,7 @@ public:
 class HttpRequestMultipartBody : public HttpRequestBody {
 private:
     std::string boundary_ = "";
+    std::string header_field_;
     multipartparser parser_;
     multipartparser_callbacks callbacks_;
     //std::unordered_map<std::string, MultipartPart> multiparts_;
@@ -112,15 +116,31 @@ public:
 
 class HttpRequest {
 private:
+    //head_ 中的一段
+    struct Span {
+        uint32_t offset = 0;
+        uint32_t length = 0;
+    };
+    typedef std::pair<Span, Span> Field;
+    
     std::string method_;
-    std::unordered_map<std::string, std::string> headers_;
-    std::string url_ = "";
+    //url 和请求头按到达顺序保存在 head_ 中，headers_、querys_ 只记录偏移，避免每个字段单独分配
+    std::string head_;
+    Span url_;
+    std::vector<Field> headers_;
+    //常用 header 在 headers_ 中的下标 + 1，0 表示没有，其余的在 headers_ 中按名字查找
+    uint16_t known_headers_[kHttpHeaderCount] = {0};
+    std::vector<Field> querys_;
     std::string path_ = "";
     std::string content_type_ = "";
     std::unique_ptr<BinaryData> data_;
-    std::unordered_map<std::string, std::string> querys_;
     std::unique_ptr<ByteBuffer> raw_body_;
     std::shared_ptr<HttpRequestBody> body_;
+    uint64_t sequence_ = 0;
+    int minor_version_ = 1;
+    bool trace_sampled_ = false;        //来自读到该请求的那次 read
+    
+    StringPiece view(Span span) const {return StringPiece(head_.data() + span.offset, span.length);}
     
 public:
     friend class HttpParser;
@@ -132,17 +152,25 @@ public:
     
     bool ParseBody();
     
-    const std::string& Url() const {return url_;}
+    //同一连接上的请求序号，响应按该顺序发送
+    uint64_t Sequence() const {return sequence_;}
+    //HTTP/1.x 的次版本号，HTTP/1.0 不支持 chunked 等
+    int MinorVersion() const {return minor_version_;}
+    bool TraceSampled() const {return trace_sampled_;}
+    //返回的 StringPiece 指向请求内部，请求结束后仍需使用的调用 ToString 拷贝
+    StringPiece Url() const {return view(url_);}
     const std::string& Method() const {return method_;}
     const std::string& Path() const {return path_;}
-    const std::string& Query(const std::string& key) const {
-        static std::string empty;
-        auto iter = querys_.find(key);
-        if(iter != querys_.end()) {
-            return iter->second;
-        }
-        return empty;
+    StringPiece Query(const StringPiece& key) const;
+    //header 名不区分大小写
+    StringPiece Header(const StringPiece& key) const;
+    StringPiece Header(HttpHeader header) const {
+        if(header >= kHttpHeaderCount || known_headers_[header] == 0) return StringPiece();
+        return view(headers_[known_headers_[header] - 1].second);
     }
+    size_t HeaderCount() const {return headers_.size();}
+    StringPiece HeaderName(size_t index) const {return view(headers_[index].first);}
+    StringPiece HeaderValue(size_t index) const {return view(headers_[index].second);}
     
     //const
     const std::string& PostForm(const std::string &key) const;
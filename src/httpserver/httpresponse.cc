@@ -1,4 +1,9 @@
 #include "httpresponse.h"
+#include "http_parser.h"
+#include <time.h>
+#include <strings.h>
+#include <string.h>
+#include <stdio.h>
 
 namespace cweb {
 namespace httpserver {
@@ -7,18 +12,16 @@ HttpResponse::HttpResponse() {}
 HttpResponse::~HttpResponse() {}
 
 void HttpResponse::SetStatusCode(HttpStatusCode code, std::string& stream) {
-    static std::unordered_map<int, std::string> http_status_code = {
-        {200 ,"OK"},
-        {301, "Moved Permanently"},
-        {400, "Bad Request"},
-        {404, "Not Found"}
-    };
-    
-    stream += "HTTP/1.1 " + std::to_string(code) + " " + http_status_code[code] + "\r\n";
+    StringPiece line = StatusLine(code);
+    if(line.Empty()) {
+        stream += "HTTP/1.1 " + std::to_string(code) + " \r\n";
+        return;
+    }
+    stream.append(line.Data(), line.Size());
 }
 
 void HttpResponse::SetHeader(const std::string &key, const std::string &value, std::string& stream) {
-    stream += key + ": " + value + "\r\n";
+    stream.append(key).append(": ", 2).append(value).append("\r\n", 2);
 }
 
 void HttpResponse::SetBody(StringPiece body, std::string& stream) {
@@ -26,6 +29,146 @@ void HttpResponse::SetBody(StringPiece body, std::string& stream) {
     stream += body.Data();
 }
 
+StringPiece HttpResponse::StatusLine(int code) {
+    switch(code) {
+#define XX(num, name, string) \
+        case num: return StringPiece("HTTP/1.1 " #num " " #string "\r\n", sizeof("HTTP/1.1 " #num " " #string "\r\n") - 1);
+        HTTP_STATUS_MAP(XX)
+#undef XX
+        default: return StringPiece();
+    }
+}
+
+// IMF-fixdate: Sun, 06 Nov 1994 08:49:37 GMT
+static int formatHttpDate(time_t t, char* buf, size_t size) {
+    static const char* kDays[] = {"Sun", "Mon", "Tue", "Wed", "Thu", "Fri", "Sat"};
+    static const char* kMonths[] = {"Jan", "Feb", "Mar", "Apr", "May", "Jun", "Jul", "Aug", "Sep", "Oct", "Nov", "Dec"};
+    struct tm tm;
+    gmtime_r(&t, &tm);
+    return snprintf(buf, size, "%s, %02d %s %04d %02d:%02d:%02d GMT",
+                    kDays[tm.tm_wday], tm.tm_mday, kMonths[tm.tm_mon], tm.tm_year + 1900,
+                    tm.tm_hour, tm.tm_min, tm.tm_sec);
+}
+
+std::string HttpResponse::HttpDate(time_t t) {
+    char buf[64];
+    int n = formatHttpDate(t, buf, sizeof(buf));
+    return std::string(buf, n);
+}
+
+StringPiece HttpResponse::DateHeader() {
+    //每个 loop 运行在自己的线程中，按线程缓存即每个 loop 每秒格式化一次
+    static thread_local time_t cached_second = 0;
+    static thread_local char cached[64];
+    static thread_local int cached_size = 0;
+    
+    time_t now = time(nullptr);
+    if(now != cached_second) {
+        memcpy(cached, "Date: ", 6);
+        cached_size = 6 + formatHttpDate(now, cached + 6, sizeof(cached) - 8);
+        memcpy(cached + cached_size, "\r\n", 2);
+        cached_size += 2;
+        cached_second = now;
+    }
+    return StringPiece(cached, cached_size);
+}
+
+const char* HttpResponse::MimeType(const StringPiece& path) {
+    static const struct {
+        const char* ext;
+        const char* type;
+    } kTypes[] = {
+        {"html", "text/html; charset=utf-8"},
+        {"htm", "text/html; charset=utf-8"},
+        {"css", "text/css; charset=utf-8"},
+        {"js", "application/javascript; charset=utf-8"},
+        {"json", "application/json; charset=utf-8"},
+        {"txt", "text/plain; charset=utf-8"},
+        {"xml", "application/xml"},
+        {"svg", "image/svg+xml"},
+        {"jpeg", "image/jpeg"},
+        {"jpg", "image/jpeg"},
+        {"png", "image/png"},
+        {"gif", "image/gif"},
+        {"webp", "image/webp"},
+        {"ico", "image/x-icon"},
+        {"mp3", "audio/mpeg"},
+        {"mp4", "video/mp4"},
+        {"wasm", "application/wasm"},
+        {"pdf", "application/pdf"},
+        {"doc", "application/msword"},
+        {"docx", "application/msword"},
+        {"zip", "application/zip"},
+        {"gzip", "application/gzip"}
+    };
+    
+    const char* begin = path.Data();
+    const char* p = begin + path.Size();
+    while(p > begin && p[-1] != '.' && p[-1] != '/') --p;
+    if(p == begin || p[-1] != '.') return "application/octet-stream";
+    size_t len = begin + path.Size() - p;
+    for(auto& type : kTypes) {
+        if(strlen(type.ext) == len && strncasecmp(type.ext, p, len) == 0) return type.type;
+    }
+    return "application/octet-stream";
+}
+
+void HttpResponseBuilder::Append(const StringPiece& data) {
+    if(heap_.empty() && size_ + data.Size() <= kInlineSize) {
+        memcpy(inline_ + size_, data.Data(), data.Size());
+        size_ += data.Size();
+        return;
+    }
+    if(heap_.empty()) {
+        heap_.reserve(kInlineSize * 2 + data.Size());
+        heap_.append(inline_, size_);
+    }
+    heap_.append(data.Data(), data.Size());
+}
+
+void HttpResponseBuilder::AppendUint(uint64_t value) {
+    char buf[20];
+    char* p = buf + sizeof(buf);
+    do {
+        *--p = (char)('0' + value % 10);
+        value /= 10;
+    }while(value > 0);
+    Append(StringPiece(p, buf + sizeof(buf) - p));
+}
+
+void HttpResponseBuilder::StatusLine(HttpStatusCode code) {
+    StringPiece line = HttpResponse::StatusLine(code);
+    if(!line.Empty()) {
+        Append(line);
+        return;
+    }
+    //非标准状态码不带原因短语
+    Append(StringPiece("HTTP/1.1 ", 9));
+    AppendUint((uint64_t)code);
+    Append(StringPiece(" \r\n", 3));
+}
+
+void HttpResponseBuilder::Header(const StringPiece& key, const StringPiece& value) {
+    Append(key);
+    Append(StringPiece(": ", 2));
+    Append(value);
+    Append(StringPiece("\r\n", 2));
+}
+
+void HttpResponseBuilder::Header(const StringPiece& key, uint64_t value) {
+    Append(key);
+    Append(StringPiece(": ", 2));
+    AppendUint(value);
+    Append(StringPiece("\r\n", 2));
+}
+
+void HttpResponseBuilder::Date() {
+    Append(HttpResponse::DateHeader());
+}
+
+void HttpResponseBuilder::End() {
+    Append(StringPiece("\r\n", 2));
+}
 
 }
 }
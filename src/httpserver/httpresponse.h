@@ -3,6 +3,8 @@
 
 #include <string>
 #include <unordered_map>
+#include <stdint.h>
+#include <time.h>
 #include "http_code.h"
 #include "bytebuffer.h"
 
@@ -27,6 +29,48 @@ public:
     static void SetHeader(const std::string& key, const std::string& value, std::string& stream);
     static void SetStatusCode(HttpStatusCode code, std::string& stream);
     static void SetBody(StringPiece body, std::string& stream);
+    
+    //"HTTP/1.1 200 OK\r\n"，编译期生成的字符串常量，非标准状态码返回空
+    static StringPiece StatusLine(int code);
+    //"Date: Sun, 06 Nov 1994 08:49:37 GMT\r\n"，每个线程每秒最多格式化一次
+    static StringPiece DateHeader();
+    //Last-Modified 等 header 使用的时间格式，不含 header 名
+    static std::string HttpDate(time_t t);
+    //按文件扩展名(不区分大小写)，未知类型为 application/octet-stream
+    static const char* MimeType(const StringPiece& path);
+};
+
+/*
+ 响应头构建，先写入对象内部的缓冲区，超过 kInlineSize 才转到堆上
+ 在栈上构造，格式化状态行、数字不产生临时对象
+ */
+class HttpResponseBuilder {
+public:
+    static const size_t kInlineSize = 512;
+    
+    HttpResponseBuilder() {}
+    HttpResponseBuilder(const HttpResponseBuilder&) = delete;
+    HttpResponseBuilder& operator=(const HttpResponseBuilder&) = delete;
+    
+    void StatusLine(HttpStatusCode code);
+    void Header(const StringPiece& key, const StringPiece& value);
+    void Header(const StringPiece& key, uint64_t value);
+    void Date();
+    //写入空行结束响应头
+    void End();
+    
+    //逐段写入一个 header 的值，如 Keep-Alive: timeout=5, max=100
+    void Append(const StringPiece& data);
+    void AppendUint(uint64_t value);
+    
+    const char* Data() const {return heap_.empty() ? inline_ : heap_.data();}
+    size_t Size() const {return heap_.empty() ? size_ : heap_.size();}
+    StringPiece Piece() const {return StringPiece(Data(), Size());}
+    
+private:
+    char inline_[kInlineSize];
+    size_t size_ = 0;
+    std::string heap_;
 };
 
 }
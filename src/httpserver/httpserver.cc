@@ -62,6 +62,7 @@ void HttpServer::handleConnected(std::shared_ptr<TcpConnection> conn) {
 void HttpServer::handleDisconnected(std::shared_ptr<TcpConnection> conn) {
     auto iter = httpsessions_.find(conn);
     if(iter != httpsessions_.end()) {
+        iter->second->handleClose();
         while(lock_.test_and_set(std::memory_order_acquire)) {}
         httpsessions_.erase(conn);
         lock_.clear(std::memory_order_release);
@@ -1,10 +1,15 @@
 #include "httpsession.h"
 #include "websocket.h"
 #include "httpresponse.h"
+#include "trace.h"
+#include "eventloop.h"
 #include <fcntl.h>
 #include <random>
 #include <sys/stat.h>
 #include <algorithm>
+#ifdef COROUTINE
+#include "co_eventloop.h"
+#endif
 
 namespace cweb {
 namespace httpserver {
@@ -15,19 +20,59 @@ HttpSession::~HttpSession() {
     if(upgrade_) {
         websocket_->HandleClose();
     }
+    
+    for(auto& pending : pending_responses_) {
+        for(ByteData* data : pending.second.datas) {
+            delete data;
+        }
+    }
+    for(ByteData* data : ready_datas_) {
+        delete data;
+    }
 }
 
 void HttpSession::Init() {
-    http_parser_.reset(new HttpParser(shared_from_this()));
+    //解析器属于 session，回调期间 session 由 handleMessage 持有
+    http_parser_.reset(new HttpParser([this](std::unique_ptr<HttpRequest> request) {
+        handleParsedMessage(std::move(request));
+    }, config_.fast_parser));
+    std::weak_ptr<HttpSession> weak = shared_from_this();
+    connection_->SetWriteCompleteCallback([weak](std::shared_ptr<TcpConnection>) {
+        std::shared_ptr<HttpSession> session = weak.lock();
+        if(session) session->handleWriteComplete();
+    });
 }
 
 TcpConnection::MessageState HttpSession::handleMessage(std::shared_ptr<TcpConnection> conn, ByteBuffer* buf, Time time) {
-    TcpConnection::MessageState state;
-    if(upgrade_) {
+    //同步完成的 Connection: close 响应会在解析过程中关闭连接，HttpServer 随即释放 session
+    std::shared_ptr<HttpSession> self = shared_from_this();
+    TcpConnection::MessageState state = TcpConnection::FINISH;
+    if(!upgrade_) {
+        //不完整的请求由解析器保存状态，已解析的数据直接丢弃
+        size_t consumed = 0;
+        corked_ = true;
+        cork_owner_ = currentContext();
+        if(close_seq_.load(std::memory_order_relaxed) == kUnordered) {
+            TRACE_SCOPE(conn->TraceSampled(), "http_parse");
+            state = (TcpConnection::MessageState)http_parser_->Parse(buf->Peek(), buf->ReadableBytes(), consumed);
+        }
+        if(close_seq_.load(std::memory_order_relaxed) != kUnordered) {
+            //已决定关闭连接，解析器不再接受数据，剩余数据丢弃，等响应发送完后关闭
+            buf->ReadAll();
+            state = TcpConnection::FINISH;
+        }else {
+            buf->ReadBytes(consumed);
+        }
+        corked_ = false;
+        flushWrites();
+        if(state != TcpConnection::BAD) {
+            updateIdleTimeout();
+        }
+    }
+    
+    //升级请求之后的数据属于 websocket
+    if(upgrade_ && state != TcpConnection::BAD && buf->ReadableBytes() > 0) {
         state = websocket_->handleMessage(conn, buf, time);
-    }else {
-        state = (TcpConnection::MessageState)http_parser_->Parse(buf->Peek(), buf->ReadableBytes());
-        buf->ReadAll();
     }
     
     if(state == tcpserver::TcpConnection::BAD) {
@@ -37,118 +82,186 @@ TcpConnection::MessageState HttpSession::handleMessage(std::shared_ptr<TcpConnec
 }
 
 void HttpSession::handleParsedMessage(std::unique_ptr<HttpRequest> request) {
+    request->trace_sampled_ = connection_->TraceSampled();
     if(http_parser_->IsUpgrade()) {
         upgrade_ = true;
         websocket_.reset(new WebSocket(connection_, request_callback_));
         websocket_->Start(std::move(request));
+        connection_->SetIdleTimeout(-1);
         return;
     }
     
-    auto iter = request->headers_.find("connection");
-    if(http_parser_->CheckVersion(1, 0)) {
-        if(iter != request->headers_.end() && iter->second == "Keep-Alive") {
-            //长连
-            need_close_ = false;
-        }
-    }else if(http_parser_->CheckVersion(1, 1)) {
-        
-        if(iter == request->headers_.end() || iter->second == "close") {
-            need_close_ = false;
-        }
+    //已决定关闭连接，流水线中后续的请求丢弃
+    if(close_seq_.load(std::memory_order_relaxed) != kUnordered) return;
+    
+    bool keep_alive = http_parser_->KeepAlive();
+    if(config_.max_keepalive_requests > 0 && request_seq_ + 1 >= config_.max_keepalive_requests) {
+        keep_alive = false;
     }
-    if(request->ParseBody()) {
+    if(!keep_alive) {
+        //先于回调写入，其他线程中的响应经 AddTask 投递后可见
+        close_seq_.store(request_seq_, std::memory_order_release);
+    }
+    
+    bool parsed = false;
+    {
+        TRACE_SCOPE(request->TraceSampled(), "parse_body");
+        parsed = request->ParseBody();
+    }
+    if(parsed) {
+        //业务可以持有 Context 稍后在任意线程中响应，关闭连接推迟到该请求处理结束
+        request->sequence_ = request_seq_++;
+        request->minor_version_ = http_parser_->CheckVersion(1, 0) ? 0 : 1;
+        PendingResponse& pending = pending_responses_[request->sequence_];
+        pending.close = !keep_alive;
+        pending.trace_sampled = request->trace_sampled_;
         request_callback_(shared_from_this(), std::move(request));
-        //TODO 线程版 业务不能异步处理 协程版可以挂起任务
-        if(need_close_) {
-            connection_->ForceClose();
-        }
     }
 }
 
-void HttpSession::SendString(HttpStatusCode code, const std::string& data) {
-    std::string header;
-    HttpResponse::SetStatusCode(code, header);
-    HttpResponse::SetHeader("Content-Type", "text/plain; charset=utf-8", header);
-    HttpResponse::SetHeader("Content-Length", std::to_string(data.size()), header);
-    header += "\r\n";
+size_t HttpSession::SendString(HttpStatusCode code, const std::string& data, uint64_t seq) {
+    return SendBody(code, "text/plain; charset=utf-8", data, nullptr, seq);
+}
+
+size_t HttpSession::SendJson(HttpStatusCode code, const std::string& data, uint64_t seq) {
+    return SendBody(code, "application/json; charset=utf-8", data, nullptr, seq);
+}
+
+size_t HttpSession::SendBody(HttpStatusCode code, const StringPiece& content_type, const StringPiece& data, const char* content_encoding, uint64_t seq, bool vary) {
+    HttpResponseBuilder header;
+    setContentHeader(code, content_type, data.Size(), content_encoding, vary, seq, header);
+    header.End();
     
     ByteData* bdata = new ByteData();
-    bdata->AddDataZeroCopy(header);
+    bdata->AddDataCopy(header.Piece());
     bdata->AddDataZeroCopy(data);
-    Send(bdata);
+    Send(bdata, seq);
+    return header.Size() + data.Size();
 }
 
-void HttpSession::SendJson(HttpStatusCode code, const std::string& data) {
-    std::string header;
-    HttpResponse::SetStatusCode(code, header);
-    HttpResponse::SetHeader("Content-Type", "application/json; charset=utf-8", header);
-    HttpResponse::SetHeader("Content-Length", std::to_string(data.size()), header);
-    //HttpResponse::SetBody(jsonstr, content);
-    header += "\r\n";
+size_t HttpSession::SendFile(HttpStatusCode code, const std::string& filepath, std::string filename, uint64_t seq) {
+    return SendFileRange(code, filepath, StringPiece(), StringPiece(), std::move(filename), seq);
+}
+
+static void appendContentRange(uint64_t offset, uint64_t length, uint64_t size, HttpResponseBuilder& header) {
+    header.Append("Content-Range: bytes ");
+    header.AppendUint(offset);
+    header.Append("-");
+    header.AppendUint(offset + length - 1);
+    header.Append("/");
+    header.AppendUint(size);
+    header.Append("\r\n");
+}
+
+//文件内容和元数据来自 FileCache，命中时不访问文件系统，区间直接引用缓存的内容(大文件为 mmap 的映射)
+size_t HttpSession::SendFileRange(HttpStatusCode code, const std::string& filepath, const StringPiece& range, const StringPiece& if_range, std::string filename, uint64_t seq, bool vary) {
+    std::shared_ptr<const CachedFile> file = FileCacheSingleton::GetInstance()->Get(filepath);
+    if(!file) {
+        return SendString(StatusNotFound, "404 page not found", seq);
+    }
     
-    ByteData* bdata = new ByteData();
-    bdata->AddDataZeroCopy(header);
-    bdata->AddDataZeroCopy(data);
-    Send(bdata);
-}
-
-void HttpSession::SendFile(HttpStatusCode code, const std::string& filepath, std::string filename) {
-    static std::unordered_map<std::string, std::string> filetypes = {
-        {"jpeg", "image/jpeg"},
-        {"jpg", "image/jpeg"},
-        {"png", "image.png"},
-        {"gif", "image/gif"},
-        {"mp3", "audio/mpeg"},
-        {"mp4", "video/mp4"},
-        {"txt", "text/plain"},
-        {"html", "text/html"},
-        {"pdf", "application/pdf"},
-        {"doc", "application/msword"},
-        {"docx", "application/msword"},
-        {"zip", "application/zip"},
-        {"gzip", "application/gzip"}
-    };
+    const FileContent& content = *file->content;
+    std::vector<ByteRange> ranges;
+    RangeResult result = RangeNone;
+    if(code == StatusOK && !range.Empty() && IfRangeMatches(if_range, file->etag, file->last_modified)) {
+        result = ParseRange(range, content.Size(), ranges);
+    }
     
-    if(filename.size() == 0) {
-        size_t pos = filepath.find_last_of('/');
-        if(pos != std::string::npos) {
-            filename = filepath.substr(pos + 1);
-        }
+    HttpResponseBuilder header;
+    if(result == RangeNotSatisfiable) {
+        setContentHeader(StatusRangeNotSatisfiable, "text/plain; charset=utf-8", 0, nullptr, vary, seq, header);
+        header.Append("Content-Range: bytes */");
+        header.AppendUint(content.Size());
+        header.Append("\r\n");
+        header.End();
+        ByteData* bdata = new ByteData();
+        bdata->AddDataCopy(header.Piece());
+        Send(bdata, seq);
+        return header.Size();
+    }
+    if(result == RangeSatisfiable && ranges.size() > 1) {
+        return sendByteRanges(*file, ranges, std::move(filename), seq, vary);
     }
     
-    std::string filetype = filepath.substr(filepath.find_last_of(".") + 1);
-    std::transform(filetype.begin(), filetype.end(), filetype.begin(), ::tolower);
+    uint64_t offset = 0;
+    uint64_t length = content.Size();
+    if(result == RangeSatisfiable) {
+        code = StatusPartialContent;
+        offset = ranges[0].offset;
+        length = ranges[0].length;
+    }
+    setContentHeader(code, file->mime, length, nullptr, vary, seq, header);
+    setValidatorHeader(*file, header);
+    if(result == RangeSatisfiable) {
+        appendContentRange(offset, length, content.Size(), header);
+    }
+    setAttachmentHeader(filepath, std::move(filename), header);
+    header.End();
     
-    auto iter = filetypes.find(filetype);
-    if(iter == filetypes.end()) {
-        filetype = "application/octet-stream";
-    }else {
-        filetype = iter->second;
+    ByteData* bdata = new ByteData();
+    bdata->AddDataCopy(header.Piece());
+    if(length > 0) {
+        bdata->AddDataShared(file->content, content.Data() + offset, length);
     }
+    Send(bdata, seq);
+    return header.Size() + length;
+}
+
+size_t HttpSession::sendByteRanges(const CachedFile& file, const std::vector<ByteRange>& ranges, std::string filename, uint64_t seq, bool vary) {
+    const FileContent& content = *file.content;
+    std::string boundary = generateBoundary(16);
+    //每个区间前是分隔行和该区间的 header，先拼好以计算 Content-Length
+    std::vector<std::string> part_headers;
+    part_headers.reserve(ranges.size());
+    uint64_t length = 0;
+    for(const ByteRange& range : ranges) {
+        std::string part = "\r\n--" + boundary + "\r\nContent-Type: " + file.mime + "\r\nContent-Range: bytes "
+            + std::to_string(range.offset) + "-" + std::to_string(range.offset + range.length - 1) + "/" + std::to_string(content.Size()) + "\r\n\r\n";
+        length += part.size() + range.length;
+        part_headers.push_back(std::move(part));
+    }
+    std::string end_boundary = "\r\n--" + boundary + "--\r\n";
+    length += end_boundary.size();
     
-    std::string header;
-    HttpResponse::SetStatusCode(code, header);
-    HttpResponse::SetHeader("Content-Type", filetype, header);
-    HttpResponse::SetHeader("Content-Disposition", "attachment; filename=" + filename, header);
-    int fd = open(filepath.c_str(), O_RDONLY);
-    assert(fd > 0);
-    struct stat st;
-    fstat(fd, &st);
-    HttpResponse::SetHeader("Content-Length", std::to_string(st.st_size), header);
-    header += "\r\n";
+    HttpResponseBuilder header;
+    setContentHeader(StatusPartialContent, "multipart/byteranges; boundary=" + boundary, length, nullptr, vary, seq, header);
+    setValidatorHeader(file, header);
+    setAttachmentHeader(file.path, std::move(filename), header);
+    header.End();
     
     ByteData* bdata = new ByteData();
-    bdata->AddDataZeroCopy(header);
-    bdata->AddFile(fd, st.st_size);
-    Send(bdata);
+    bdata->AddDataCopy(header.Piece());
+    for(size_t i = 0; i < ranges.size(); ++i) {
+        bdata->AddDataCopy(part_headers[i]);
+        bdata->AddDataShared(file.content, content.Data() + ranges[i].offset, ranges[i].length);
+    }
+    bdata->AddDataCopy(end_boundary);
+    Send(bdata, seq);
+    return header.Size() + length;
 }
 
-void HttpSession::SendMultipart(HttpStatusCode code, const std::vector<MultipartPart*>& parts) {
+size_t HttpSession::SendFile(HttpStatusCode code, const std::string& filepath, std::shared_ptr<const std::string> content, const char* content_encoding, std::string filename, uint64_t seq) {
+    HttpResponseBuilder header;
+    setContentHeader(code, HttpResponse::MimeType(filepath), content->size(), content_encoding, false, seq, header);
+    setAttachmentHeader(filepath, std::move(filename), header);
+    header.End();
+    
+    size_t size = content->size();
+    ByteData* bdata = new ByteData();
+    bdata->AddDataCopy(header.Piece());
+    bdata->AddDataShared(std::move(content));
+    Send(bdata, seq);
+    return header.Size() + size;
+}
+
+size_t HttpSession::SendMultipart(HttpStatusCode code, const std::vector<MultipartPart*>& parts, uint64_t seq) {
     
     std::string boundary = generateBoundary(16);
-    std::string header;
-    HttpResponse::SetStatusCode(code, header);
-    HttpResponse::SetHeader("Content-Type", "multipart/form-data; boundary=" + boundary, header);
+    HttpResponseBuilder header;
+    header.StatusLine(code);
+    header.Append("Content-Type: multipart/form-data; boundary=");
+    header.Append(boundary);
+    header.Append("\r\n");
     
     std::string begin_boundary = "\r\n--" + boundary + "\r\n";
     std::string end_boundary = "\r\n--" + boundary + "--";
@@ -158,11 +271,13 @@ void HttpSession::SendMultipart(HttpStatusCode code, const std::vector<Multipart
         totalsize += begin_boundary.size() + part->HeaderStr().size() + part->Size();
     }
     totalsize += end_boundary.size() - 2;
-    HttpResponse::SetHeader("Content-Length", std::to_string(totalsize), header);
+    header.Header("Content-Length", (uint64_t)totalsize);
+    header.Date();
+    setConnectionHeader(seq, header);
     
     
     ByteData* bdata = new ByteData();
-    bdata->AddDataZeroCopy(header);
+    bdata->AddDataCopy(header.Piece());
     for(MultipartPart* part : parts) {
         bdata->AddDataZeroCopy(begin_boundary);
         bdata->AddDataZeroCopy(part->HeaderStr());
@@ -173,21 +288,390 @@ void HttpSession::SendMultipart(HttpStatusCode code, const std::vector<Multipart
         }
     }
     bdata->AddDataZeroCopy(end_boundary);
-    Send(bdata);
+    Send(bdata, seq);
+    return header.Size() + totalsize;
+}
+
+size_t HttpSession::SendChunkedHeader(HttpStatusCode code, const std::string& content_type, bool chunked, uint64_t seq) {
+    HttpResponseBuilder header;
+    header.StatusLine(code);
+    header.Header("Content-Type", content_type);
+    header.Date();
+    if(chunked) {
+        header.Header("Transfer-Encoding", "chunked");
+        setConnectionHeader(seq, header);
+    }else {
+        //没有长度的响应体以关闭连接结束
+        header.Header("Connection", "close");
+        EventLoop* loop = OwnerLoop();
+        if(loop->isInLoopThread()) {
+            closeAfterInLoop(seq);
+        }else {
+            loop->AddTask(std::bind(&HttpSession::closeAfterInLoop, shared_from_this(), seq));
+        }
+    }
+    header.End();
+    
+    ByteData* bdata = new ByteData();
+    bdata->AddDataCopy(header.Piece());
+    Send(bdata, seq);
+    return header.Size();
+}
+
+size_t HttpSession::SendChunk(const StringPiece& data, bool chunked, uint64_t seq) {
+    if(!chunked) {
+        if(data.Empty()) return 0;
+        ByteData* bdata = new ByteData();
+        bdata->AddDataZeroCopy(data);
+        Send(bdata, seq);
+        return data.Size();
+    }
+    
+    //chunk 长度为十六进制，结束块为 "0\r\n\r\n"
+    char size_line[24];
+    int n = snprintf(size_line, sizeof(size_line), "%zx\r\n", data.Size());
+    ByteData* bdata = new ByteData();
+    bdata->AddDataCopy(size_line, n);
+    if(!data.Empty()) {
+        bdata->AddDataZeroCopy(data);
+    }
+    bdata->AddDataCopy("\r\n", 2);
+    Send(bdata, seq);
+    return n + data.Size() + 2;
+}
+
+bool HttpSession::Writable(uint64_t seq) const {
+    size_t bytes = connection_->PendingBytes() + writing_bytes_.load(std::memory_order_relaxed) + inflight_bytes_.load(std::memory_order_relaxed);
+    //缓存的数据都属于后面的请求，不影响正在发送的请求
+    if(seq != response_seq_.load(std::memory_order_relaxed)) {
+        bytes += buffered_bytes_.load(std::memory_order_relaxed);
+    }
+    return bytes < config_.stream_high_water_bytes;
+}
+
+void HttpSession::OnWriteComplete(std::function<void()> cb, uint64_t seq) {
+    EventLoop* loop = OwnerLoop();
+    if(loop->isInLoopThread()) {
+        onWriteCompleteInLoop(std::move(cb), seq);
+    }else {
+        loop->AddTask(std::bind(&HttpSession::onWriteCompleteInLoop, shared_from_this(), std::move(cb), seq));
+    }
+}
+
+void HttpSession::Send(ByteData* data, uint64_t seq) {
+    if(seq == kUnordered) {
+        connection_->Send(data);
+        return;
+    }
+    
+    EventLoop* loop = OwnerLoop();
+    if(loop->isInLoopThread()) {
+        sendInLoop(data, seq, false);
+    }else {
+        //零拷贝的数据指向调用方的临时对象，跨线程前先拷贝
+        data->CopyDataIfNeed();
+        //投递途中的数据计入 Writable，其他线程中的生产者才会在高水位处停下
+        inflight_bytes_.fetch_add(data->Size(), std::memory_order_relaxed);
+        loop->AddTask(std::bind(&HttpSession::sendInLoop, shared_from_this(), data, seq, true));
+    }
+}
+
+void HttpSession::FinishResponse(uint64_t seq) {
+    EventLoop* loop = OwnerLoop();
+    if(loop->isInLoopThread()) {
+        finishInLoop(seq);
+    }else {
+        loop->AddTask(std::bind(&HttpSession::finishInLoop, shared_from_this(), seq));
+    }
+}
+
+void HttpSession::sendInLoop(ByteData* data, uint64_t seq, bool inflight) {
+    size_t size = data->Size();
+    if(inflight) inflight_bytes_.fetch_sub(size, std::memory_order_relaxed);
+    //关闭连接的响应之后的数据不会再发送
+    if(!connection_->Connected() || seq > close_seq_.load(std::memory_order_relaxed)) {
+        delete data;
+    }else if(seq == response_seq_.load(std::memory_order_relaxed)) {
+        auto iter = pending_responses_.find(seq);
+        if(iter != pending_responses_.end()) {
+            data->SetTraceSampled(iter->second.trace_sampled);
+        }
+        writeReady(data);
+    }else {
+        //前面的请求还没有处理完
+        data->CopyDataIfNeed();
+        buffered_bytes_.fetch_add(size, std::memory_order_relaxed);
+        PendingResponse& pending = pending_responses_[seq];
+        data->SetTraceSampled(pending.trace_sampled);
+        pending.datas.push_back(data);
+    }
+    //连接上的数据已直接写完时不会再有写完成的通知
+    if(inflight && !write_complete_callbacks_.empty()) {
+        handleWriteComplete();
+    }
+}
+
+void HttpSession::finishInLoop(uint64_t seq) {
+    auto iter = pending_responses_.find(seq);
+    if(iter == pending_responses_.end()) return;
+    iter->second.finished = true;
+    flushResponses();
+}
+
+// 单次攒够64KB直接写出，大响应不做额外拷贝
+static const size_t kMaxCorkedBytes = 64 * 1024;
+
+// 轮到的响应先全部排进 ready_datas_ 再写：协程版写满时写的协程会挂起，
+// 期间其他协程(请求结束、其他线程投递的数据)可能修改 pending_responses_ 或再次进入这里
+void HttpSession::flushResponses() {
+    uint64_t head = response_seq_.load(std::memory_order_relaxed);
+    bool close = false;
+    while(!close) {
+        auto iter = pending_responses_.find(response_seq_.load(std::memory_order_relaxed));
+        if(iter == pending_responses_.end()) break;
+        
+        PendingResponse& pending = iter->second;
+        for(ByteData* data : pending.datas) {
+            buffered_bytes_.fetch_sub(data->Size(), std::memory_order_relaxed);
+            writeReady(data, false);
+        }
+        pending.datas.clear();
+        if(!pending.finished) break;
+        
+        close = pending.close;
+        pending_responses_.erase(iter);
+        response_seq_.fetch_add(1, std::memory_order_relaxed);
+    }
+    
+    if(close) {
+        //之后的响应不再发送，释放缓存的数据
+        for(auto& later : pending_responses_) {
+            for(ByteData* data : later.second.datas) {
+                buffered_bytes_.fetch_sub(data->Size(), std::memory_order_relaxed);
+                delete data;
+            }
+            later.second.datas.clear();
+        }
+        flushWrites();
+        //等已排队的数据写完再关闭，否则大响应会被截断
+        std::shared_ptr<TcpConnection> conn = connection_;
+        onWriteCompleteInLoop([conn](){
+            conn->ForceClose();
+        }, kUnordered);
+        return;
+    }
+    if(!corked_ || cork_owner_ != currentContext() || ready_bytes_ >= kMaxCorkedBytes) {
+        flushWrites();
+    }
+    //轮到后面的请求发送，等待它可写的回调可能已经满足
+    if(response_seq_.load(std::memory_order_relaxed) != head && !write_complete_callbacks_.empty()) {
+        handleWriteComplete();
+    }
+}
+
+void HttpSession::writeReady(ByteData* data, bool flush) {
+    if(!connection_->Connected()) {
+        delete data;
+        return;
+    }
+    ready_datas_.push_back(data);
+    ready_bytes_ += data->Size();
+    if(writing_) {
+        //排在正在写的数据之后，由写连接的协程写出
+        writing_bytes_.fetch_add(data->Size(), std::memory_order_relaxed);
+        data->CopyDataIfNeed();
+        return;
+    }
+    if(!flush) return;
+    if(!corked_ || cork_owner_ != currentContext() || ready_bytes_ >= kMaxCorkedBytes) {
+        flushWrites();
+        return;
+    }
+    //零拷贝的数据指向 SendX 中的临时对象，返回前拷贝
+    data->CopyDataIfNeed();
+}
+
+ByteData* HttpSession::mergeReadyDatas() {
+    ByteData* data = ready_datas_[0];
+    for(size_t i = 1; i < ready_datas_.size(); ++i) {
+        data->Append(ready_datas_[i]);
+        delete ready_datas_[i];
+    }
+    ready_datas_.clear();
+    ready_bytes_ = 0;
+    return data;
+}
+
+#ifdef COROUTINE
+// 其他协程(其他线程投递的数据、请求结束)在写的协程挂起期间就绪的数据合并后接着写，不会与正在写的数据交错
+void HttpSession::flushWrites() {
+    if(writing_ || ready_datas_.empty()) return;
+    std::shared_ptr<HttpSession> self = shared_from_this();
+    writing_ = true;
+    writing_bytes_.fetch_add(ready_bytes_, std::memory_order_relaxed);
+    while(!ready_datas_.empty()) {
+        size_t size = ready_bytes_;
+        ByteData* data = mergeReadyDatas();
+        if(connection_->Connected()) {
+            connection_->Send(data);
+        }else {
+            delete data;
+        }
+        writing_bytes_.fetch_sub(size, std::memory_order_relaxed);
+    }
+    writing_ = false;
+    //协程版连接没有写完成的通知，写完后检查等待的回调
+    if(!write_complete_callbacks_.empty()) {
+        handleWriteComplete();
+    }
+}
+#else
+void HttpSession::flushWrites() {
+    if(ready_datas_.empty()) return;
+    ByteData* data = mergeReadyDatas();
+    if(connection_->Connected()) {
+        connection_->Send(data);
+    }else {
+        delete data;
+    }
+}
+#endif
+
+// 不分块的流式响应以关闭连接结束，之后流水线中的请求不再处理
+void HttpSession::closeAfterInLoop(uint64_t seq) {
+    auto iter = pending_responses_.find(seq);
+    if(iter == pending_responses_.end()) return;
+    iter->second.close = true;
+    if(seq < close_seq_.load(std::memory_order_relaxed)) {
+        close_seq_.store(seq, std::memory_order_release);
+    }
+}
+
+//连接和投递途中都没有待发送的数据；seq 为 kUnordered 时还要求没有缓存的数据，否则要求已轮到该请求发送
+bool HttpSession::writeCompleted(uint64_t seq) const {
+    if(connection_->PendingBytes() > 0 || writing_ || inflight_bytes_.load(std::memory_order_relaxed) > 0) return false;
+    if(seq == kUnordered) return buffered_bytes_.load(std::memory_order_relaxed) == 0;
+    return seq <= response_seq_.load(std::memory_order_relaxed);
+}
+
+void HttpSession::onWriteCompleteInLoop(std::function<void()> cb, uint64_t seq) {
+    if(!connection_->Connected()) return;
+    //解析期间攒下的响应随后就会写出，不需要等待
+    if(writeCompleted(seq)) {
+        cb();
+        return;
+    }
+    write_complete_callbacks_.push_back(std::make_pair(seq, std::move(cb)));
+}
+
+void HttpSession::handleWriteComplete() {
+    std::vector<std::pair<uint64_t, std::function<void()>>> callbacks;
+    callbacks.swap(write_complete_callbacks_);
+    for(size_t i = 0; i < callbacks.size(); ++i) {
+        if(writeCompleted(callbacks[i].first)) {
+            callbacks[i].second();
+        }else {
+            write_complete_callbacks_.push_back(std::move(callbacks[i]));
+        }
+    }
+}
+
+// 回调中一般持有 Context，连接关闭后不会再触发，直接释放以结束请求
+void HttpSession::handleClose() {
+    std::vector<std::pair<uint64_t, std::function<void()>>> callbacks;
+    callbacks.swap(write_complete_callbacks_);
+}
+
+// 请求头未收完时按 header_timeout 的截止时间等待，请求之间按 keepalive_timeout 等待
+void HttpSession::updateIdleTimeout() {
+    if(upgrade_) return;
+    if(http_parser_->ReadingHeaders() && config_.header_timeout_ms >= 0) {
+        uint64_t now = Time::Now().MicroSecondsSinceEpoch() / 1000;
+        if(header_deadline_ms_ == 0) {
+            header_deadline_ms_ = now + config_.header_timeout_ms;
+        }
+        connection_->SetIdleTimeout(header_deadline_ms_ > now ? header_deadline_ms_ - now : 0);
+        return;
+    }
+    header_deadline_ms_ = 0;
+    //接收请求体或等待响应期间使用连接默认的超时
+    bool idle = !http_parser_->InMessage() && pending_responses_.empty();
+    connection_->SetIdleTimeout(idle ? config_.keepalive_timeout_ms : -1);
+}
+
+void HttpSession::setContentHeader(HttpStatusCode code, const StringPiece& content_type, uint64_t length, const char* content_encoding, bool vary, uint64_t seq, HttpResponseBuilder& header) const {
+    header.StatusLine(code);
+    header.Header("Content-Type", content_type);
+    if(content_encoding) {
+        header.Header("Content-Encoding", content_encoding);
+    }
+    //同一 URL 可能按 Accept-Encoding 返回不同编码，未压缩的响应也要告知缓存
+    if(content_encoding || vary) {
+        header.Header("Vary", "Accept-Encoding");
+    }
+    header.Header("Content-Length", length);
+    header.Date();
+    setConnectionHeader(seq, header);
+}
+
+void HttpSession::setValidatorHeader(const CachedFile& file, HttpResponseBuilder& header) {
+    header.Header("Accept-Ranges", "bytes");
+    header.Header("ETag", file.etag);
+    header.Header("Last-Modified", file.last_modified);
+}
+
+void HttpSession::setAttachmentHeader(const std::string& filepath, std::string filename, HttpResponseBuilder& header) {
+    if(filename.size() == 0) {
+        size_t pos = filepath.find_last_of('/');
+        if(pos != std::string::npos) {
+            filename = filepath.substr(pos + 1);
+        }
+    }
+    header.Append("Content-Disposition: attachment; filename=");
+    header.Append(filename);
+    header.Append("\r\n");
+}
+
+void HttpSession::setConnectionHeader(uint64_t seq, HttpResponseBuilder& header) const {
+    if(seq == kUnordered) return;
+    if(seq >= close_seq_.load(std::memory_order_acquire)) {
+        header.Header("Connection", "close");
+        return;
+    }
+    header.Header("Connection", "keep-alive");
+    bool timeout = config_.keepalive_timeout_ms >= 0;
+    bool max = config_.max_keepalive_requests > 0;
+    if(!timeout && !max) return;
+    header.Append("Keep-Alive: ");
+    if(timeout) {
+        header.Append("timeout=");
+        header.AppendUint(config_.keepalive_timeout_ms / 1000);
+    }
+    if(max) {
+        header.Append(timeout ? ", max=" : "max=");
+        header.AppendUint(config_.max_keepalive_requests - seq - 1);
+    }
+    header.Append("\r\n");
 }
 
-void HttpSession::Send(ByteData* data) {
-    connection_->Send(data);
+// 线程版 loop 中的调用都是同步的，协程版区分是否为解析所在的协程
+const void* HttpSession::currentContext() {
+#ifdef COROUTINE
+    coroutine::CoEventLoop* loop = coroutine::CoEventLoop::Current();
+    return loop ? (const void*)loop->GetCurrentCoroutine() : nullptr;
+#else
+    return nullptr;
+#endif
 }
 
 std::string HttpSession::generateBoundary(size_t len) {
-    static std::string charset = "0123456789abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ";
-    static int length = (int)charset.size();
+    static const char charset[] = "0123456789abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ";
+    //random_device 可能每次都要读取设备文件，每个线程只用它播种一次
+    static thread_local std::mt19937 gen(std::random_device{}());
     std::string boundary = "----";
-    std::random_device rd;
-    std::mt19937 gen(rd());
-    std::uniform_int_distribution<> dis(0, length - 1);
-    for(int i = 0; i < len; ++i) {
+    boundary.reserve(4 + len);
+    std::uniform_int_distribution<> dis(0, (int)sizeof(charset) - 2);
+    for(size_t i = 0; i < len; ++i) {
         boundary += charset[dis(gen)];
     }
     return boundary;
@@ -5,6 +5,12 @@
 #include "httpparser.h"
 #include "http_code.h"
 #include "httprequest.h"
+#include "cweb_config.h"
+#include "file_cache.h"
+#include "http_range.h"
+#include <atomic>
+#include <map>
+#include <vector>
 
 using namespace cweb::tcpserver;
 
@@ -12,6 +18,7 @@ namespace cweb {
 namespace httpserver {
 
 class WebSocket;
+class HttpResponseBuilder;
 class HttpSession : public std::enable_shared_from_this<HttpSession> {
 public:
     virtual ~HttpSession();
@@ -20,25 +27,97 @@ public:
     HttpSession(std::shared_ptr<TcpConnection> conn, RequestCallback cb);
     void Init();
     
-    void SendString(HttpStatusCode code, const std::string& data);
-    void SendJson(HttpStatusCode code, const std::string& data);
-    void SendFile(HttpStatusCode code, const std::string& filepath, std::string filename = "");
+    //不参与排序直接发送
+    static const uint64_t kUnordered = (uint64_t)-1;
+    
+    //seq 为请求序号，可在任意线程中调用，响应投递到所属loop后按请求顺序发送
+    size_t SendString(HttpStatusCode code, const std::string& data, uint64_t seq = kUnordered);
+    size_t SendJson(HttpStatusCode code, const std::string& data, uint64_t seq = kUnordered);
+    //content_encoding 不为空时带 Content-Encoding，data 为编码后的数据
+    //content_encoding 不为空或 vary 为 true(按 Accept-Encoding 协商过，未压缩)时带 Vary: Accept-Encoding
+    size_t SendBody(HttpStatusCode code, const StringPiece& content_type, const StringPiece& data, const char* content_encoding = nullptr, uint64_t seq = kUnordered, bool vary = false);
+    //文件不存在时响应 404
+    size_t SendFile(HttpStatusCode code, const std::string& filepath, std::string filename = "", uint64_t seq = kUnordered);
+    //range、if_range 为请求的 Range、If-Range，code 为 200 且 Range 生效时响应 206(多个区间为 multipart/byteranges)或 416
+    size_t SendFileRange(HttpStatusCode code, const std::string& filepath, const StringPiece& range, const StringPiece& if_range, std::string filename = "", uint64_t seq = kUnordered, bool vary = false);
+    //content 为缓存的文件内容(或压缩后的内容)，多个响应共享，不拷贝
+    size_t SendFile(HttpStatusCode code, const std::string& filepath, std::shared_ptr<const std::string> content, const char* content_encoding, std::string filename = "", uint64_t seq = kUnordered);
     //void SendMedia(HttpStatusCode code, const std::string& filepath, //type)
     //void SendBinary()
     //void SendHtml();
-    void SendMultipart(HttpStatusCode code, const std::vector<MultipartPart*>& parts);
-    void Send(ByteData* data);
+    size_t SendMultipart(HttpStatusCode code, const std::vector<MultipartPart*>& parts, uint64_t seq = kUnordered);
+    //流式响应，一般通过 ChunkedWriter 使用；chunked 为 false(HTTP/1.0)时不分块，发送完关闭连接表示结束
+    size_t SendChunkedHeader(HttpStatusCode code, const std::string& content_type, bool chunked, uint64_t seq);
+    //chunked 时空数据为结束块
+    size_t SendChunk(const StringPiece& data, bool chunked, uint64_t seq);
+    //连接待发送的数据(协程版为正在写和排队等待写的)、其他线程投递途中的和等待前面请求而缓存的响应数据之和低于 HttpConfig::stream_high_water_bytes
+    //seq 为写入方的请求序号，轮到该请求发送时不计缓存的数据(都属于后面的请求)
+    bool Writable(uint64_t seq = kUnordered) const;
+    //上述数据全部写出后在所属loop中回调一次，seq 不为 kUnordered 时等到轮到该请求发送且连接上的数据写完；连接关闭时丢弃
+    void OnWriteComplete(std::function<void()> cb, uint64_t seq = kUnordered);
+    void Send(ByteData* data, uint64_t seq = kUnordered);
+    //请求处理结束(Context 析构)，此后才发送后续请求的响应，需要关闭的连接在此时关闭
+    void FinishResponse(uint64_t seq);
+    EventLoop* OwnerLoop() const {return connection_->Ownerloop();}
+    bool Connected() const {return connection_->Connected();}
     
 protected:
     std::shared_ptr<TcpConnection> connection_;
     RequestCallback request_callback_;
     
 private:
-    friend class HttpParser;
+    struct PendingResponse {
+        std::vector<ByteData*> datas;       //轮到该请求前缓存的响应数据
+        bool close = false;
+        bool finished = false;
+        bool trace_sampled = false;
+    };
+    
     std::unique_ptr<HttpParser> http_parser_;
     std::shared_ptr<WebSocket> websocket_ ;
-    bool need_close_ = true;
+    HttpConfig config_;
     bool upgrade_ = false;
+    //不再保持连接的请求序号，其响应带 Connection: close，之后流水线中的请求不再处理
+    std::atomic<uint64_t> close_seq_ = {kUnordered};
+    //还没交给连接的响应数据：其他线程投递到loop途中的，以及等待前面请求处理完而缓存的
+    std::atomic<size_t> inflight_bytes_ = {0};
+    std::atomic<size_t> buffered_bytes_ = {0};
+    uint64_t header_deadline_ms_ = 0;
+    //以下只在所属loop线程中访问
+    uint64_t request_seq_ = 0;
+    std::atomic<uint64_t> response_seq_ = {0};     //其他线程只在 Writable 中读取
+    std::map<uint64_t, PendingResponse> pending_responses_;
+    std::vector<std::pair<uint64_t, std::function<void()>>> write_complete_callbacks_;
+    //解析一批请求(pipelining)期间就绪的响应先攒起来，解析结束后合并成一次 writev
+    std::vector<ByteData*> ready_datas_;
+    size_t ready_bytes_ = 0;
+    bool corked_ = false;
+    const void* cork_owner_ = nullptr;      //协程版为解析所在的协程，其他协程的响应不等待
+    //协程版写满时 Send 会挂起写的协程，同一时刻只有一个协程写连接，期间其他协程就绪的数据排在 ready_datas_ 中由它依次写出
+    bool writing_ = false;
+    std::atomic<size_t> writing_bytes_ = {0};      //交给写连接的协程还没写完的数据，计入 Writable
+    
+    //inflight 为 true 时 data 由其他线程投递，已计入 inflight_bytes_
+    void sendInLoop(ByteData* data, uint64_t seq, bool inflight);
+    bool writeCompleted(uint64_t seq) const;
+    void finishInLoop(uint64_t seq);
+    void flushResponses();
+    //flush 为 false 时只排队，由调用方随后写出，数据需已拷贝
+    void writeReady(ByteData* data, bool flush = true);
+    void flushWrites();
+    ByteData* mergeReadyDatas();
+    void updateIdleTimeout();
+    void closeAfterInLoop(uint64_t seq);
+    void onWriteCompleteInLoop(std::function<void()> cb, uint64_t seq);
+    void handleWriteComplete();
+    void handleClose();
+    void setConnectionHeader(uint64_t seq, HttpResponseBuilder& header) const;
+    //状态行和实体相关的 header，不含结束的空行
+    void setContentHeader(HttpStatusCode code, const StringPiece& content_type, uint64_t length, const char* content_encoding, bool vary, uint64_t seq, HttpResponseBuilder& header) const;
+    static void setAttachmentHeader(const std::string& filepath, std::string filename, HttpResponseBuilder& header);
+    static void setValidatorHeader(const CachedFile& file, HttpResponseBuilder& header);
+    size_t sendByteRanges(const CachedFile& file, const std::vector<ByteRange>& ranges, std::string filename, uint64_t seq, bool vary);
+    static const void* currentContext();
     virtual TcpConnection::MessageState handleMessage(std::shared_ptr<TcpConnection> conn, ByteBuffer* buf, Time time);
     void handleParsedMessage(std::unique_ptr<HttpRequest> request);
     static std::string generateBoundary(size_t len);
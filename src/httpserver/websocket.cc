@@ -20,7 +20,7 @@ void WebSocket::HandleClose() {
 }
 
 void WebSocket::Start(std::unique_ptr<HttpRequest> req) {
-    std::string sec_key = req->headers_["Sec-WebSocket-Key"] + "258EAFA5-E914-47DA-95CA-C5AB0DC85B11";
+    std::string sec_key = req->Header(HeaderSecWebSocketKey).ToString() + "258EAFA5-E914-47DA-95CA-C5AB0DC85B11";
     util::encrypt::SHA1 s;
     s.processBytes(sec_key.data(), sec_key.size());
     uint8_t digest[20];
@@ -31,10 +31,13 @@ FileAppender::~FileAppender() {
 
 void FileAppender::Log(LogInfo* logInfo) {
     
-    while(!logging_pipe_->MultiplePush(logInfo)) {
-        writer_->Wakeup();
-        std::unique_lock<std::mutex> lock(mutex_);
-        cond_.wait(lock);
+    if(!logging_pipe_->MultiplePush(logInfo)) {
+        //缓冲区已满，等待写线程消费
+        std::unique_lock<LogMutex> lock(mutex_);
+        while(!logging_pipe_->MultiplePush(logInfo)) {
+            writer_->Wakeup();
+            cond_.wait(lock);
+        }
     }
     writer_->Wakeup();
 }
@@ -69,13 +72,17 @@ void FileAppender::writeLogsfile() {
     }
     
     LogInfo *loginfo = logging_pipe_->SinglePop();
+    bool consumed = loginfo != nullptr;
     while(loginfo) {
         ofs_ << formatter_->Format(loginfo);
         writer_->DeallocLogInfo(loginfo);
         loginfo = logging_pipe_->SinglePop();
-        cond_.notify_all();
         ofs_.flush();
     }
+    if(consumed) {
+        std::unique_lock<LogMutex> lock(mutex_);
+        cond_.notify_all();
+    }
     writing_ = false;
 }
 
@@ -48,8 +48,8 @@ private:
     LogfilePipe* logging_pipe_;
     LogWriter* writer_;
     std::string module_;
-    std::mutex mutex_;
-    std::condition_variable cond_;
+    LogMutex mutex_;
+    LogCondition cond_;
     std::ofstream ofs_;
     bool writing_ = false;
 
@@ -36,15 +36,27 @@ void LogWriter::Sleep() {
 
 LogInfo* LogWriter::AllocLogInfo() {
     LogInfo* info = logfilepipe_->MultiplePop();
+    if(info) return info;
+    
+    //没有空闲的 LogInfo，等待写线程归还
+    std::unique_lock<LogMutex> lock(alloc_mutex_);
+    ++alloc_waiters_;
+    info = logfilepipe_->MultiplePop();
     while(!info) {
         Wakeup();
+        alloc_cond_.wait(lock);
         info = logfilepipe_->MultiplePop();
     }
+    --alloc_waiters_;
     return info;
 }
 
 void LogWriter::DeallocLogInfo(LogInfo *info) {
     logfilepipe_->MultiplePush(info);
+    if(alloc_waiters_.load() > 0) {
+        std::unique_lock<LogMutex> lock(alloc_mutex_);
+        alloc_cond_.notify_one();
+    }
 }
 
 void LogWriter::loop() {
@@ -3,13 +3,27 @@
 
 #include <functional>
 #include <mutex>
+#include <condition_variable>
+#include <atomic>
 #include <vector>
 #include "threadlocal_memorypool.h"
 #include "logfile_pipe.h"
+#ifdef COROUTINE
+#include "co_sync.h"
+#endif
 
 namespace cweb {
 namespace log {
 
+//日志缓冲区满时的等待，协程版只挂起当前协程
+#ifdef COROUTINE
+typedef tcpserver::coroutine::CoMutex LogMutex;
+typedef tcpserver::coroutine::CoCondition LogCondition;
+#else
+typedef std::mutex LogMutex;
+typedef std::condition_variable LogCondition;
+#endif
+
 class LogWriter {
     
 private:
@@ -20,6 +34,9 @@ private:
     std::vector<Functor> tasks_;
     util::MemoryPool* memorypool_ = new util::MemoryPool();
     LogfilePipe* logfilepipe_ = nullptr;
+    LogMutex alloc_mutex_;
+    LogCondition alloc_cond_;
+    std::atomic<int> alloc_waiters_ = {0};
     
     void loop();
     
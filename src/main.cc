@@ -224,6 +224,11 @@ int main() {
 #endif
     });
 
+    //指标接口 按路由统计耗时与请求/响应大小
+    c.Metrics("/metrics");
+    //请求追踪
+    c.Trace("/debug/trace");
+
     c.Run(2);
     return 0;
 }
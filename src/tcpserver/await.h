@@ -0,0 +1,360 @@
+#ifndef CWEB_TCP_AWAIT_H_
+#define CWEB_TCP_AWAIT_H_
+
+#ifdef CWEB_CO_AWAIT
+
+#if __cplusplus < 202002L
+#error "CWEB_CO_AWAIT 需要 C++20 (cmake -DCO_AWAIT=ON)"
+#endif
+
+#include <coroutine>
+#include <exception>
+#include <optional>
+#include <atomic>
+#include <memory>
+#include <utility>
+#include <type_traits>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include "eventloop.h"
+#include "event.h"
+#include "timer.h"
+#include "offload_pool.h"
+#include "noncopyable.h"
+
+/*
+ 基于 C++20 无栈协程的异步接口，与汇编上下文切换的有栈协程互不依赖，直接构建在 EventLoop 上
+ 协程帧按实际大小在堆上分配，挂起点之间的代码可以被编译器整体优化
+ 所有 awaitable 都在 loop 线程中恢复协程，建议配合线程版(poll/epoll)使用
+ */
+namespace cweb {
+namespace tcpserver {
+namespace await {
+
+//协程帧内存统计，用于对比有栈协程每个连接的内存占用
+struct FrameStats {
+    static inline std::atomic<uint64_t> live_frames = {0};
+    static inline std::atomic<uint64_t> live_bytes = {0};
+};
+
+template <typename T = void>
+class Task;
+
+namespace detail {
+
+struct PromiseBase {
+    std::coroutine_handle<> continuation;
+    bool detached = false;
+
+    static void* operator new(size_t size) {
+        FrameStats::live_frames.fetch_add(1, std::memory_order_relaxed);
+        FrameStats::live_bytes.fetch_add(size, std::memory_order_relaxed);
+        return ::operator new(size);
+    }
+
+    static void operator delete(void* ptr, size_t size) {
+        FrameStats::live_frames.fetch_sub(1, std::memory_order_relaxed);
+        FrameStats::live_bytes.fetch_sub(size, std::memory_order_relaxed);
+        ::operator delete(ptr);
+    }
+
+    //结束时直接切回等待者(对称转移)，顶层任务自行释放协程帧
+    struct FinalAwaiter {
+        bool await_ready() noexcept {return false;}
+
+        template <typename Promise>
+        std::coroutine_handle<> await_suspend(std::coroutine_handle<Promise> handle) noexcept {
+            PromiseBase& promise = handle.promise();
+            if(promise.continuation) return promise.continuation;
+            if(promise.detached) handle.destroy();
+            return std::noop_coroutine();
+        }
+
+        void await_resume() noexcept {}
+    };
+
+    //惰性启动，被 co_await 或 Detach 时才开始执行
+    std::suspend_always initial_suspend() noexcept {return {};}
+    FinalAwaiter final_suspend() noexcept {return {};}
+    //与项目其余部分一致，不使用异常
+    void unhandled_exception() noexcept {std::terminate();}
+};
+
+template <typename T>
+struct Promise : PromiseBase {
+    std::optional<T> value;
+
+    Task<T> get_return_object();
+
+    template <typename U>
+    void return_value(U&& val) {
+        value.emplace(std::forward<U>(val));
+    }
+
+    T Result() {return std::move(*value);}
+};
+
+template <>
+struct Promise<void> : PromiseBase {
+    Task<void> get_return_object();
+    void return_void() noexcept {}
+    void Result() {}
+};
+
+}
+
+template <typename T>
+class Task : public util::Noncopyable {
+public:
+    typedef detail::Promise<T> promise_type;
+    typedef std::coroutine_handle<promise_type> Handle;
+
+private:
+    Handle handle_;
+
+public:
+    explicit Task(Handle handle) : handle_(handle) {}
+    Task(Task&& other) noexcept : handle_(std::exchange(other.handle_, nullptr)) {}
+
+    ~Task() {
+        if(handle_) handle_.destroy();
+    }
+
+    bool await_ready() const noexcept {return !handle_ || handle_.done();}
+
+    std::coroutine_handle<> await_suspend(std::coroutine_handle<> continuation) noexcept {
+        handle_.promise().continuation = continuation;
+        return handle_;
+    }
+
+    T await_resume() {return handle_.promise().Result();}
+
+    //作为顶层任务在当前线程开始执行，第一次挂起时返回，结束后自动释放协程帧
+    void Detach() {
+        Handle handle = std::exchange(handle_, nullptr);
+        handle.promise().detached = true;
+        handle.resume();
+    }
+};
+
+namespace detail {
+
+template <typename T>
+inline Task<T> Promise<T>::get_return_object() {
+    return Task<T>(std::coroutine_handle<Promise<T>>::from_promise(*this));
+}
+
+inline Task<void> Promise<void>::get_return_object() {
+    return Task<void>(std::coroutine_handle<Promise<void>>::from_promise(*this));
+}
+
+}
+
+//co_await Sleep(loop, 100) 挂起100毫秒，由loop的定时器恢复
+class Sleep {
+private:
+    EventLoop* loop_;
+    uint64_t ms_;
+
+public:
+    Sleep(EventLoop* loop, uint64_t ms) : loop_(loop), ms_(ms) {}
+
+    bool await_ready() const noexcept {return ms_ == 0;}
+
+    void await_suspend(std::coroutine_handle<> handle) {
+        loop_->AddTimerMs(ms_, [handle](){
+            handle.resume();
+        });
+    }
+
+    void await_resume() noexcept {}
+};
+
+//co_await Post(loop) 切换到 loop 线程继续执行
+class Post {
+private:
+    EventLoop* loop_;
+
+public:
+    explicit Post(EventLoop* loop) : loop_(loop) {}
+
+    bool await_ready() const noexcept {return loop_->isInLoopThread();}
+
+    void await_suspend(std::coroutine_handle<> handle) {
+        loop_->AddTask([handle](){
+            handle.resume();
+        });
+    }
+
+    void await_resume() noexcept {}
+};
+
+/*
+ co_await Offload(loop, fn) 在卸载线程池中执行阻塞调用(数据库、redis、文件读写等)，
+ 执行完后回到 loop 线程恢复协程并返回 fn 的结果；线程池队列满时直接在当前线程执行
+ */
+template <typename F>
+class Offload {
+public:
+    typedef std::invoke_result_t<F> Result;
+
+private:
+    typedef std::conditional_t<std::is_void_v<Result>, bool, Result> Storage;
+    EventLoop* loop_;
+    F fn_;
+    std::optional<Storage> result_;
+
+    void run() {
+        if constexpr (std::is_void_v<Result>) {
+            fn_();
+            result_.emplace(true);
+        }else {
+            result_.emplace(fn_());
+        }
+    }
+
+public:
+    Offload(EventLoop* loop, F fn) : loop_(loop), fn_(std::move(fn)) {}
+
+    bool await_ready() const noexcept {return false;}
+
+    //awaitable 保存在协程帧中，挂起期间地址不变，工作线程可以直接写入结果
+    bool await_suspend(std::coroutine_handle<> handle) {
+        EventLoop* loop = loop_;
+        bool submitted = util::OffloadPoolSingleton::GetInstance()->Submit([this, loop, handle](){
+            run();
+            loop->AddTask([handle](){
+                handle.resume();
+            });
+        });
+        if(!submitted) {
+            run();
+            return false;
+        }
+        return true;
+    }
+
+    Result await_resume() {
+        if constexpr (!std::is_void_v<Result>) {
+            return std::move(*result_);
+        }
+    }
+};
+
+/*
+ 非阻塞 socket 的异步读写，同一方向同时只能有一个协程等待
+ Read/Write 先直接尝试一次，EAGAIN 时注册可读/可写事件挂起，就绪后再读写一次返回
+ */
+class AsyncSocket : public util::Noncopyable {
+private:
+    int fd_;
+    std::unique_ptr<Event> event_;
+    std::coroutine_handle<> read_waiter_;
+    std::coroutine_handle<> write_waiter_;
+
+    void handleRead() {
+        event_->DisableReading();
+        std::coroutine_handle<> handle = std::exchange(read_waiter_, nullptr);
+        if(handle) handle.resume();
+    }
+
+    void handleWrite() {
+        event_->DisableWriting();
+        std::coroutine_handle<> handle = std::exchange(write_waiter_, nullptr);
+        if(handle) handle.resume();
+    }
+
+public:
+    class IoAwaitable {
+    private:
+        AsyncSocket* socket_;
+        bool read_;
+        void* buf_;
+        size_t size_;
+        ssize_t result_ = -1;
+        //errno 在挂起期间可能被同一线程的其他调用覆盖，尝试后立即保存
+        int error_ = 0;
+        bool suspended_ = false;
+
+        void once() {
+            do {
+                result_ = read_ ? ::read(socket_->fd_, buf_, size_) : ::write(socket_->fd_, buf_, size_);
+            }while(result_ == -1 && errno == EINTR);
+            error_ = result_ == -1 ? errno : 0;
+        }
+
+    public:
+        IoAwaitable(AsyncSocket* socket, bool read, void* buf, size_t size)
+        : socket_(socket), read_(read), buf_(buf), size_(size) {}
+
+        bool await_ready() {
+            once();
+            return !(result_ == -1 && (error_ == EAGAIN || error_ == EWOULDBLOCK));
+        }
+
+        void await_suspend(std::coroutine_handle<> handle) {
+            suspended_ = true;
+            if(read_) {
+                socket_->read_waiter_ = handle;
+                socket_->event_->EnableReading();
+            }else {
+                socket_->write_waiter_ = handle;
+                socket_->event_->EnableWriting();
+            }
+        }
+
+        //出错时返回 -1，errno 为本次读写的错误
+        ssize_t await_resume() {
+            if(suspended_) {
+                suspended_ = false;
+                once();
+            }
+            if(result_ == -1) errno = error_;
+            return result_;
+        }
+    };
+
+    //fd 的所有权交给 AsyncSocket，析构时关闭
+    AsyncSocket(std::shared_ptr<EventLoop> loop, int fd) : fd_(fd), event_(new Event(loop, fd, true)) {
+        ::fcntl(fd_, F_SETFL, ::fcntl(fd_, F_GETFL, 0) | O_NONBLOCK);
+        event_->SetReadCallback([this](Time){
+            handleRead();
+        });
+        event_->SetWriteCallback([this](){
+            handleWrite();
+        });
+    }
+
+    ~AsyncSocket() {
+        event_->DisableAll();
+        event_->Remove();
+        ::close(fd_);
+    }
+
+    int Fd() const {return fd_;}
+
+    IoAwaitable Read(void* buf, size_t size) {return IoAwaitable(this, true, buf, size);}
+    IoAwaitable Write(const void* buf, size_t size) {return IoAwaitable(this, false, (void*)buf, size);}
+
+    //写完全部数据或出错为止，返回已写入的字节数，出错且一个字节都没写入时返回-1
+    Task<ssize_t> WriteAll(const void* buf, size_t size) {
+        size_t written = 0;
+        while(written < size) {
+            ssize_t n = co_await Write((const char*)buf + written, size - written);
+            if(n <= 0) {
+                co_return written > 0 ? (ssize_t)written : n;
+            }
+            written += n;
+        }
+        co_return (ssize_t)written;
+    }
+};
+
+}
+}
+}
+
+#endif
+
+#endif
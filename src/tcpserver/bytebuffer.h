@@ -3,6 +3,7 @@
 
 #include <string>
 #include <cstring>
+#include <strings.h>
 
 namespace cweb {
 namespace tcpserver {
@@ -27,6 +28,20 @@ public:
     
     size_t Size() const {return length_;}
     
+    bool Empty() const {return length_ == 0;}
+    
+    //需要在数据来源释放后继续使用时拷贝一份
+    std::string ToString() const {return std::string(ptr_, length_);}
+    
+    bool operator==(const StringPiece& other) const {
+        return length_ == other.length_ && (length_ == 0 || memcmp(ptr_, other.ptr_, length_) == 0);
+    }
+    bool operator!=(const StringPiece& other) const {return !(*this == other);}
+    
+    bool EqualsIgnoreCase(const StringPiece& other) const {
+        return length_ == other.length_ && strncasecmp(ptr_, other.ptr_, length_) == 0;
+    }
+    
 };
 
 class ByteBuffer {
@@ -42,9 +57,9 @@ public:
     explicit ByteBuffer(size_t initialSize = kInitialSize)
     :readindex_(kCheapPrepend),
      writeindex_(kCheapPrepend),
-     size_(kCheapPrepend + kInitialSize){
-         buffer_ = (char *)malloc((kCheapPrepend + kInitialSize) * sizeof(char));
-         memset(buffer_, 0, kCheapPrepend + kInitialSize);
+     size_(kCheapPrepend + initialSize){
+         buffer_ = (char *)malloc((kCheapPrepend + initialSize) * sizeof(char));
+         memset(buffer_, 0, kCheapPrepend + initialSize);
      }
     
     ~ByteBuffer() {
@@ -1,13 +1,79 @@
 #include "bytedata.h"
 #include "hooks.h"
+#include "trace.h"
 //#include <sys/uio.h>
 #include <sys/stat.h>
 #include <fcntl.h>
 #include <assert.h>
+#include <limits.h>
+#include <algorithm>
 
 namespace cweb {
 namespace tcpserver {
 
+// 线程内的空闲对象链表，只缓存固定数量，其余归还给 malloc
+struct FreeNode {
+    FreeNode* next;
+};
+
+struct FreeList {
+    FreeNode* head;
+    size_t count;
+};
+
+static const size_t kMaxFreeObjects = 1024;
+
+static void* allocateFrom(FreeList& list, size_t size) {
+    if(list.head == nullptr) return ::operator new(size);
+    FreeNode* node = list.head;
+    list.head = node->next;
+    --list.count;
+    return node;
+}
+
+static void freeTo(FreeList& list, void* p) {
+    if(p == nullptr) return;
+    if(list.count >= kMaxFreeObjects) {
+        ::operator delete(p);
+        return;
+    }
+    FreeNode* node = (FreeNode*)p;
+    node->next = list.head;
+    list.head = node;
+    ++list.count;
+}
+
+//POD 类型的 thread_local 没有析构顺序问题，线程退出时缓存的对象不再释放
+static thread_local FreeList free_packets = {nullptr, 0};
+static thread_local FreeList free_datas = {nullptr, 0};
+
+void* DataPacket::operator new(size_t size) {
+    return allocateFrom(free_packets, size);
+}
+
+void DataPacket::operator delete(void* p) {
+    freeTo(free_packets, p);
+}
+
+void* ByteData::operator new(size_t size) {
+    return allocateFrom(free_datas, size);
+}
+
+void ByteData::operator delete(void* p) {
+    freeTo(free_datas, p);
+}
+
+DataPacket* ByteData::copyInline(const void* data, size_t size) {
+    if(inline_size_ + size > kInlineSize) return nullptr;
+    DataPacket* dp = new DataPacket();
+    dp->inline_ = true;
+    dp->zero_copy_data_ = inline_data_ + inline_size_;
+    dp->size_ = size;
+    memcpy(inline_data_ + inline_size_, data, size);
+    inline_size_ += size;
+    return dp;
+}
+
 void ByteData::AddDataZeroCopy(const StringPiece& data) {
     AddDataZeroCopy(data.Data(), data.Size());
 }
@@ -25,19 +91,47 @@ void ByteData::AddDataCopy(const StringPiece &data) {
 }
 
 void ByteData::AddDataCopy(const void *data, size_t size) {
-    DataPacket* dp = new DataPacket();
+    DataPacket* dp = copyInline(data, size);
+    if(dp) {
+        datas_.push_back(dp);
+        return;
+    }
+    dp = new DataPacket();
     dp->copy_ = true;
-    dp->copy_data_ = new ByteBuffer(size * 2);
+    dp->copy_data_ = new ByteBuffer(size);
     dp->copy_data_->Append((const char*)data, size);
     dp->size_ += size;
     datas_.push_back(dp);
 }
 
+void ByteData::AddDataShared(std::shared_ptr<const std::string> data) {
+    const char* p = data->data();
+    size_t size = data->size();
+    AddDataShared(std::move(data), p, size);
+}
+
+void ByteData::AddDataShared(std::shared_ptr<const void> owner, const char* data, size_t size) {
+    DataPacket* dp = new DataPacket();
+    dp->zero_copy_data_ = (char*)data;
+    dp->size_ = size;
+    dp->shared_data_ = std::move(owner);
+    datas_.push_back(dp);
+}
+
 void ByteData::AppendData(const void *data, size_t size) {
     int len = (int)datas_.size();
-    assert(len != 0 && !datas_[len-1]->copy_);
-    datas_[len-1]->copy_data_->Append((const char*)data, size);
-    datas_[len-1]->size_ += size;
+    assert(len != 0);
+    DataPacket* last = datas_[len-1];
+    if(last->inline_) {
+        last->copy_data_ = new ByteBuffer(last->size_ + size);
+        last->copy_data_->Append(last->zero_copy_data_, last->size_);
+        last->zero_copy_data_ = nullptr;
+        last->inline_ = false;
+        last->copy_ = true;
+    }
+    assert(last->copy_);
+    last->copy_data_->Append((const char*)data, size);
+    last->size_ += size;
 }
 
 void ByteData::AddFile(const std::string &filepath) {
@@ -65,10 +159,79 @@ void ByteData::AddFile(int fd, size_t size) {
     datas_.push_back(dp);
 }
 
+void ByteData::Append(ByteData* other) {
+    if(!other->Remain()) return;
+    //合并后一次写出，其中有被采样的响应就记录
+    trace_sampled_ = trace_sampled_ || other->trace_sampled_;
+    for(size_t i = other->current_index_; i < other->datas_.size(); ++i) {
+        DataPacket* data = other->datas_[i];
+        //部分写出的数据块只保留剩余部分
+        if(i == other->current_index_ && other->offset_ > 0) {
+            DataPacket* rest = new DataPacket();
+            rest->size_ = data->size_ - other->offset_;
+            if(data->shared_data_) {
+                rest->zero_copy_data_ = data->zero_copy_data_ + other->offset_;
+                rest->shared_data_ = std::move(data->shared_data_);
+            }else {
+                rest->copy_ = true;
+                rest->copy_data_ = new ByteBuffer(rest->size_);
+                rest->copy_data_->Append(data->Data() + other->offset_, rest->size_);
+            }
+            datas_.push_back(rest);
+            delete data;
+            continue;
+        }
+        //other 内部缓冲区中的数据随 other 释放，需要转存
+        if(data->inline_) {
+            DataPacket* moved = copyInline(data->Data(), data->size_);
+            if(!moved) {
+                moved = new DataPacket();
+                moved->copy_ = true;
+                moved->size_ = data->size_;
+                moved->copy_data_ = new ByteBuffer(data->size_);
+                moved->copy_data_->Append(data->Data(), data->size_);
+            }
+            datas_.push_back(moved);
+            delete data;
+            continue;
+        }
+        datas_.push_back(data);
+    }
+    for(size_t i = 0; i < other->current_index_; ++i) {
+        delete other->datas_[i];
+    }
+    other->datas_.clear();
+    other->current_index_ = 0;
+    other->offset_ = 0;
+    other->inline_size_ = 0;
+}
+
+size_t ByteData::Size() const {
+    if(datas_.empty()) return 0;
+    size_t size = 0;
+    for(size_t i = current_index_; i < datas_.size(); ++i) {
+        size += datas_[i]->size_;
+    }
+    return size - offset_;
+}
+
 ssize_t ByteData::Writev(int fd) {
     if(!Remain()) return 0;
-    std::vector<struct iovec> iovs;
-    for(int i = (int)current_index_; i < datas_.size(); ++i) {
+    if(trace_sampled_ && trace_start_us_ == 0 && util::TracerSingleton::GetInstance()->Enabled()) {
+        trace_start_us_ = util::Tracer::NowMicros();
+    }
+    //超过 IOV_MAX 时 writev 返回 EINVAL，剩余的数据块下次再写
+    int last = (int)std::min(datas_.size(), current_index_ + IOV_MAX);
+    int count = last - (int)current_index_;
+    //常见的响应只有几个数据块，iovec 放在栈上
+    struct iovec stack_iovs[16];
+    std::vector<struct iovec> heap_iovs;
+    struct iovec* iovs = stack_iovs;
+    if(count > 16) {
+        heap_iovs.resize(count);
+        iovs = &heap_iovs[0];
+    }
+    for(int i = (int)current_index_; i < last; ++i) {
         struct iovec iov;
         DataPacket* data = datas_[i];
         if(i == (int)current_index_) {
@@ -78,18 +241,23 @@ ssize_t ByteData::Writev(int fd) {
             iov.iov_base = (void*)data->Data();
             iov.iov_len = data->size_;
         }
-        iovs.push_back(iov);
+        iovs[i - current_index_] = iov;
     }
 
-    ssize_t n = writev(fd, (struct iovec*)(&*iovs.begin()), (int)iovs.size());
+    ssize_t n = writev(fd, iovs, count);
     if(n > 0) {
         offset_ += n;
         modifyIndexAndOffset();
+        //发送完成，跨越多次可写事件时耗时包含等待时间
+        if(trace_start_us_ > 0 && !Remain()) {
+            util::TracerSingleton::GetInstance()->Record("writev", trace_start_us_, util::Tracer::NowMicros() - trace_start_us_);
+        }
     }
     return n;
 }
 
 bool ByteData::Remain() {
+    if(datas_.empty()) return false;
     return !(current_index_ == datas_.size() - 1 && offset_ == datas_[datas_.size() - 1]->size_);
 }
 
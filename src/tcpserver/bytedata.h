@@ -3,6 +3,8 @@
 
 #include "bytebuffer.h"
 #include <vector>
+#include <memory>
+#include <string>
 #include <unistd.h>
 #include <sys/mman.h>
 
@@ -17,9 +19,16 @@ private:
     size_t size_ = 0;
     int fd_ = -1;
     bool copy_ = false;
+    bool inline_ = false;     //数据在所属 ByteData 的内部缓冲区中，随 ByteData 释放
+    std::shared_ptr<const void> shared_data_;      //多个响应共享的不可变数据，发送期间持有引用
     
 public:
     friend class ByteData;
+    
+    //数据块和 ByteData 每个响应都要创建，释放后缓存在当前线程中复用
+    static void* operator new(size_t size);
+    static void operator delete(void* p);
+    
     ~DataPacket() {
         if(copy_) {
             delete copy_data_;
@@ -37,7 +46,7 @@ public:
     }
     
     bool CopyIfNeed(size_t offset = 0) {
-        if(copy_ || fd_ > 0) return false;
+        if(copy_ || inline_ || shared_data_ || fd_ > 0) return false;
         copy_ = true;
         size_ -= offset;
         copy_data_ = new ByteBuffer(size_);
@@ -47,30 +56,76 @@ public:
     }
 };
 
+// 前几个数据块存放在对象内部，超出时再使用 vector
+class DataPacketList {
+private:
+    static const size_t kInlineCount = 4;
+    DataPacket* inline_[kInlineCount];
+    std::vector<DataPacket*> more_;
+    size_t size_ = 0;
+    
+public:
+    size_t size() const {return size_;}
+    bool empty() const {return size_ == 0;}
+    DataPacket*& operator[](size_t i) {return i < kInlineCount ? inline_[i] : more_[i - kInlineCount];}
+    DataPacket* operator[](size_t i) const {return i < kInlineCount ? inline_[i] : more_[i - kInlineCount];}
+    void push_back(DataPacket* data) {
+        if(size_ < kInlineCount) inline_[size_] = data;
+        else more_.push_back(data);
+        ++size_;
+    }
+    void clear() {
+        more_.clear();
+        size_ = 0;
+    }
+};
+
 class ByteData {
 private:
-    std::vector<DataPacket*> datas_;
+    static const size_t kInlineSize = 512;
+    
+    DataPacketList datas_;
     size_t current_index_ = 0;
     int offset_ = 0;
+    bool trace_sampled_ = false;
+    uint64_t trace_start_us_ = 0;     //被采样时记录首次写出时间，写完后上报
+    //AddDataCopy 的小块数据(通常是响应头)直接拷贝到这里
+    char inline_data_[kInlineSize];
+    size_t inline_size_ = 0;
     
     void modifyIndexAndOffset();
+    DataPacket* copyInline(const void* data, size_t size);
     
 public:
+    static void* operator new(size_t size);
+    static void operator delete(void* p);
+    
     ~ByteData() {
-        for(DataPacket* data : datas_) delete data;
+        for(size_t i = 0; i < datas_.size(); ++i) delete datas_[i];
     }
     
     //内部不拷贝，注意不要提前释放数据，如果一次性没有发完的数据需要手动调用CopyDataIfNeed方法对数据进行缓存
     void AddDataZeroCopy(const StringPiece& data);
     void AddDataZeroCopy(const void* data, size_t size);
     
-    //内部会存在一次拷贝
+    //内部会存在一次拷贝，剩余内部空间足够时不再分配内存
     void AddDataCopy(const StringPiece& data);
     void AddDataCopy(const void* data, size_t size);
+    //不拷贝，持有引用直到发送完成
+    void AddDataShared(std::shared_ptr<const std::string> data);
+    //data 指向 owner 所持有的数据
+    void AddDataShared(std::shared_ptr<const void> owner, const char* data, size_t size);
     void AppendData(const void* data, size_t size);
     void AddFile(const std::string& filepath);
     void AddFile(int fd, size_t size);
  
+    //把 other 尚未写出的数据块移到末尾，合并后一次 writev 发出，other 不再持有数据
+    void Append(ByteData* other);
+    //尚未写出的字节数
+    size_t Size() const;
+ 
+    //被采样的请求的响应，写完后记录 writev 埋点
+    void SetTraceSampled(bool sampled) {trace_sampled_ = sampled;}
     ssize_t Writev(int fd);
     bool Remain();
     void CopyDataIfNeed();
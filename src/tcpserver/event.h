@@ -28,7 +28,9 @@ public:
     Event(std::shared_ptr<EventLoop> loop, int fd, bool is_socket = false) : loop_(loop), fd_(fd), is_socket_(is_socket) {
         flags_ = ::fcntl(fd_, F_GETFL, 0);
     }
-    
+    //连接等持有的是 Event 指针，CoEvent 析构时要从loop的截止时间堆中移除
+    virtual ~Event() {}
+
     typedef std::function<void()> EventCallback;
     typedef std::function<void(Time)> ReadEventCallback;
     
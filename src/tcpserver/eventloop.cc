@@ -75,6 +75,12 @@ Timer* EventLoop::AddTimer(uint64_t s, Functor cb, int repeats) {
     return timer;
 }
 
+Timer* EventLoop::AddTimerMs(uint64_t ms, Functor cb) {
+    Timer* timer = Timer::AfterMs(ms, std::move(cb));
+    timermanager_->AddTimer(timer);
+    return timer;
+}
+
 void EventLoop::RemoveTimer(Timer *timer) {
     timermanager_->RemoveTimer(timer);
 }
@@ -31,6 +31,7 @@ public:
     virtual void AddTask(Functor cb);
     virtual void AddTasks(std::vector<Functor>& cbs);
     virtual Timer* AddTimer(uint64_t s, Functor cb, int repeats = 1);
+    Timer* AddTimerMs(uint64_t ms, Functor cb);
     void RemoveTimer(Timer* timer);
     virtual void UpdateEvent(Event* event);
     virtual void RemoveEvent(Event* event);
@@ -1,13 +1,16 @@
 #include "hooks.h"
 #include "timer.h"
 #include "singleton.h"
-#include "pthread_keys.h"
 #include "logger.h"
 #include <fcntl.h>
 #include <unistd.h>
 #include <dlfcn.h>
 #include <iostream>
 #include <sys/uio.h>
+#include <poll.h>
+#include <time.h>
+#include <stdarg.h>
+#include <atomic>
 #include "event.h"
 
 #define COROUTINE       // 主动设置协程，方便看代码
@@ -30,20 +33,167 @@ typedef ssize_t (*write_fun)(int, const void *, size_t);
 typedef ssize_t (*writev_fun)(int fd, const struct iovec *iov, int iovcnt);
 typedef int (*accept_fun)(int s, struct sockaddr *addr, socklen_t *addrlen);
 typedef unsigned int (*sleep_fun)(unsigned int seconds);
+typedef int (*usleep_fun)(useconds_t usec);
+typedef int (*nanosleep_fun)(const struct timespec *req, struct timespec *rem);
+typedef int (*connect_fun)(int fd, const struct sockaddr *addr, socklen_t len);
+typedef ssize_t (*recv_fun)(int fd, void *buf, size_t len, int flags);
+typedef ssize_t (*send_fun)(int fd, const void *buf, size_t len, int flags);
+typedef ssize_t (*recvfrom_fun)(int fd, void *buf, size_t len, int flags, struct sockaddr *addr, socklen_t *addrlen);
+typedef ssize_t (*sendto_fun)(int fd, const void *buf, size_t len, int flags, const struct sockaddr *addr, socklen_t addrlen);
+typedef int (*poll_fun)(struct pollfd *fds, nfds_t nfds, int timeout);
+typedef int (*select_fun)(int nfds, fd_set *readfds, fd_set *writefds, fd_set *exceptfds, struct timeval *timeout);
+typedef int (*fcntl_fun)(int fd, int cmd, ...);
+typedef int (*setsockopt_fun)(int fd, int level, int optname, const void *optval, socklen_t optlen);
+typedef int (*close_fun)(int fd);
+
+//其他编译单元的静态初始化中也可能调用，不能依赖全局变量的初始化顺序
+static poll_fun originPoll() {
+    static poll_fun poll_f = (poll_fun)dlsym(RTLD_NEXT, "poll");
+    return poll_f;
+}
+
+static fcntl_fun originFcntl() {
+    static fcntl_fun fcntl_f = (fcntl_fun)dlsym(RTLD_NEXT, "fcntl");
+    return fcntl_f;
+}
+
+/*
+ 非框架创建的 socket(数据库、redis、上游服务等客户端连接)在协程中第一次使用时接管：
+ 底层强制设为非阻塞，用户视角的 O_NONBLOCK 单独记录，fcntl 读写的都是用户视角的标志，
+ 用户要求阻塞语义时由 hook 挂起协程等待就绪，SO_RCVTIMEO/SO_SNDTIMEO 作为等待超时
+ */
+enum {
+    kFdChecked = 1,         //已检查过是否为socket
+    kFdHooked = 1 << 1,     //底层已设为非阻塞
+    kFdUserNonblock = 1 << 2,
+};
+
+struct FdState {
+    std::atomic<uint8_t> flags = {0};
+    std::atomic<int> recv_timeout_ms = {-1};
+    std::atomic<int> send_timeout_ms = {-1};
+};
+
+static const int kMaxHookedFd = 65536;
+static FdState fd_states[kMaxHookedFd];
+
+static FdState* fdState(int fd) {
+    if(fd < 0 || fd >= kMaxHookedFd) return nullptr;
+    return &fd_states[fd];
+}
+
+static void resetFd(int fd) {
+    FdState* state = fdState(fd);
+    if(!state) return;
+    state->flags.store(0, std::memory_order_relaxed);
+    state->recv_timeout_ms.store(-1, std::memory_order_relaxed);
+    state->send_timeout_ms.store(-1, std::memory_order_relaxed);
+}
+
+static bool fdHooked(int fd) {
+    FdState* state = fdState(fd);
+    return state && (state->flags.load(std::memory_order_relaxed) & kFdHooked);
+}
+
+static bool fdUserNonblock(int fd) {
+    FdState* state = fdState(fd);
+    return state && (state->flags.load(std::memory_order_relaxed) & kFdUserNonblock);
+}
+
+#ifdef COROUTINE
+static CoEventLoop* currentLoop() {
+    CoEventLoop* loop = CoEventLoop::Current();
+    if(!loop || !loop->GetCurrentCoroutine()) return nullptr;
+    return loop;
+}
+#endif
+
+//只在协程中调用，非socket的fd保持原样
+static void hookFd(int fd) {
+    FdState* state = fdState(fd);
+    if(!state || (state->flags.load(std::memory_order_relaxed) & kFdChecked)) return;
+    
+    uint8_t flags = kFdChecked;
+    int type = 0;
+    socklen_t len = sizeof(type);
+    if(::getsockopt(fd, SOL_SOCKET, SO_TYPE, &type, &len) == 0) {
+        int fl = originFcntl()(fd, F_GETFL, 0);
+        if(fl != -1) {
+            if(fl & O_NONBLOCK) flags |= kFdUserNonblock;
+            if((fl & O_NONBLOCK) || originFcntl()(fd, F_SETFL, fl | O_NONBLOCK) == 0) {
+                flags |= kFdHooked;
+            }
+        }
+    }
+    state->flags.fetch_or(flags, std::memory_order_relaxed);
+}
+
+//等待fd就绪，超时返回false；协程中挂起当前协程，否则阻塞线程
+static bool waitFd(int fd, int events, int timeout_ms) {
+#ifdef COROUTINE
+    CoEventLoop* loop = currentLoop();
+    //框架自己的 event 由 io_handler 处理，不在这里重复注册
+    if(loop && !loop->GetEvent(fd)) {
+        //不持有loop，也不分配控制块
+        std::shared_ptr<CoEventLoop> owner(std::shared_ptr<CoEventLoop>(), loop);
+        std::unique_ptr<CoEvent> event(new CoEvent(owner, fd, true));
+        bool ready = event->Wait(events, timeout_ms);
+        event->DisableAll();
+        event->Remove();
+        return ready;
+    }
+#endif
+    struct pollfd pfd;
+    pfd.fd = fd;
+    pfd.events = 0;
+    if(events & READ_EVENT) pfd.events |= POLLIN;
+    if(events & WRITE_EVENT) pfd.events |= POLLOUT;
+    pfd.revents = 0;
+    int n = originPoll()(&pfd, 1, timeout_ms);
+    while(n == -1 && errno == EINTR) {
+        n = originPoll()(&pfd, 1, timeout_ms);
+    }
+    return n != 0;
+}
+
+//已接管的非框架fd：用户要求阻塞时在 EAGAIN 上等待就绪
+template<typename OriginFun, typename... Args>
+ssize_t hooked_io(int fd, OriginFun fun, int type, Args&&... args) {
+#ifdef COROUTINE
+    if(currentLoop()) hookFd(fd);
+#endif
+    if(!fdHooked(fd) || fdUserNonblock(fd)) {
+        return fun(fd, std::forward<Args>(args)...);
+    }
+    
+    FdState* state = fdState(fd);
+    int timeout_ms = type == READ_EVENT ? state->recv_timeout_ms.load(std::memory_order_relaxed) : state->send_timeout_ms.load(std::memory_order_relaxed);
+    while(true) {
+        ssize_t n = fun(fd, std::forward<Args>(args)...);
+        if(n != -1) return n;
+        if(errno == EINTR) continue;
+        if(errno != EAGAIN && errno != EWOULDBLOCK) return n;
+        if(!waitFd(fd, type, timeout_ms)) {
+            errno = EAGAIN;
+            return -1;
+        }
+    }
+}
 
 template<typename OriginFun, typename... Args>
 ssize_t io_handler(int fd, OriginFun fun, int type, Args&&... args) {
 #ifdef COROUTINE
-    CoEventLoop* TLSCoEventLoop = (CoEventLoop*)pthread_getspecific(util::PthreadKeysSingleton::GetInstance()->TLSEventLoop);
+    CoEventLoop* TLSCoEventLoop = CoEventLoop::Current();
     
-    if(!TLSCoEventLoop) {
-        return fun(fd, std::forward<Args>(args)...);
+    //主协程(定时器回调、inline任务)中不能挂起，直接调用原函数
+    if(!TLSCoEventLoop || !TLSCoEventLoop->GetCurrentCoroutine()) {
+        return hooked_io(fd, fun, type, std::forward<Args>(args)...);
     }
     
     CoEvent* event = TLSCoEventLoop->GetEvent(fd);
     
     if(!event) {
-        return fun(fd, std::forward<Args>(args)...);
+        return hooked_io(fd, fun, type, std::forward<Args>(args)...);
     }
     
     if(!event->IsSocket()) {
@@ -64,42 +214,36 @@ ssize_t io_handler(int fd, OriginFun fun, int type, Args&&... args) {
     }
 
 block:
-    Timer* timer = TLSCoEventLoop->AddTimer(10, [event](){
-        event->HandleTimeout();
-    });
-    
-    if(type == READ_EVENT) {
-        if(!event->Readable()) {
-            event->EnableReading();
-            event->SetReadCoroutine(TLSCoEventLoop->GetCurrentCoroutine());
+    {
+        //超时由loop的截止时间堆处理，挂起路径上没有内存分配
+        int64_t timeout_ms = type == READ_EVENT ? event->ReadTimeout() : event->WriteTimeout();
+        while(true) {
+            if(!event->Wait(type, timeout_ms)) {
+                errno = EAGAIN;
+                return -1;
+            }
+            ssize_t n = fun(fd, std::forward<Args>(args)...);
+            while(n == -1 && errno == EINTR) {
+                n = fun(fd, std::forward<Args>(args)...);
+            }
+            //连接关闭唤醒时不再等待
+            if(n == -1 && errno == EAGAIN && !event->Triggred()) {
+                continue;
+            }
+            return n;
         }
-    }else {
-        if(!event->Writable()) {
-            event->EnableWriting();
-            event->SetWriteCoroutine(TLSCoEventLoop->GetCurrentCoroutine());
-        }
-    }
-    
-    TLSCoEventLoop->GetCurrentCoroutine()->SetState(Coroutine::HOLD);
-    TLSCoEventLoop->GetCurrentCoroutine()->SwapTo(TLSCoEventLoop->GetMainCoroutine());
-    
-    //TODO 考虑timer事件和读写事件同时入队列的情况
-    if(timer && !event->Triggred()) {
-        TLSCoEventLoop->RemoveTimer(timer);
     }
-    
-    return fun(fd, std::forward<Args>(args)...);
 #else
-    return fun(fd, std::forward<Args>(args)...);
+    return hooked_io(fd, fun, type, std::forward<Args>(args)...);
 #endif
 }
 
 int accept(int fd, struct sockaddr *addr, socklen_t *len) {
     static accept_fun accept_f = (accept_fun)dlsym(RTLD_NEXT, "accept");
 #ifdef COROUTINE
-    CoEventLoop* TLSCoEventLoop = (CoEventLoop*)pthread_getspecific(util::PthreadKeysSingleton::GetInstance()->TLSEventLoop);
+    CoEventLoop* TLSCoEventLoop = CoEventLoop::Current();
     
-    if(!TLSCoEventLoop) {
+    if(!TLSCoEventLoop || !TLSCoEventLoop->GetCurrentCoroutine()) {
         return accept_f(fd, addr, len);
     }
     
@@ -126,6 +270,7 @@ block:
         event->EnableReading();
         event->SetReadCoroutine(TLSCoEventLoop->GetCurrentCoroutine());
     }
+    TLSCoEventLoop->GetCurrentCoroutine()->SetWait(Coroutine::WAIT_ACCEPT, fd);
     TLSCoEventLoop->GetCurrentCoroutine()->SetState(Coroutine::HOLD);
     TLSCoEventLoop->GetCurrentCoroutine()->SwapTo(TLSCoEventLoop->GetMainCoroutine());
 #else
@@ -154,21 +299,291 @@ ssize_t writev(int fd, const struct iovec *iov, int iovcnt) {
     return io_handler(fd, writev_f, WRITE_EVENT, iov, iovcnt);
 }
 
+static void sleepMs(uint64_t ms) {
+#ifdef COROUTINE
+    CoEventLoop* loop = currentLoop();
+    if(loop) {
+        Coroutine* co = loop->GetCurrentCoroutine();
+        loop->AddTimerMs(ms, [co](){
+            co->SetState(Coroutine::READY);
+        });
+        co->SetWait(Coroutine::WAIT_SLEEP);
+        co->SetState(Coroutine::HOLD);
+        co->SwapTo(loop->GetMainCoroutine());
+        return;
+    }
+#endif
+    struct timespec ts;
+    ts.tv_sec = ms / 1000;
+    ts.tv_nsec = (ms % 1000) * 1000000;
+    static nanosleep_fun nanosleep_f = (nanosleep_fun)dlsym(RTLD_NEXT, "nanosleep");
+    while(nanosleep_f(&ts, &ts) == -1 && errno == EINTR);
+}
+
 unsigned int sleep(unsigned int seconds) {
     static sleep_fun sleep_f = (sleep_fun)dlsym(RTLD_NEXT, "sleep");
 #ifdef COROUTINE
-    CoEventLoop* TLSCoEventLoop = (CoEventLoop*)pthread_getspecific(util::PthreadKeysSingleton::GetInstance()->TLSEventLoop);
-    Coroutine* co = TLSCoEventLoop->GetCurrentCoroutine();
-    TLSCoEventLoop->AddTimer(seconds, [TLSCoEventLoop, co](){
-        // 注册协程唤醒操作
-        TLSCoEventLoop->AddCoroutineWithState(co);
-    });
-    TLSCoEventLoop->GetCurrentCoroutine()->SetState(Coroutine::HOLD);
-    TLSCoEventLoop->GetCurrentCoroutine()->SwapTo(TLSCoEventLoop->GetMainCoroutine());
-    return 0;
-#else
+    if(currentLoop()) {
+        sleepMs((uint64_t)seconds * 1000);
+        return 0;
+    }
+#endif
     return sleep_f(seconds);
+}
+
+//协程中精度为毫秒，向上取整
+int usleep(useconds_t usec) {
+    static usleep_fun usleep_f = (usleep_fun)dlsym(RTLD_NEXT, "usleep");
+#ifdef COROUTINE
+    if(currentLoop()) {
+        sleepMs((usec + 999) / 1000);
+        return 0;
+    }
+#endif
+    return usleep_f(usec);
+}
+
+int nanosleep(const struct timespec *req, struct timespec *rem) {
+    static nanosleep_fun nanosleep_f = (nanosleep_fun)dlsym(RTLD_NEXT, "nanosleep");
+#ifdef COROUTINE
+    if(currentLoop() && req) {
+        if(req->tv_sec < 0 || req->tv_nsec < 0 || req->tv_nsec >= 1000000000) {
+            errno = EINVAL;
+            return -1;
+        }
+        sleepMs((uint64_t)req->tv_sec * 1000 + (req->tv_nsec + 999999) / 1000000);
+        if(rem) {
+            rem->tv_sec = 0;
+            rem->tv_nsec = 0;
+        }
+        return 0;
+    }
+#endif
+    return nanosleep_f(req, rem);
+}
+
+int connect(int fd, const struct sockaddr *addr, socklen_t len) {
+    static connect_fun connect_f = (connect_fun)dlsym(RTLD_NEXT, "connect");
+#ifdef COROUTINE
+    if(currentLoop()) hookFd(fd);
+#endif
+    if(!fdHooked(fd) || fdUserNonblock(fd)) {
+        return connect_f(fd, addr, len);
+    }
+    
+    int n = connect_f(fd, addr, len);
+    if(n == 0 || errno != EINPROGRESS) return n;
+    
+    //连接建立(或失败)时fd可写，超时沿用 SO_SNDTIMEO
+    if(!waitFd(fd, WRITE_EVENT, fdState(fd)->send_timeout_ms.load(std::memory_order_relaxed))) {
+        errno = ETIMEDOUT;
+        return -1;
+    }
+    int err = 0;
+    socklen_t errlen = sizeof(err);
+    if(::getsockopt(fd, SOL_SOCKET, SO_ERROR, &err, &errlen) == -1) return -1;
+    if(err) {
+        errno = err;
+        return -1;
+    }
+    return 0;
+}
+
+ssize_t recv(int fd, void *buf, size_t len, int flags) {
+    static recv_fun recv_f = (recv_fun)dlsym(RTLD_NEXT, "recv");
+    return io_handler(fd, recv_f, READ_EVENT, buf, len, flags);
+}
+
+ssize_t send(int fd, const void *buf, size_t len, int flags) {
+    static send_fun send_f = (send_fun)dlsym(RTLD_NEXT, "send");
+    return io_handler(fd, send_f, WRITE_EVENT, buf, len, flags);
+}
+
+ssize_t recvfrom(int fd, void *buf, size_t len, int flags, struct sockaddr *addr, socklen_t *addrlen) {
+    static recvfrom_fun recvfrom_f = (recvfrom_fun)dlsym(RTLD_NEXT, "recvfrom");
+    return io_handler(fd, recvfrom_f, READ_EVENT, buf, len, flags, addr, addrlen);
+}
+
+ssize_t sendto(int fd, const void *buf, size_t len, int flags, const struct sockaddr *addr, socklen_t addrlen) {
+    static sendto_fun sendto_f = (sendto_fun)dlsym(RTLD_NEXT, "sendto");
+    return io_handler(fd, sendto_f, WRITE_EVENT, buf, len, flags, addr, addrlen);
+}
+
+//只接管单个fd且需要等待的情况，其余交给原函数
+int poll(struct pollfd *fds, nfds_t nfds, int timeout) {
+#ifdef COROUTINE
+    if(nfds == 1 && timeout != 0 && fds[0].fd >= 0 && currentLoop()) {
+        int n = originPoll()(fds, 1, 0);
+        if(n != 0) return n;
+        int events = 0;
+        if(fds[0].events & (POLLIN | POLLPRI)) events |= READ_EVENT;
+        if(fds[0].events & POLLOUT) events |= WRITE_EVENT;
+        if(!waitFd(fds[0].fd, events, timeout)) return 0;
+        return originPoll()(fds, 1, 0);
+    }
+#endif
+    return originPoll()(fds, nfds, timeout);
+}
+
+int select(int nfds, fd_set *readfds, fd_set *writefds, fd_set *exceptfds, struct timeval *timeout) {
+    static select_fun select_f = (select_fun)dlsym(RTLD_NEXT, "select");
+#ifdef COROUTINE
+    if(currentLoop() && (!timeout || timeout->tv_sec || timeout->tv_usec)) {
+        int timeout_ms = timeout ? (int)(timeout->tv_sec * 1000 + (timeout->tv_usec + 999) / 1000) : -1;
+        int fd = -1;
+        int count = 0;
+        for(int i = 0; i < nfds; ++i) {
+            if((readfds && FD_ISSET(i, readfds)) || (writefds && FD_ISSET(i, writefds)) || (exceptfds && FD_ISSET(i, exceptfds))) {
+                fd = i;
+                ++count;
+            }
+        }
+        
+        //常见的用 select 睡眠
+        if(count == 0 && timeout) {
+            sleepMs(timeout_ms);
+            return 0;
+        }
+        
+        if(count == 1) {
+            struct pollfd pfd;
+            pfd.fd = fd;
+            pfd.events = 0;
+            pfd.revents = 0;
+            if(readfds && FD_ISSET(fd, readfds)) pfd.events |= POLLIN;
+            if(writefds && FD_ISSET(fd, writefds)) pfd.events |= POLLOUT;
+            if(exceptfds && FD_ISSET(fd, exceptfds)) pfd.events |= POLLPRI;
+            int n = poll(&pfd, 1, timeout_ms);
+            if(n <= 0) {
+                if(n == 0) {
+                    if(readfds) FD_CLR(fd, readfds);
+                    if(writefds) FD_CLR(fd, writefds);
+                    if(exceptfds) FD_CLR(fd, exceptfds);
+                }
+                return n;
+            }
+            int res = 0;
+            if(readfds && FD_ISSET(fd, readfds)) {
+                if(pfd.revents & (POLLIN | POLLHUP | POLLERR)) ++res;
+                else FD_CLR(fd, readfds);
+            }
+            if(writefds && FD_ISSET(fd, writefds)) {
+                if(pfd.revents & (POLLOUT | POLLHUP | POLLERR)) ++res;
+                else FD_CLR(fd, writefds);
+            }
+            if(exceptfds && FD_ISSET(fd, exceptfds)) {
+                if(pfd.revents & POLLPRI) ++res;
+                else FD_CLR(fd, exceptfds);
+            }
+            return res;
+        }
+    }
+#endif
+    return select_f(nfds, readfds, writefds, exceptfds, timeout);
+}
+
+//F_GETFL/F_SETFL 对已接管的fd只读写用户视角的 O_NONBLOCK，底层始终保持非阻塞
+int fcntl(int fd, int cmd, ...) {
+    va_list va;
+    va_start(va, cmd);
+    int res;
+    switch(cmd) {
+        case F_GETFL: {
+            va_end(va);
+            res = originFcntl()(fd, cmd);
+            if(res != -1 && fdHooked(fd)) {
+                res = fdUserNonblock(fd) ? (res | O_NONBLOCK) : (res & ~O_NONBLOCK);
+            }
+            return res;
+        }
+        case F_SETFL: {
+            int arg = va_arg(va, int);
+            va_end(va);
+            FdState* state = fdState(fd);
+            if(state && fdHooked(fd)) {
+                if(arg & O_NONBLOCK) {
+                    state->flags.fetch_or(kFdUserNonblock, std::memory_order_relaxed);
+                }else {
+                    state->flags.fetch_and((uint8_t)~kFdUserNonblock, std::memory_order_relaxed);
+                }
+                arg |= O_NONBLOCK;
+            }
+            return originFcntl()(fd, cmd, arg);
+        }
+        case F_GETFD:
+        case F_GETOWN:
+#ifdef F_GETSIG
+        case F_GETSIG:
+#endif
+#ifdef F_GETLEASE
+        case F_GETLEASE:
+#endif
+#ifdef F_GETPIPE_SZ
+        case F_GETPIPE_SZ:
 #endif
+            va_end(va);
+            return originFcntl()(fd, cmd);
+        case F_DUPFD:
+#ifdef F_DUPFD_CLOEXEC
+        case F_DUPFD_CLOEXEC:
+#endif
+        case F_SETFD:
+        case F_SETOWN:
+#ifdef F_SETSIG
+        case F_SETSIG:
+#endif
+#ifdef F_SETLEASE
+        case F_SETLEASE:
+#endif
+#ifdef F_NOTIFY
+        case F_NOTIFY:
+#endif
+#ifdef F_SETPIPE_SZ
+        case F_SETPIPE_SZ:
+#endif
+        {
+            int arg = va_arg(va, int);
+            va_end(va);
+            return originFcntl()(fd, cmd, arg);
+        }
+        default: {
+            //F_GETLK/F_SETLK/F_SETLKW 等指针参数
+            void* arg = va_arg(va, void*);
+            va_end(va);
+            return originFcntl()(fd, cmd, arg);
+        }
+    }
+}
+
+int setsockopt(int fd, int level, int optname, const void *optval, socklen_t optlen) {
+    static setsockopt_fun setsockopt_f = (setsockopt_fun)dlsym(RTLD_NEXT, "setsockopt");
+    FdState* state = fdState(fd);
+    if(state && level == SOL_SOCKET && (optname == SO_RCVTIMEO || optname == SO_SNDTIMEO) && optval && optlen >= sizeof(struct timeval)) {
+        const struct timeval* tv = (const struct timeval*)optval;
+        int ms = (int)(tv->tv_sec * 1000 + (tv->tv_usec + 999) / 1000);
+        //0表示不超时
+        if(ms == 0) ms = -1;
+        (optname == SO_RCVTIMEO ? state->recv_timeout_ms : state->send_timeout_ms).store(ms, std::memory_order_relaxed);
+#ifdef COROUTINE
+        //框架连接的超时保存在 CoEvent 上
+        CoEventLoop* loop = CoEventLoop::Current();
+        CoEvent* event = loop ? loop->GetEvent(fd) : nullptr;
+        if(event) {
+            if(optname == SO_RCVTIMEO) {
+                event->SetReadTimeout(ms);
+            }else {
+                event->SetWriteTimeout(ms);
+            }
+        }
+#endif
+    }
+    return setsockopt_f(fd, level, optname, optval, optlen);
+}
+
+int close(int fd) {
+    static close_fun close_f = (close_fun)dlsym(RTLD_NEXT, "close");
+    resetFd(fd);
+    return close_f(fd);
 }
 
 }
@@ -2,6 +2,10 @@
 #define CWEB_TCP_HOOKS_H_
 
 #include <sys/socket.h>
+#include <sys/select.h>
+#include <poll.h>
+#include <time.h>
+#include <unistd.h>
 
 namespace cweb {
 namespace tcpserver {
@@ -14,8 +18,22 @@ ssize_t readv(int fd, const struct iovec *iov, int iovcnt);
 ssize_t write(int fd, const void *buf, size_t nbyte);
 ssize_t writev(int fd, const struct iovec *iov, int iovcnt);
 
+ssize_t recv(int fd, void *buf, size_t len, int flags);
+ssize_t send(int fd, const void *buf, size_t len, int flags);
+ssize_t recvfrom(int fd, void *buf, size_t len, int flags, struct sockaddr *addr, socklen_t *addrlen);
+ssize_t sendto(int fd, const void *buf, size_t len, int flags, const struct sockaddr *addr, socklen_t addrlen);
+
 int accept(int fd, struct sockaddr *addr, socklen_t *len);
+int connect(int fd, const struct sockaddr *addr, socklen_t len);
+int poll(struct pollfd *fds, nfds_t nfds, int timeout);
+int select(int nfds, fd_set *readfds, fd_set *writefds, fd_set *exceptfds, struct timeval *timeout);
+int fcntl(int fd, int cmd, ...);
+int setsockopt(int fd, int level, int optname, const void *optval, socklen_t optlen);
+int close(int fd);
+
 unsigned int sleep(unsigned int seconds);
+int usleep(useconds_t usec);
+int nanosleep(const struct timespec *req, struct timespec *rem);
 
 }
 
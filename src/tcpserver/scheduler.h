@@ -20,7 +20,7 @@ protected:
     
 public:
     Scheduler(std::shared_ptr<EventLoop> baseloop, int threadcnt);
-    ~Scheduler();
+    virtual ~Scheduler();
     std::shared_ptr<EventLoop> GetNextLoop();
     virtual void Start();
     virtual void Stop();
@@ -4,9 +4,11 @@
 #include "socket.h"
 #include "inetaddress.h"
 #include "logger.h"
+#include "trace.h"
 #include <unistd.h>
 
 using namespace cweb::log;
+using namespace cweb::util;
 
 namespace cweb {
 namespace tcpserver {
@@ -36,7 +38,12 @@ void TcpConnection::handleRead(Time time) {
     
     cancelTimer();
     
-    ssize_t n = inputbuffer_->Readv(socket_->Fd());
+    trace_sampled_ = TracerSingleton::GetInstance()->Sample();
+    ssize_t n = 0;
+    {
+        TRACE_SCOPE(trace_sampled_, "read");
+        n = inputbuffer_->Readv(socket_->Fd());
+    }
     if(n > 0) {
         if(message_callback_) {
             message_callback_(shared_from_this(), inputbuffer_.get(), time);
@@ -55,7 +62,10 @@ void TcpConnection::handleRead(Time time) {
 void TcpConnection::handleWrite() {
     if(event_ && event_->Writable()) {
         ByteData* data = send_datas_.front();
-        data->Writev(socket_->Fd());
+        ssize_t n = data->Writev(socket_->Fd());
+        if(n > 0) {
+            pending_bytes_.fetch_sub(n, std::memory_order_relaxed);
+        }
         if(!data->Remain()) {
             send_datas_.pop();
             delete data;
@@ -63,6 +73,9 @@ void TcpConnection::handleWrite() {
         
         if(send_datas_.size() == 0) {
             event_->DisableWriting();
+            if(write_complete_callback_) {
+                write_complete_callback_(shared_from_this());
+            }
         }
     }
 }
@@ -91,6 +104,8 @@ void TcpConnection::Send(ByteData *data) {
     if(ownerloop_->isInLoopThread()) {
         sendInLoop(data);
     }else {
+        //零拷贝的数据指向调用方的临时对象，跨线程前先拷贝
+        data->CopyDataIfNeed();
         ownerloop_->AddTask(std::bind(&TcpConnection::sendInLoop, this, data));
     }
 }
@@ -106,6 +121,7 @@ void TcpConnection::sendInLoop(ByteData *data) {
     
     if(data->Remain()) {
         data->CopyDataIfNeed();
+        pending_bytes_.fetch_add(data->Size(), std::memory_order_relaxed);
         send_datas_.push(data);
         if(!event_->Writable()) {
             event_->EnableWriting();
@@ -150,8 +166,9 @@ void TcpConnection::cancelTimer() {
 }
 
 void TcpConnection::resumeTimer() {
-    if(connect_state_ == Connected()) {
-        timeout_timer_ = ownerloop_->AddTimer(10, std::bind(&TcpConnection::handleTimeout, this));
+    if(Connected()) {
+        uint64_t ms = idle_timeout_ms_ >= 0 ? idle_timeout_ms_ : 10 * 1000;
+        timeout_timer_ = ownerloop_->AddTimerMs(ms, std::bind(&TcpConnection::handleTimeout, this));
     }
 }
 
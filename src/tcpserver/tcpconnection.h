@@ -6,6 +6,7 @@
 #include "inetaddress.h"
 #include "timer.h"
 #include <queue>
+#include <atomic>
 #include <memory>
 #include <string>
 #include <functional>
@@ -31,6 +32,7 @@ public:
     typedef std::function<void(std::shared_ptr<TcpConnection>)> ConnectedCallback;
     typedef std::function<void(std::shared_ptr<TcpConnection>)> CloseCallback;
     typedef std::function<MessageState(std::shared_ptr<TcpConnection>, ByteBuffer*, Time)> MessageCallback;
+    typedef std::function<void(std::shared_ptr<TcpConnection>)> WriteCompleteCallback;
     
 protected:
     enum ConnectState {
@@ -48,11 +50,15 @@ protected:
     CloseCallback close_callback_;
     MessageCallback message_callback_;
     ConnectedCallback connected_callback_;
+    WriteCompleteCallback write_complete_callback_;
     std::queue<ByteData*> send_datas_;
+    std::atomic<size_t> pending_bytes_ = {0};     //send_datas_ 中尚未写出的字节数
+    bool trace_sampled_ = false;                  //最近一次读到的数据(其中的请求)是否被采样
     std::shared_ptr<EventLoop> ownerloop_;
     std::unique_ptr<Socket> socket_;
     std::unique_ptr<Event> event_;
     Timer* timeout_timer_;
+    int64_t idle_timeout_ms_ = -1;
 
     void handleRead(Time time);
     void handleWrite();
@@ -72,6 +78,15 @@ public:
     void SetConnectedCallback(ConnectedCallback cb) {connected_callback_ = std::move(cb);}
     void SetCloseCallback(CloseCallback cb) {close_callback_ = std::move(cb);}
     void SetMessageCallback(MessageCallback cb) {message_callback_ = std::move(cb);}
+    //排队的数据全部写出后在loop中回调，用于发送方的流量控制
+    void SetWriteCompleteCallback(WriteCompleteCallback cb) {write_complete_callback_ = std::move(cb);}
+    //等待可写事件的数据量，可在任意线程中读取；协程版 Send 直接写完，始终为0
+    size_t PendingBytes() const {return pending_bytes_.load(std::memory_order_relaxed);}
+    //只在所属loop中读取，解析出的请求从这里取得采样结果
+    bool TraceSampled() const {return trace_sampled_;}
+    //下一次等待数据的超时，超时后关闭连接，< 0 使用默认值(线程版10s，协程版 CoroutineConfig::read_timeout_ms)
+    //只在所属loop线程中调用，一般在 MessageCallback 中按协议状态设置
+    void SetIdleTimeout(int64_t ms) {idle_timeout_ms_ = ms;}
     
     TcpConnection(std::shared_ptr<EventLoop> loop, Socket* socket, InetAddress* addr, const std::string& id);
     virtual ~TcpConnection();
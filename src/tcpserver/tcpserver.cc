@@ -7,10 +7,12 @@
 #include "eventloop.h"
 #include "scheduler.h"
 #include "logger.h"
+#include "trace.h"
 #include <boost/uuid/uuid.hpp>
 #include <boost/uuid/uuid_io.hpp>
 
 using namespace cweb::log;
+using namespace cweb::util;
 namespace cweb {
 namespace tcpserver {
 
@@ -53,6 +55,7 @@ void TcpServer::Quit() {
 }
 
 void TcpServer::handleAccept() {
+    TRACE_SCOPE(TracerSingleton::GetInstance()->Sample(), "accept");
     InetAddress* peeraddr = new InetAddress();
     int connfd = accept_socket_->Accept(peeraddr);
     
@@ -27,6 +27,12 @@ Timer::Timer(uint64_t interval, std::function<void()> cb, int repeats)
   repeats_(repeats),
   executionTime_(Time::Now() += interval * 1000 * 1000) {}
 
+Timer* Timer::AfterMs(uint64_t ms, std::function<void()> cb) {
+    Timer* timer = new Timer(0, std::move(cb), 1);
+    timer->executionTime_ = Time::Now() += ms * 1000;
+    return timer;
+}
+
 bool Timer::Execute() {
     if(cancel_) return false;
     
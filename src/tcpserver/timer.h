@@ -68,6 +68,8 @@ public:
     friend TimerWheelManager;
     //毫秒
     Timer(uint64_t interval, std::function<void()> cb, int repeats = 1);
+    //毫秒级的一次性定时器
+    static Timer* AfterMs(uint64_t ms, std::function<void()> cb);
     
     Time ExecutionTime() const {return executionTime_;}
     uint64_t ExecutionInterval() {return executionTime_ - Time::Now();}
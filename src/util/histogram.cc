@@ -0,0 +1,95 @@
+#include "histogram.h"
+#include <math.h>
+#include <algorithm>
+
+namespace cweb {
+namespace util {
+
+Histogram::Histogram(int sub_bucket_bits, int max_value_bits)
+: sub_bucket_bits_(sub_bucket_bits),
+  max_value_bits_(max_value_bits),
+  sub_bucket_count_(1ULL << sub_bucket_bits),
+  sub_bucket_half_(1ULL << (sub_bucket_bits - 1)) {
+    // [0, sub_bucket_count_) 线性区 + 每个更高位一段 sub_bucket_half_ 个桶
+    size_t segments = max_value_bits_ - sub_bucket_bits_ + 1;
+    counts_.resize(sub_bucket_count_ + segments * sub_bucket_half_, 0);
+}
+
+size_t Histogram::indexOf(uint64_t value) const {
+    if(value < sub_bucket_count_) return (size_t)value;
+    int msb = 63 - __builtin_clzll(value);
+    if(msb >= max_value_bits_) return counts_.size() - 1;
+    int shift = msb - (sub_bucket_bits_ - 1);
+    uint64_t sub = value >> shift;
+    return (size_t)(sub_bucket_count_ + (shift - 1) * sub_bucket_half_ + (sub - sub_bucket_half_));
+}
+
+uint64_t Histogram::lowestValueAt(size_t index) const {
+    if(index < sub_bucket_count_) return index;
+    size_t offset = index - sub_bucket_count_;
+    int shift = (int)(offset / sub_bucket_half_) + 1;
+    uint64_t sub = offset % sub_bucket_half_ + sub_bucket_half_;
+    return sub << shift;
+}
+
+uint64_t Histogram::highestValueAt(size_t index) const {
+    if(index < sub_bucket_count_) return index;
+    size_t offset = index - sub_bucket_count_;
+    int shift = (int)(offset / sub_bucket_half_) + 1;
+    return lowestValueAt(index) + (1ULL << shift) - 1;
+}
+
+void Histogram::Record(uint64_t value, uint64_t count) {
+    counts_[indexOf(value)] += count;
+    total_count_ += count;
+    sum_ += value * count;
+    if(value < min_) min_ = value;
+    if(value > max_) max_ = value;
+}
+
+bool Histogram::Merge(const Histogram& other) {
+    if(other.counts_.size() != counts_.size() || other.sub_bucket_bits_ != sub_bucket_bits_) {
+        return false;
+    }
+
+    for(size_t i = 0; i < counts_.size(); ++i) {
+        counts_[i] += other.counts_[i];
+    }
+    total_count_ += other.total_count_;
+    sum_ += other.sum_;
+    if(other.min_ < min_) min_ = other.min_;
+    if(other.max_ > max_) max_ = other.max_;
+    return true;
+}
+
+void Histogram::Reset() {
+    std::fill(counts_.begin(), counts_.end(), 0);
+    total_count_ = 0;
+    sum_ = 0;
+    min_ = UINT64_MAX;
+    max_ = 0;
+}
+
+uint64_t Histogram::Percentile(double percentile) const {
+    if(total_count_ == 0) return 0;
+    if(percentile >= 100.0) return max_;
+
+    uint64_t target = (uint64_t)ceil(percentile / 100.0 * total_count_);
+    if(target == 0) target = 1;
+
+    uint64_t acc = 0;
+    for(size_t i = 0; i < counts_.size(); ++i) {
+        acc += counts_[i];
+        if(acc >= target) {
+            //超出上限的值都记在最后一个桶
+            if(i == counts_.size() - 1) return max_;
+            //取桶内最大等价值，不超过实际记录的最大值
+            uint64_t value = highestValueAt(i);
+            return value < max_ ? value : max_;
+        }
+    }
+    return max_;
+}
+
+}
+}
@@ -0,0 +1,53 @@
+#ifndef CWEB_UTIL_HISTOGRAM_H_
+#define CWEB_UTIL_HISTOGRAM_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <vector>
+
+namespace cweb {
+namespace util {
+
+/*
+ HDR风格的对数-线性直方图：
+ 小于 2^sub_bucket_bits 的值一一对应一个桶，更大的值按最高位分段，
+ 每段内再等分 2^(sub_bucket_bits-1) 个桶，相对误差约为 1/2^(sub_bucket_bits-1)
+ sub_bucket_bits = 5 时误差约6%(1/16)，单个直方图约4.8KB
+ */
+class Histogram {
+private:
+    int sub_bucket_bits_;
+    int max_value_bits_;
+    uint64_t sub_bucket_count_;
+    uint64_t sub_bucket_half_;
+    std::vector<uint64_t> counts_;
+    uint64_t total_count_ = 0;
+    uint64_t sum_ = 0;
+    uint64_t min_ = UINT64_MAX;
+    uint64_t max_ = 0;
+
+    size_t indexOf(uint64_t value) const;
+    uint64_t lowestValueAt(size_t index) const;
+    uint64_t highestValueAt(size_t index) const;
+
+public:
+    Histogram(int sub_bucket_bits = 5, int max_value_bits = 40);
+
+    void Record(uint64_t value, uint64_t count = 1);
+    //两个直方图精度必须一致
+    bool Merge(const Histogram& other);
+    void Reset();
+
+    uint64_t Count() const {return total_count_;}
+    uint64_t Sum() const {return sum_;}
+    uint64_t Min() const {return total_count_ ? min_ : 0;}
+    uint64_t Max() const {return max_;}
+    double Mean() const {return total_count_ ? (double)sum_ / total_count_ : 0.0;}
+    //percentile 取值 [0, 100]
+    uint64_t Percentile(double percentile) const;
+};
+
+}
+}
+
+#endif
@@ -19,8 +19,8 @@ private:
     int capacity_;
     
 public:
-    LockfreeQueue<T>(int capacity = 100) : capacity_(capacity), data_(std::vector<T>(capacity)){}
-    LockfreeQueue<T>(const LockfreeQueue<T>& queue) {
+    LockfreeQueue(int capacity = 100) : capacity_(capacity), data_(std::vector<T>(capacity)){}
+    LockfreeQueue(const LockfreeQueue<T>& queue) {
         capacity_ = queue.capacity_;
         data_ = queue.data_;
     }
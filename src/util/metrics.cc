@@ -0,0 +1,81 @@
+#include "metrics.h"
+#include "histogram.h"
+#include <stdio.h>
+
+namespace cweb {
+namespace util {
+
+void MetricsRegistry::Register(const std::string& name, Collector collector) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    collectors_[name] = std::move(collector);
+}
+
+void MetricsRegistry::Unregister(const std::string& name) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    collectors_.erase(name);
+}
+
+void MetricsRegistry::Render(std::string& out) {
+    std::map<std::string, Collector> collectors;
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        collectors = collectors_;
+    }
+
+    for(auto iter = collectors.begin(); iter != collectors.end(); ++iter) {
+        iter->second(out);
+    }
+}
+
+static void appendName(std::string& out, const std::string& name, const std::string& labels, const char* extra = nullptr) {
+    out += name;
+    if(labels.size() > 0 || extra) {
+        out += "{";
+        out += labels;
+        if(extra) {
+            if(labels.size() > 0) out += ",";
+            out += extra;
+        }
+        out += "}";
+    }
+}
+
+void MetricsRegistry::AppendCounter(std::string& out, const std::string& name, const std::string& labels, uint64_t value) {
+    appendName(out, name, labels);
+    out += " " + std::to_string(value) + "\n";
+}
+
+void MetricsRegistry::AppendGauge(std::string& out, const std::string& name, const std::string& labels, double value) {
+    char buf[32];
+    snprintf(buf, sizeof(buf), "%.3f", value);
+    appendName(out, name, labels);
+    out += " ";
+    out += buf;
+    out += "\n";
+}
+
+void MetricsRegistry::AppendSummary(std::string& out, const std::string& name, const std::string& labels, const Histogram& histogram) {
+    static const struct {
+        const char* label;
+        double percentile;
+    } quantiles[] = {
+        {"quantile=\"0.5\"", 50.0},
+        {"quantile=\"0.9\"", 90.0},
+        {"quantile=\"0.99\"", 99.0},
+        {"quantile=\"0.999\"", 99.9}
+    };
+
+    for(auto& q : quantiles) {
+        appendName(out, name, labels, q.label);
+        out += " " + std::to_string(histogram.Percentile(q.percentile)) + "\n";
+    }
+    appendName(out, name + "_max", labels);
+    out += " " + std::to_string(histogram.Max()) + "\n";
+    appendName(out, name + "_sum", labels);
+    out += " " + std::to_string(histogram.Sum()) + "\n";
+    appendName(out, name + "_count", labels);
+    out += " " + std::to_string(histogram.Count()) + "\n";
+}
+
+}
+}
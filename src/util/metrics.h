@@ -0,0 +1,40 @@
+#ifndef CWEB_UTIL_METRICS_H_
+#define CWEB_UTIL_METRICS_H_
+
+#include <string>
+#include <map>
+#include <mutex>
+#include <functional>
+#include "singleton.h"
+
+namespace cweb {
+namespace util {
+
+class Histogram;
+
+//指标注册中心，各模块注册采集函数，读取时统一以 Prometheus 文本格式输出
+class MetricsRegistry {
+public:
+    typedef std::function<void(std::string&)> Collector;
+
+    //同名采集函数会被覆盖
+    void Register(const std::string& name, Collector collector);
+    void Unregister(const std::string& name);
+    void Render(std::string& out);
+
+    static void AppendCounter(std::string& out, const std::string& name, const std::string& labels, uint64_t value);
+    static void AppendGauge(std::string& out, const std::string& name, const std::string& labels, double value);
+    //以 summary 形式输出 p50/p90/p99/p999 以及 count/sum/max
+    static void AppendSummary(std::string& out, const std::string& name, const std::string& labels, const Histogram& histogram);
+
+private:
+    std::mutex mutex_;
+    std::map<std::string, Collector> collectors_;
+};
+
+typedef cweb::util::Singleton<MetricsRegistry> MetricsRegistrySingleton;
+
+}
+}
+
+#endif
@@ -0,0 +1,80 @@
+#include "offload_pool.h"
+#include "metrics.h"
+
+namespace cweb {
+namespace util {
+
+// 在构造时注册，保证 MetricsRegistry 晚于本对象析构
+OffloadPool::OffloadPool() {
+    MetricsRegistrySingleton::GetInstance()->Register("offload_pool", [this](std::string& out){
+        MetricsRegistry::AppendGauge(out, "cweb_offload_pending", "", (double)Pending());
+        MetricsRegistry::AppendCounter(out, "cweb_offload_completed_total", "", Completed());
+        MetricsRegistry::AppendCounter(out, "cweb_offload_rejected_total", "", Rejected());
+    });
+}
+
+OffloadPool::~OffloadPool() {
+    MetricsRegistrySingleton::GetInstance()->Unregister("offload_pool");
+    Stop();
+}
+
+bool OffloadPool::Submit(Task task) {
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        if(stopping_ || tasks_.size() >= config_.queue_capacity) {
+            rejected_.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        if(!started_) start();
+        tasks_.push_back(std::move(task));
+    }
+    cond_.notify_one();
+    return true;
+}
+
+void OffloadPool::Stop() {
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        if(stopping_) return;
+        stopping_ = true;
+    }
+    cond_.notify_all();
+    for(std::thread& thread : threads_) {
+        thread.join();
+    }
+    threads_.clear();
+}
+
+size_t OffloadPool::Pending() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    return tasks_.size();
+}
+
+void OffloadPool::start() {
+    started_ = true;
+    size_t threads = config_.threads > 0 ? config_.threads : 1;
+    for(size_t i = 0; i < threads; ++i) {
+        threads_.emplace_back(&OffloadPool::workerLoop, this);
+    }
+}
+
+// 停止时先执行完队列中剩余的任务，等待这些任务的协程才能被唤醒
+void OffloadPool::workerLoop() {
+    while(true) {
+        Task task;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            while(!stopping_ && tasks_.empty()) {
+                cond_.wait(lock);
+            }
+            if(tasks_.empty()) return;
+            task = std::move(tasks_.front());
+            tasks_.pop_front();
+        }
+        task();
+        completed_.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+}
+}
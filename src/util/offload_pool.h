@@ -0,0 +1,56 @@
+#ifndef CWEB_UTIL_OFFLOADPOOL_H_
+#define CWEB_UTIL_OFFLOADPOOL_H_
+
+#include <deque>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <functional>
+#include <condition_variable>
+#include "singleton.h"
+#include "cweb_config.h"
+
+namespace cweb {
+namespace util {
+
+/*
+ 阻塞操作卸载线程池：文件读写、图片处理、第三方SDK等会阻塞线程的调用放到这里执行，不占用I/O线程
+ 线程数和队列长度都有上限，队列满时 Submit 返回false，由调用方自行执行
+ 工作线程不属于任何loop，其中的 read/write/sleep 等调用不会走协程 hook
+ */
+class OffloadPool : public Noncopyable {
+public:
+    typedef std::function<void()> Task;
+
+    OffloadPool();
+    ~OffloadPool();
+
+    bool Submit(Task task);
+    void Stop();
+    size_t Pending();
+    uint64_t Completed() const {return completed_.load(std::memory_order_relaxed);}
+    uint64_t Rejected() const {return rejected_.load(std::memory_order_relaxed);}
+
+private:
+    OffloadConfig config_;
+    std::mutex mutex_;
+    std::condition_variable cond_;
+    std::deque<Task> tasks_;
+    std::vector<std::thread> threads_;
+    bool started_ = false;
+    bool stopping_ = false;
+    std::atomic<uint64_t> completed_ = {0};
+    std::atomic<uint64_t> rejected_ = {0};
+
+    //需持有 mutex_，第一次提交任务时才创建线程
+    void start();
+    void workerLoop();
+};
+
+typedef cweb::util::Singleton<OffloadPool> OffloadPoolSingleton;
+
+}
+}
+
+#endif
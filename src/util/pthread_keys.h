@@ -12,10 +12,12 @@ public:
     pthread_key_t TLSEventLoop;
     pthread_key_t TLSMainCoroutine;
     pthread_key_t TLSMemoryPool;
+    pthread_key_t TLSTraceBuffer;
     PthreadKeys() {
         pthread_key_create(&TLSEventLoop, NULL);
         pthread_key_create(&TLSMainCoroutine, NULL);
         pthread_key_create(&TLSMemoryPool, NULL);
+        pthread_key_create(&TLSTraceBuffer, NULL);
     }
 };
 
@@ -0,0 +1,117 @@
+#include "trace.h"
+#include "pthread_keys.h"
+#include <time.h>
+#include <stdio.h>
+#include <algorithm>
+
+namespace cweb {
+namespace util {
+
+void TraceBuffer::Push(const char* name, uint64_t start_us, uint64_t dur_us, int64_t arg) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    TraceSpan& span = spans_[next_];
+    span.name = name;
+    span.start_us = start_us;
+    span.dur_us = dur_us;
+    span.arg = arg;
+    if(++next_ == spans_.size()) {
+        next_ = 0;
+        wrapped_ = true;
+    }
+}
+
+void TraceBuffer::CopyTo(std::vector<TraceSpan>& out) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    if(wrapped_) {
+        out.insert(out.end(), spans_.begin() + next_, spans_.end());
+    }
+    out.insert(out.end(), spans_.begin(), spans_.begin() + next_);
+}
+
+void TraceBuffer::Clear() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    next_ = 0;
+    wrapped_ = false;
+}
+
+Tracer::~Tracer() {
+    for(TraceBuffer* buffer : buffers_) {
+        delete buffer;
+    }
+}
+
+void Tracer::Enable(uint32_t sample_rate) {
+    sample_rate_.store(sample_rate == 0 ? 1 : sample_rate, std::memory_order_relaxed);
+    enabled_.store(true, std::memory_order_release);
+}
+
+void Tracer::Disable() {
+    enabled_.store(false, std::memory_order_release);
+}
+
+TraceBuffer* Tracer::localBuffer() {
+    TraceBuffer* buffer = (TraceBuffer*)pthread_getspecific(PthreadKeysSingleton::GetInstance()->TLSTraceBuffer);
+    if(buffer == nullptr) {
+        buffer = new TraceBuffer(buffer_capacity_, (uint64_t)pthread_self());
+        pthread_setspecific(PthreadKeysSingleton::GetInstance()->TLSTraceBuffer, buffer);
+        std::unique_lock<std::mutex> lock(mutex_);
+        buffers_.push_back(buffer);
+    }
+    return buffer;
+}
+
+//缓冲区在第一次 Record 时分配，没有被采样请求的线程不分配
+bool Tracer::Sample() {
+    if(!Enabled()) return false;
+    return sample_counter_.fetch_add(1, std::memory_order_relaxed) % sample_rate_.load(std::memory_order_relaxed) == 0;
+}
+
+void Tracer::Record(const char* name, uint64_t start_us, uint64_t dur_us, int64_t arg) {
+    localBuffer()->Push(name, start_us, dur_us, arg);
+}
+
+void Tracer::DumpChromeTrace(std::string& out) {
+    std::vector<TraceBuffer*> buffers;
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        buffers = buffers_;
+    }
+
+    out += "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+    bool first = true;
+    char line[256];
+    std::vector<TraceSpan> spans;
+    for(TraceBuffer* buffer : buffers) {
+        spans.clear();
+        buffer->CopyTo(spans);
+        for(const TraceSpan& span : spans) {
+            int n = 0;
+            if(span.arg >= 0) {
+                n = snprintf(line, sizeof(line), "%s{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%llu,\"ts\":%llu,\"dur\":%llu,\"args\":{\"index\":%lld}}",
+                             first ? "" : ",", span.name, (unsigned long long)buffer->tid, (unsigned long long)span.start_us, (unsigned long long)span.dur_us, (long long)span.arg);
+            }else {
+                n = snprintf(line, sizeof(line), "%s{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%llu,\"ts\":%llu,\"dur\":%llu}",
+                             first ? "" : ",", span.name, (unsigned long long)buffer->tid, (unsigned long long)span.start_us, (unsigned long long)span.dur_us);
+            }
+            out.append(line, std::min((size_t)n, sizeof(line) - 1));
+            first = false;
+        }
+    }
+    out += "]}";
+}
+
+void Tracer::Clear() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    for(TraceBuffer* buffer : buffers_) {
+        buffer->Clear();
+    }
+}
+
+uint64_t Tracer::NowMicros() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000 * 1000 + ts.tv_nsec / 1000;
+}
+
+}
+}
@@ -0,0 +1,103 @@
+#ifndef CWEB_UTIL_TRACE_H_
+#define CWEB_UTIL_TRACE_H_
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <mutex>
+#include <atomic>
+#include "singleton.h"
+
+namespace cweb {
+namespace util {
+
+struct TraceSpan {
+    const char* name = nullptr;     //只保存字面量指针，不拷贝
+    uint64_t start_us = 0;
+    uint64_t dur_us = 0;
+    int64_t arg = -1;
+};
+
+//每个线程一个环形缓冲区，写满后覆盖最旧的记录
+class TraceBuffer {
+private:
+    std::mutex mutex_;
+    std::vector<TraceSpan> spans_;
+    size_t next_ = 0;
+    bool wrapped_ = false;
+
+public:
+    const uint64_t tid;
+
+    TraceBuffer(size_t capacity, uint64_t tid) : spans_(capacity), tid(tid) {}
+    void Push(const char* name, uint64_t start_us, uint64_t dur_us, int64_t arg);
+    void CopyTo(std::vector<TraceSpan>& out);
+    void Clear();
+};
+
+/*
+ 轻量级请求追踪：
+ 关闭时每个埋点只有一次 relaxed 原子读；开启后按 1/sample_rate 对请求采样，
+ 只有被采样请求的埋点会写入线程本地环形缓冲区，可随时导出为 Chrome trace_event JSON
+ 采样结果由连接、请求、ByteData 携带，同一线程上交替执行的多个请求(协程)互不影响
+ */
+class Tracer {
+private:
+    std::atomic<bool> enabled_ = {false};
+    std::atomic<uint32_t> sample_rate_ = {1};
+    std::atomic<uint64_t> sample_counter_ = {0};
+    size_t buffer_capacity_ = 16384;
+    std::mutex mutex_;
+    std::vector<TraceBuffer*> buffers_;
+
+    TraceBuffer* localBuffer();
+
+public:
+    ~Tracer();
+
+    void Enable(uint32_t sample_rate = 1);
+    void Disable();
+    bool Enabled() const {return enabled_.load(std::memory_order_relaxed);}
+
+    //请求(或accept)开始时调用，返回是否采样，由调用方保存并传给之后的埋点
+    bool Sample();
+    void Record(const char* name, uint64_t start_us, uint64_t dur_us, int64_t arg = -1);
+
+    void DumpChromeTrace(std::string& out);
+    void Clear();
+
+    static uint64_t NowMicros();
+};
+
+typedef cweb::util::Singleton<Tracer> TracerSingleton;
+
+class TraceScope {
+private:
+    const char* name_;
+    int64_t arg_;
+    uint64_t start_us_ = 0;
+
+public:
+    TraceScope(bool sampled, const char* name, int64_t arg = -1) : name_(name), arg_(arg) {
+        if(sampled && TracerSingleton::GetInstance()->Enabled()) {
+            start_us_ = Tracer::NowMicros();
+        }
+    }
+
+    ~TraceScope() {
+        if(start_us_ > 0) {
+            TracerSingleton::GetInstance()->Record(name_, start_us_, Tracer::NowMicros() - start_us_, arg_);
+        }
+    }
+};
+
+#define CWEB_TRACE_CONCAT_INNER(a, b) a##b
+#define CWEB_TRACE_CONCAT(a, b) CWEB_TRACE_CONCAT_INNER(a, b)
+//作用域埋点，sampled 为所属请求的采样结果，name 必须为字符串字面量
+#define TRACE_SCOPE(sampled, name, ...) \
+    cweb::util::TraceScope CWEB_TRACE_CONCAT(trace_scope_, __LINE__)(sampled, name, ##__VA_ARGS__)
+
+}
+}
+
+#endif
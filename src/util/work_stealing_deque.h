@@ -0,0 +1,102 @@
+#ifndef CWEB_UTIL_WORKSTEALINGDEQUE_H_
+#define CWEB_UTIL_WORKSTEALINGDEQUE_H_
+
+#include <stdint.h>
+#include <atomic>
+#include <memory>
+
+namespace cweb {
+
+namespace util {
+
+/*
+ 定长 Chase-Lev 工作窃取双端队列，只存放指针
+ Push/Pop 只能由所属线程调用(后进先出，缓存更热)，Steal 可由任意线程调用(从另一端先进先出)
+ */
+template <typename T>
+class WorkStealingDeque {
+
+private:
+    std::unique_ptr<std::atomic<T*>[]> buffer_;
+    int64_t capacity_;
+    int64_t mask_;
+    std::atomic<int64_t> top_ = {0};
+    std::atomic<int64_t> bottom_ = {0};
+
+    static int64_t roundCapacity(int64_t capacity) {
+        int64_t res = 2;
+        while(res < capacity) res <<= 1;
+        return res;
+    }
+
+public:
+    WorkStealingDeque(int64_t capacity = 1024)
+    : capacity_(roundCapacity(capacity)), mask_(roundCapacity(capacity) - 1) {
+        buffer_.reset(new std::atomic<T*>[capacity_]);
+        for(int64_t i = 0; i < capacity_; ++i) {
+            buffer_[i].store(nullptr, std::memory_order_relaxed);
+        }
+    }
+
+    //队列已满时返回false
+    bool Push(T* val) {
+        int64_t bottom = bottom_.load(std::memory_order_relaxed);
+        int64_t top = top_.load(std::memory_order_acquire);
+        if(bottom - top >= capacity_) return false;
+
+        buffer_[bottom & mask_].store(val, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        bottom_.store(bottom + 1, std::memory_order_relaxed);
+        return true;
+    }
+
+    T* Pop() {
+        int64_t bottom = bottom_.load(std::memory_order_relaxed) - 1;
+        bottom_.store(bottom, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        int64_t top = top_.load(std::memory_order_relaxed);
+
+        if(top > bottom) {
+            //空队列
+            bottom_.store(bottom + 1, std::memory_order_relaxed);
+            return nullptr;
+        }
+
+        T* val = buffer_[bottom & mask_].load(std::memory_order_relaxed);
+        if(top == bottom) {
+            //只剩最后一个元素，与窃取者竞争
+            if(!top_.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+                val = nullptr;
+            }
+            bottom_.store(bottom + 1, std::memory_order_relaxed);
+        }
+        return val;
+    }
+
+    T* Steal() {
+        int64_t top = top_.load(std::memory_order_acquire);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        int64_t bottom = bottom_.load(std::memory_order_acquire);
+        if(top >= bottom) return nullptr;
+
+        T* val = buffer_[top & mask_].load(std::memory_order_relaxed);
+        if(!top_.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+            //被其他窃取者或所属线程抢先
+            return nullptr;
+        }
+        return val;
+    }
+
+    //近似值，仅用于统计
+    int64_t Size() const {
+        int64_t size = bottom_.load(std::memory_order_relaxed) - top_.load(std::memory_order_relaxed);
+        return size > 0 ? size : 0;
+    }
+
+    bool Empty() const {return Size() == 0;}
+};
+
+}
+}
+
+#endif
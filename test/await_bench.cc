@@ -0,0 +1,152 @@
+#include <iostream>
+#include <vector>
+#include <chrono>
+#include <string.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+#include "coroutine_context.h"
+#include "coroutine_stack.h"
+#include "await.h"
+
+/*
+ C++20 无栈协程与汇编有栈协程的对比：
+ N 个"连接"各自在挂起点保留 frame 字节的局部状态后挂起，主循环轮流恢复，统计单次恢复+挂起的耗时与每个连接的内存
+ 编译: g++ -std=c++20 -O2 -DCWEB_CO_AWAIT (需要 coroutine_context.cc coroutine_stack.cc context_swap.s)
+ 用法: await_bench [连接数] [轮数] [挂起时保留的局部状态字节]
+ */
+
+using namespace cweb::tcpserver::coroutine;
+using namespace cweb::tcpserver::await;
+
+#ifdef __APPLE__
+typedef char mincore_vec_t;
+#else
+typedef unsigned char mincore_vec_t;
+#endif
+
+static size_t frame_bytes = 1024;
+
+//有栈协程
+struct StackfulConnection {
+    CoroutineContext context;
+    CoroutineStack* stack = nullptr;
+};
+
+static CoroutineContext main_context;
+
+static void stackfulFunc(void* vp) {
+    StackfulConnection* conn = (StackfulConnection*)vp;
+    char* state = (char*)alloca(frame_bytes);
+    memset(state, 1, frame_bytes);
+    while(true) {
+        CoroutineContext::ContextSwap(&conn->context, &main_context);
+        state[0]++;
+    }
+}
+
+static size_t residentBytes(const CoroutineStack* stack) {
+    size_t pagesize = StackPool::PageSize();
+    size_t pages = stack->size / pagesize;
+    std::vector<mincore_vec_t> vec(pages);
+    if(mincore(stack->Bottom(), stack->size, vec.data()) != 0) return 0;
+    size_t resident = 0;
+    for(size_t i = 0; i < pages; ++i) {
+        if(vec[i] & 1) resident += pagesize;
+    }
+    return resident;
+}
+
+static void runStackful(size_t count, size_t rounds) {
+    StackPool pool(0);
+    std::vector<StackfulConnection*> conns;
+    for(size_t i = 0; i < count; ++i) {
+        StackfulConnection* conn = new StackfulConnection();
+        conn->stack = pool.Allocate(256 * 1024);
+        conn->context.Init(conn->stack->Bottom(), conn->stack->size, stackfulFunc, conn);
+        CoroutineContext::ContextSwap(&main_context, &conn->context);
+        conns.push_back(conn);
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    for(size_t r = 0; r < rounds; ++r) {
+        for(StackfulConnection* conn : conns) {
+            CoroutineContext::ContextSwap(&main_context, &conn->context);
+        }
+    }
+    auto end = std::chrono::steady_clock::now();
+    double ns = std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count();
+
+    size_t memory = 0;
+    for(StackfulConnection* conn : conns) {
+        memory += residentBytes(conn->stack) + sizeof(StackfulConnection);
+    }
+    std::cout << "stackful   switch: " << ns / (count * rounds) << " ns"
+              << "  memory per connection: " << memory / count << " bytes" << std::endl;
+
+    for(StackfulConnection* conn : conns) {
+        StackPool::UnmapStack(conn->stack);
+        delete conn;
+    }
+}
+
+//无栈协程，挂起时把句柄交给主循环
+struct Park {
+    std::coroutine_handle<>* slot;
+
+    bool await_ready() const noexcept {return false;}
+    void await_suspend(std::coroutine_handle<> handle) noexcept {*slot = handle;}
+    void await_resume() noexcept {}
+};
+
+template <size_t N>
+static Task<void> stacklessFunc(std::coroutine_handle<>* slot) {
+    //跨挂起点存活的局部变量才会放进协程帧
+    char state[N];
+    memset(state, 1, N);
+    while(true) {
+        co_await Park{slot};
+        state[0]++;
+    }
+}
+
+static Task<void> makeStackless(std::coroutine_handle<>* slot) {
+    if(frame_bytes <= 64) return stacklessFunc<64>(slot);
+    if(frame_bytes <= 1024) return stacklessFunc<1024>(slot);
+    return stacklessFunc<8192>(slot);
+}
+
+static void runStackless(size_t count, size_t rounds) {
+    std::vector<std::coroutine_handle<>> slots(count);
+    std::vector<Task<void>> tasks;
+    tasks.reserve(count);
+    uint64_t before = FrameStats::live_bytes.load();
+    for(size_t i = 0; i < count; ++i) {
+        tasks.push_back(makeStackless(&slots[i]));
+        //惰性启动，第一次恢复后停在 Park
+        tasks.back().await_suspend(std::noop_coroutine()).resume();
+    }
+    uint64_t frames = FrameStats::live_bytes.load() - before;
+
+    auto start = std::chrono::steady_clock::now();
+    for(size_t r = 0; r < rounds; ++r) {
+        for(size_t i = 0; i < count; ++i) {
+            slots[i].resume();
+        }
+    }
+    auto end = std::chrono::steady_clock::now();
+    double ns = std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count();
+
+    std::cout << "stackless  switch: " << ns / (count * rounds) << " ns"
+              << "  memory per connection: " << frames / count << " bytes" << std::endl;
+}
+
+int main(int argc, char** argv) {
+    size_t count = argc > 1 ? strtoul(argv[1], NULL, 10) : 10000;
+    size_t rounds = argc > 2 ? strtoul(argv[2], NULL, 10) : 100;
+    frame_bytes = argc > 3 ? strtoul(argv[3], NULL, 10) : 1024;
+
+    std::cout << "connections: " << count << " rounds: " << rounds << " frame: " << frame_bytes << " bytes" << std::endl;
+    runStackful(count, rounds);
+    runStackless(count, rounds);
+    return 0;
+}
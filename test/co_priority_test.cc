@@ -0,0 +1,149 @@
+#include <iostream>
+#include <string>
+#include <atomic>
+#include <thread>
+#include <set>
+#include <mutex>
+#include <vector>
+#include <assert.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include "co_eventloop.h"
+#include "co_eventloop_thread.h"
+#include "co_sync.h"
+#include "coroutine.h"
+#include "histogram.h"
+#include "timer.h"
+
+using namespace cweb::tcpserver;
+using namespace cweb::tcpserver::coroutine;
+
+static uint64_t nowUs() {
+    return Time::Now().MicroSecondsSinceEpoch();
+}
+
+int main() {
+    CoEventLoopThread thread;
+    std::shared_ptr<CoEventLoop> loop = std::dynamic_pointer_cast<CoEventLoop>(thread.StartLoop());
+
+    //同优先级的协程 Yield 后轮流执行
+    {
+        WaitGroup wg;
+        std::string order;
+        wg.Add(2);
+        loop->AddInlineTask([&](){
+            for(char name : std::string("ab")) {
+                loop->AddTaskWithPriority([&, name](){
+                    for(int i = 0; i < 3; ++i) {
+                        order += name;
+                        Coroutine::Yield();
+                    }
+                    wg.Done();
+                }, Coroutine::HANDLER);
+            }
+        });
+        wg.Wait();
+        std::cout << "yield order: " << order << std::endl;
+        assert(order == "ababab");
+    }
+
+    //不挂起只 Yield 的后台计算任务不影响读写协程的响应
+    int sv[2];
+    assert(::socketpair(AF_UNIX, SOCK_STREAM, 0, sv) == 0);
+    WaitGroup wg;
+    std::atomic<bool> stop(false);
+    std::atomic<uint64_t> sent_us(0);
+    uint64_t max_latency_us = 0;
+    wg.Add(2);
+
+    loop->AddTaskWithPriority([&](){
+        while(!stop) {
+            uint64_t start = nowUs();
+            while(nowUs() - start < 200) {}
+            Coroutine::Yield();
+        }
+        wg.Done();
+    }, Coroutine::BACKGROUND);
+
+    loop->AddTask([&](){
+        char c;
+        for(int i = 0; i < 20; ++i) {
+            assert(recv(sv[0], &c, 1, 0) == 1);
+            uint64_t latency = nowUs() - sent_us;
+            if(latency > max_latency_us) max_latency_us = latency;
+        }
+        wg.Done();
+    });
+
+    std::thread sender([&](){
+        for(int i = 0; i < 20; ++i) {
+            ::usleep(5000);
+            sent_us = nowUs();
+            ::send(sv[1], "x", 1, 0);
+        }
+        stop = true;
+    });
+
+    wg.Wait();
+    sender.join();
+    std::cout << "max wakeup latency under cpu load: " << max_latency_us << "us" << std::endl;
+    assert(max_latency_us < 5000);
+
+    //统计由loop定期合并，最多延迟100ms
+    usleep(150000);
+    cweb::util::Histogram io_wait;
+    loop->QueueWaitSnapshot(Coroutine::IO, io_wait);
+    std::cout << "resumes: " << loop->Resumes() << " yields: " << loop->Yields()
+              << " budget exhausted: " << loop->BudgetExhausted()
+              << " io queue wait p99: " << io_wait.Percentile(99) << "us" << std::endl;
+    assert(loop->Yields() > 0 && loop->BudgetExhausted() > 0 && io_wait.Count() >= 20);
+
+    //一个loop上产生的计算任务由空闲的loop窃取并行执行
+    {
+        std::vector<std::unique_ptr<CoEventLoopThread>> threads;
+        std::vector<std::shared_ptr<CoEventLoop>> loops;
+        std::vector<CoEventLoop*> peers;
+        for(int i = 0; i < 4; ++i) {
+            threads.emplace_back(new CoEventLoopThread());
+            loops.push_back(std::dynamic_pointer_cast<CoEventLoop>(threads.back()->StartLoop()));
+            peers.push_back(loops.back().get());
+        }
+        for(CoEventLoop* peer : peers) {
+            peer->SetStealPeers(peers);
+        }
+
+        const int tasks = 64;
+        WaitGroup wg;
+        std::mutex mutex;
+        std::set<std::thread::id> workers;
+        wg.Add(tasks);
+        uint64_t start = nowUs();
+        loops[0]->AddInlineTask([&](){
+            for(int i = 0; i < tasks; ++i) {
+                loops[0]->AddStealableTask([&](){
+                    uint64_t end = nowUs() + 2000;
+                    while(nowUs() < end);
+                    {
+                        std::unique_lock<std::mutex> lock(mutex);
+                        workers.insert(std::this_thread::get_id());
+                    }
+                    wg.Done();
+                });
+            }
+        });
+        wg.Wait();
+        uint64_t elapsed = nowUs() - start;
+
+        uint64_t steals = 0;
+        for(CoEventLoop* peer : peers) {
+            steals += peer->Steals();
+        }
+        std::cout << "stealable tasks: " << loops[0]->StealableTasks() << " steals: " << steals
+                  << " workers: " << workers.size() << " elapsed: " << elapsed << "us" << std::endl;
+        assert(loops[0]->StealableTasks() == (uint64_t)tasks);
+        assert(steals > 0 && workers.size() > 1);
+    }
+
+    std::cout << "co priority test passed" << std::endl;
+    _exit(0);
+}
@@ -0,0 +1,88 @@
+#include <iostream>
+#include <atomic>
+#include <assert.h>
+#include <unistd.h>
+#include "co_eventloop.h"
+#include "co_eventloop_thread.h"
+#include "co_sync.h"
+
+using namespace cweb::tcpserver::coroutine;
+
+static const int kMessages = 100000;
+
+int main() {
+    CoEventLoopThread thread1, thread2;
+    std::shared_ptr<CoEventLoop> loop1 = std::dynamic_pointer_cast<CoEventLoop>(thread1.StartLoop());
+    std::shared_ptr<CoEventLoop> loop2 = std::dynamic_pointer_cast<CoEventLoop>(thread2.StartLoop());
+
+    //跨loop的通道：生产者满时挂起，消费者空时挂起
+    {
+        Channel<int> channel(4);
+        WaitGroup wg;
+        int64_t sum = 0;
+        wg.Add(2);
+        loop1->AddTask([&](){
+            for(int i = 1; i <= kMessages; ++i) {
+                channel.Push(i);
+            }
+            channel.Close();
+            wg.Done();
+        });
+        loop2->AddTask([&](){
+            int val;
+            while(channel.Pop(val)) {
+                sum += val;
+            }
+            wg.Done();
+        });
+        //非loop线程中等待，阻塞线程
+        wg.Wait();
+        assert(sum == (int64_t)kMessages * (kMessages + 1) / 2);
+        std::cout << "channel sum: " << sum << std::endl;
+    }
+
+    //CoMutex + CoCondition 实现的资源池：持有资源的协程挂起时，同一loop的其他协程继续运行
+    {
+        CoMutex mutex;
+        CoCondition cond;
+        int available = 2;
+        int max_in_use = 0;
+        int in_use = 0;
+        Channel<int> gate(64);
+        WaitGroup wg;
+        const int workers = 32;
+        wg.Add(workers);
+        for(int i = 0; i < workers; ++i) {
+            std::shared_ptr<CoEventLoop> loop = i % 2 ? loop1 : loop2;
+            loop->AddTask([&](){
+                {
+                    std::unique_lock<CoMutex> lock(mutex);
+                    cond.wait(lock, [&](){return available > 0;});
+                    --available;
+                    ++in_use;
+                    max_in_use = std::max(max_in_use, in_use);
+                }
+                int token;
+                gate.Pop(token);
+                {
+                    std::unique_lock<CoMutex> lock(mutex);
+                    ++available;
+                    --in_use;
+                    cond.notify_one();
+                }
+                wg.Done();
+            });
+        }
+        for(int i = 0; i < workers; ++i) {
+            usleep(1000);
+            gate.Push(i);
+        }
+        wg.Wait();
+        assert(max_in_use <= 2);
+        assert(available == 2);
+        std::cout << "pool max in use: " << max_in_use << std::endl;
+    }
+
+    std::cout << "co sync test passed" << std::endl;
+    _exit(0);
+}
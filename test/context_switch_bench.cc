@@ -0,0 +1,83 @@
+#include <iostream>
+#include <chrono>
+#include <stdlib.h>
+#include <unistd.h>
+#include "coroutine_context.h"
+#include "coroutine_stack.h"
+#include "coroutine.h"
+#include "co_eventloop.h"
+#include "co_eventloop_thread.h"
+#include "co_sync.h"
+
+/*
+ 上下文切换开销：
+ 1. 裸 context_swap 两个上下文来回切换
+ 2. 完整调度往返：协程 Yield 切回主协程，loop 重新排队后再切入
+ 用法: context_switch_bench [切换次数] [协程数]
+ */
+
+using namespace cweb::tcpserver;
+using namespace cweb::tcpserver::coroutine;
+
+static CoroutineContext main_context;
+static CoroutineContext bench_context;
+
+static void pingFunc(void*) {
+    while(true) {
+        CoroutineContext::ContextSwap(&bench_context, &main_context);
+    }
+}
+
+static double elapsedNs(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+}
+
+static void runRawSwap(size_t rounds) {
+    CoroutineStack* stack = StackPool::MapStack(64 * 1024);
+    bench_context.Init(stack->Bottom(), stack->size, pingFunc, nullptr);
+    CoroutineContext::ContextSwap(&main_context, &bench_context);
+
+    auto start = std::chrono::steady_clock::now();
+    for(size_t i = 0; i < rounds; ++i) {
+        CoroutineContext::ContextSwap(&main_context, &bench_context);
+    }
+    double ns = elapsedNs(start);
+    //每轮切入切出各一次
+    std::cout << "raw context_swap:     " << ns / (rounds * 2) << " ns/switch" << std::endl;
+    StackPool::UnmapStack(stack);
+}
+
+static void runScheduler(size_t rounds, size_t count) {
+    CoEventLoopThread thread;
+    std::shared_ptr<CoEventLoop> loop = std::dynamic_pointer_cast<CoEventLoop>(thread.StartLoop());
+    size_t yields = rounds / count;
+
+    WaitGroup wg;
+    wg.Add((int)count);
+    std::chrono::steady_clock::time_point start;
+    loop->AddInlineTask([&](){
+        start = std::chrono::steady_clock::now();
+        for(size_t i = 0; i < count; ++i) {
+            loop->AddTaskWithPriority([&](){
+                for(size_t j = 0; j < yields; ++j) {
+                    Coroutine::Yield();
+                }
+                wg.Done();
+            }, Coroutine::HANDLER);
+        }
+    });
+    wg.Wait();
+    double ns = elapsedNs(start);
+    //每次 Yield 包含切出、重新排队、切入
+    std::cout << "scheduler round trip: " << ns / (yields * count) << " ns/yield"
+              << " (" << count << " coroutines, resumes " << loop->Resumes() << ")" << std::endl;
+}
+
+int main(int argc, char** argv) {
+    size_t rounds = argc > 1 ? strtoul(argv[1], NULL, 10) : 10000000;
+    size_t count = argc > 2 ? strtoul(argv[2], NULL, 10) : 100;
+
+    runRawSwap(rounds);
+    runScheduler(rounds, count);
+    _exit(0);
+}
@@ -0,0 +1,140 @@
+#include <iostream>
+#include <vector>
+#include <chrono>
+#include <string.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+#include "coroutine_context.h"
+#include "coroutine_stack.h"
+
+/*
+ 独立栈(栈池)与共享栈两种模式的对比：
+ N 个协程各自占用一段栈后挂起，主协程轮流切入切出，统计单次往返切换耗时与挂起协程占用的内存
+ 用法: coroutine_stack_bench [协程数] [轮数] [每个协程的栈使用字节]
+ */
+
+using namespace cweb::tcpserver::coroutine;
+
+#ifdef __APPLE__
+typedef char mincore_vec_t;
+#else
+typedef unsigned char mincore_vec_t;
+#endif
+
+struct BenchCoroutine {
+    CoroutineContext context;
+    CoroutineStack* stack = nullptr;
+    SharedStack* shared = nullptr;
+    StackSnapshot snapshot;
+    bool started = false;
+};
+
+static CoroutineContext main_context;
+static size_t frame_bytes = 1024;
+
+static void coroutineFunc(void* vp) {
+    BenchCoroutine* co = (BenchCoroutine*)vp;
+    //模拟请求处理过程中挂起时的栈深度
+    char* frame = (char*)alloca(frame_bytes);
+    memset(frame, 1, frame_bytes);
+    while(true) {
+        CoroutineContext::ContextSwap(&co->context, &main_context);
+        frame[0]++;
+    }
+}
+
+static void swapIn(BenchCoroutine* co) {
+    if(co->shared) {
+        BenchCoroutine* occupant = (BenchCoroutine*)co->shared->occupant;
+        if(occupant != co) {
+            if(occupant) {
+                occupant->snapshot.Save(co->shared->stack, occupant->context.StackPointer());
+            }
+            co->shared->occupant = co;
+            if(co->started) co->snapshot.Restore(co->shared->stack);
+        }
+    }
+    if(!co->started) {
+        CoroutineStack* stack = co->shared ? co->shared->stack : co->stack;
+        co->context.Init(stack->Bottom(), stack->size, coroutineFunc, co);
+        co->started = true;
+    }
+    CoroutineContext::ContextSwap(&main_context, &co->context);
+}
+
+static size_t residentBytes(const CoroutineStack* stack) {
+    size_t pagesize = StackPool::PageSize();
+    size_t pages = stack->size / pagesize;
+    std::vector<mincore_vec_t> vec(pages);
+    if(mincore(stack->Bottom(), stack->size, vec.data()) != 0) return 0;
+    size_t resident = 0;
+    for(size_t i = 0; i < pages; ++i) {
+        if(vec[i] & 1) resident += pagesize;
+    }
+    return resident;
+}
+
+static void run(bool shared_mode, size_t count, size_t rounds, size_t stack_size) {
+    StackPool pool(0);
+    if(shared_mode) pool.EnableSharedStacks(4, stack_size);
+    
+    std::vector<BenchCoroutine*> coroutines;
+    for(size_t i = 0; i < count; ++i) {
+        BenchCoroutine* co = new BenchCoroutine();
+        if(shared_mode) {
+            co->shared = pool.NextSharedStack();
+        }else {
+            co->stack = pool.Allocate(stack_size);
+        }
+        coroutines.push_back(co);
+        swapIn(co);
+    }
+    
+    auto start = std::chrono::steady_clock::now();
+    for(size_t r = 0; r < rounds; ++r) {
+        for(BenchCoroutine* co : coroutines) {
+            swapIn(co);
+        }
+    }
+    auto end = std::chrono::steady_clock::now();
+    double ns = std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count();
+    
+    size_t memory = 0;
+    std::vector<const CoroutineStack*> counted;
+    for(BenchCoroutine* co : coroutines) {
+        if(shared_mode) {
+            memory += co->snapshot.Capacity();
+            bool seen = false;
+            for(const CoroutineStack* s : counted) seen = seen || s == co->shared->stack;
+            if(!seen) {
+                counted.push_back(co->shared->stack);
+                memory += residentBytes(co->shared->stack);
+            }
+        }else {
+            memory += residentBytes(co->stack);
+        }
+    }
+    
+    std::cout << (shared_mode ? "shared stack" : "pooled stack")
+              << "  switch: " << ns / (count * rounds) << " ns"
+              << "  memory per coroutine: " << memory / count << " bytes"
+              << "  total: " << memory / 1024 << " KB" << std::endl;
+    
+    //协程不会结束，直接释放栈即可
+    for(BenchCoroutine* co : coroutines) {
+        StackPool::UnmapStack(co->stack);
+        delete co;
+    }
+}
+
+int main(int argc, char** argv) {
+    size_t count = argc > 1 ? strtoul(argv[1], NULL, 10) : 10000;
+    size_t rounds = argc > 2 ? strtoul(argv[2], NULL, 10) : 100;
+    frame_bytes = argc > 3 ? strtoul(argv[3], NULL, 10) : 1024;
+    size_t stack_size = 256 * 1024;
+    
+    std::cout << "coroutines: " << count << " rounds: " << rounds << " frame: " << frame_bytes << " bytes" << std::endl;
+    run(false, count, rounds, stack_size);
+    run(true, count, rounds, stack_size);
+    return 0;
+}
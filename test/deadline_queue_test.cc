@@ -0,0 +1,53 @@
+#include <iostream>
+#include <vector>
+#include <algorithm>
+#include <assert.h>
+#include <stdlib.h>
+#include "co_deadline.h"
+
+using namespace cweb::tcpserver::coroutine;
+
+int main() {
+    const int n = 1000;
+    std::vector<Deadline> nodes(n);
+    DeadlineQueue queue(16);
+    srand(1);
+    for(int i = 0; i < n; ++i) {
+        nodes[i].expire_us = rand() % 100000;
+        queue.Add(&nodes[i]);
+    }
+    assert(queue.Size() == n);
+
+    //提前唤醒的节点从中间删除
+    for(int i = 0; i < n; i += 3) {
+        queue.Remove(&nodes[i]);
+        assert(!nodes[i].Queued());
+    }
+    //重复删除无影响
+    queue.Remove(&nodes[0]);
+
+    uint64_t last = 0;
+    size_t popped = 0;
+    assert(queue.NextTimeoutMs(0) >= 0);
+    Deadline* deadline = nullptr;
+    while((deadline = queue.PopExpired(UINT64_MAX))) {
+        assert(deadline->expire_us >= last);
+        assert(!deadline->Queued());
+        last = deadline->expire_us;
+        ++popped;
+    }
+    assert(popped == n - (n + 2) / 3);
+    assert(queue.Empty());
+    assert(queue.NextTimeoutMs(0) == -1);
+
+    //未到期不弹出，超时向上取整到毫秒
+    Deadline one;
+    one.expire_us = 10500;
+    queue.Add(&one);
+    assert(queue.PopExpired(10000) == nullptr);
+    assert(queue.NextTimeoutMs(10000) == 1);
+    assert(queue.PopExpired(10500) == &one);
+
+    std::cout << "deadline queue test passed" << std::endl;
+    return 0;
+}
@@ -0,0 +1,45 @@
+#include <iostream>
+#include <assert.h>
+#include "histogram.h"
+
+using namespace cweb::util;
+
+int main() {
+    Histogram h;
+    for(uint64_t i = 1; i <= 10000; ++i) {
+        h.Record(i);
+    }
+
+    assert(h.Count() == 10000);
+    assert(h.Min() == 1);
+    assert(h.Max() == 10000);
+
+    //5位子桶精度约为 1/16
+    uint64_t p50 = h.Percentile(50);
+    uint64_t p99 = h.Percentile(99);
+    std::cout << "p50: " << p50 << " p99: " << p99 << " p100: " << h.Percentile(100) << std::endl;
+    assert(p50 >= 5000 && p50 <= 5000 * 17 / 16);
+    assert(p99 >= 9900 && p99 <= 10000);
+
+    //小值精确
+    Histogram small;
+    small.Record(3, 10);
+    small.Record(7, 10);
+    assert(small.Percentile(50) == 3);
+    assert(small.Percentile(51) == 7);
+
+    //合并
+    Histogram other;
+    other.Record(1ULL << 35);
+    assert(h.Merge(other));
+    assert(h.Count() == 10001);
+    assert(h.Max() == (1ULL << 35));
+
+    //超过上限的值落入最后一个桶
+    Histogram big;
+    big.Record(UINT64_MAX / 2);
+    assert(big.Percentile(50) == UINT64_MAX / 2);
+
+    std::cout << "histogram test passed" << std::endl;
+    return 0;
+}
@@ -0,0 +1,94 @@
+#include <iostream>
+#include <atomic>
+#include <assert.h>
+#include <poll.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include "co_eventloop.h"
+#include "co_eventloop_thread.h"
+#include "co_sync.h"
+#include "timer.h"
+#include "histogram.h"
+
+using namespace cweb::tcpserver;
+using namespace cweb::tcpserver::coroutine;
+
+static uint64_t nowMs() {
+    return Time::Now().MicroSecondsSinceEpoch() / 1000;
+}
+
+int main() {
+    CoEventLoopThread thread;
+    std::shared_ptr<CoEventLoop> loop = std::dynamic_pointer_cast<CoEventLoop>(thread.StartLoop());
+
+    int sv[2];
+    assert(::socketpair(AF_UNIX, SOCK_STREAM, 0, sv) == 0);
+
+    WaitGroup wg;
+    std::atomic<int> ticks(0);
+    wg.Add(3);
+
+    //阻塞语义的客户端fd：recv 挂起协程，SO_RCVTIMEO 超时返回 EAGAIN
+    loop->AddTask([&](){
+        struct timeval tv = {0, 50000};
+        setsockopt(sv[0], SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+        char buf[16];
+        uint64_t start = nowMs();
+        ssize_t n = recv(sv[0], buf, sizeof(buf), 0);
+        std::cout << "recv timeout: " << nowMs() - start << "ms" << std::endl;
+        assert(n == -1 && errno == EAGAIN);
+        //用户视角仍是阻塞fd
+        assert(!(fcntl(sv[0], F_GETFL) & O_NONBLOCK));
+
+        n = recv(sv[0], buf, sizeof(buf), 0);
+        //等待期间同一loop的其他协程继续运行
+        assert(n == 5 && ticks > 0);
+
+        struct pollfd pfd = {sv[0], POLLIN, 0};
+        start = nowMs();
+        assert(poll(&pfd, 1, 30) == 0);
+        std::cout << "poll timeout: " << nowMs() - start << "ms" << std::endl;
+        wg.Done();
+    });
+
+    loop->AddTask([&](){
+        for(int i = 0; i < 10; ++i) {
+            usleep(10000);
+            ++ticks;
+        }
+        wg.Done();
+    });
+
+    loop->AddTask([&](){
+        usleep(80000);
+        send(sv[1], "hello", 5, 0);
+        wg.Done();
+    });
+
+    wg.Wait();
+
+    //挂起协程按等待原因输出，挂起时长计入直方图
+    wg.Add(1);
+    loop->AddTask([&](){
+        char buf[16];
+        recv(sv[0], buf, sizeof(buf), 0);
+        wg.Done();
+    });
+    usleep(20000);
+    std::string dump;
+    CoEventLoop::DumpAllHoldCoroutines(dump);
+    std::cout << dump;
+    assert(dump.find("[read] 1") != std::string::npos && loop->HeldCoroutines() == 1);
+    send(sv[1], "x", 1, 0);
+    wg.Wait();
+
+    usleep(150000);
+    cweb::util::Histogram sleep_hold;
+    loop->HoldTimeSnapshot(Coroutine::WAIT_SLEEP, sleep_hold);
+    std::cout << "sleep holds: " << sleep_hold.Count() << " p50: " << sleep_hold.Percentile(50) << "us" << std::endl;
+    assert(sleep_hold.Count() == 11 && sleep_hold.Percentile(50) >= 9000);
+    std::cout << "hooks test passed" << std::endl;
+    _exit(0);
+}
@@ -0,0 +1,33 @@
+#include <iostream>
+#include <string>
+#include <algorithm>
+#include <assert.h>
+#include <string.h>
+#include "http_header.h"
+
+using namespace cweb;
+
+int main() {
+    //表中的每个 header 都能按任意大小写找到自己
+    for(int i = 0; i < kHttpHeaderCount; ++i) {
+        HttpHeader header = (HttpHeader)i;
+        std::string name = HttpHeaderName(header);
+        assert(LookupHttpHeader(name.data(), name.size()) == header);
+        std::string lower = name;
+        std::transform(lower.begin(), lower.end(), lower.begin(), ::tolower);
+        assert(LookupHttpHeader(lower.data(), lower.size()) == header);
+        std::string upper = name;
+        std::transform(upper.begin(), upper.end(), upper.begin(), ::toupper);
+        assert(LookupHttpHeader(upper.data(), upper.size()) == header);
+    }
+
+    const char* unknowns[] = {"", "X", "X-Custom", "Content-Typo", "Hosts", "Sec-WebSocket-Kex", "connection "};
+    for(const char* name : unknowns) {
+        assert(LookupHttpHeader(name, strlen(name)) == HeaderUnknown);
+    }
+    assert(LookupHttpHeader("connection", 10) == HeaderConnection);
+    assert(strcmp(HttpHeaderName(HeaderUnknown), "") == 0);
+
+    std::cout << kHttpHeaderCount << " headers, http header test passed" << std::endl;
+    return 0;
+}
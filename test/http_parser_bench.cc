@@ -0,0 +1,93 @@
+#include <iostream>
+#include <string>
+#include <chrono>
+#include <stdlib.h>
+#include "httpparser.h"
+#include "http_scan.h"
+
+/*
+ 请求解析开销：http_parser 与快速解析(逐字节、SSE4.2、AVX2 扫描)对比
+ 每次 Parse 16 个流水线请求，包含构造 HttpRequest 的开销，不经过 HttpSession
+ 用法: http_parser_bench [轮数]
+ */
+
+using namespace cweb::httpserver;
+
+static const int kPipeline = 16;
+
+static const char* kBrowserRequest =
+    "GET /api/v1/users/10086/orders?page=2&size=20&sort=created_at HTTP/1.1\r\n"
+    "Host: www.example.com\r\n"
+    "Connection: keep-alive\r\n"
+    "sec-ch-ua: \"Chromium\";v=\"118\", \"Google Chrome\";v=\"118\", \"Not=A?Brand\";v=\"99\"\r\n"
+    "sec-ch-ua-mobile: ?0\r\n"
+    "sec-ch-ua-platform: \"macOS\"\r\n"
+    "Upgrade-Insecure-Requests: 1\r\n"
+    "User-Agent: Mozilla/5.0 (Macintosh; Intel Mac OS X 10_15_7) AppleWebKit/537.36 (KHTML, like Gecko) Chrome/118.0.0.0 Safari/537.36\r\n"
+    "Accept: text/html,application/xhtml+xml,application/xml;q=0.9,image/avif,image/webp,image/apng,*/*;q=0.8\r\n"
+    "Sec-Fetch-Site: same-origin\r\n"
+    "Sec-Fetch-Mode: navigate\r\n"
+    "Sec-Fetch-Dest: document\r\n"
+    "Referer: https://www.example.com/account/orders\r\n"
+    "Accept-Encoding: gzip, deflate, br\r\n"
+    "Accept-Language: zh-CN,zh;q=0.9,en;q=0.8\r\n"
+    "Cookie: session_id=6f1e2d3c4b5a69788796a5b4c3d2e1f0; theme=dark; _ga=GA1.2.1234567890.1697000000; _gid=GA1.2.987654321.1697000000\r\n"
+    "\r\n";
+
+static const char* kApiRequest =
+    "POST /api/sayhi HTTP/1.1\r\n"
+    "Host: 127.0.0.1:8080\r\n"
+    "User-Agent: okhttp/4.11.0\r\n"
+    "Content-Type: application/json\r\n"
+    "Accept: */*\r\n"
+    "Content-Length: 45\r\n"
+    "\r\n"
+    "{\"name\": \"John\",\"age\": 30,\"city\": \"New York\"}";
+
+static const char* kMinimalRequest =
+    "GET /api/sayhi HTTP/1.1\r\n"
+    "Host: 127.0.0.1:8080\r\n"
+    "User-Agent: curl/8.1.2\r\n"
+    "Accept: */*\r\n"
+    "\r\n";
+
+static void run(const char* name, const char* request, size_t rounds) {
+    std::string data;
+    for(int i = 0; i < kPipeline; ++i) {
+        data += request;
+    }
+    std::cout << name << " (" << data.size() / kPipeline << " bytes/request)" << std::endl;
+
+    for(int mode = 0; mode < 4; ++mode) {
+        bool fast = mode > 0;
+        const char* impl = "http_parser";
+        if(fast) {
+            HttpScanImpl selected = SetHttpScanImpl((HttpScanImpl)(mode - 1));
+            if(selected != (HttpScanImpl)(mode - 1)) continue;
+            impl = HttpScanImplName(selected);
+        }
+        //没有回调，解析完成的请求直接释放
+        HttpParser parser(nullptr, fast);
+        size_t consumed = 0;
+        auto start = std::chrono::steady_clock::now();
+        for(size_t i = 0; i < rounds; ++i) {
+            parser.Parse(data.data(), data.size(), consumed);
+            if(consumed != data.size()) {
+                std::cout << "parse error" << std::endl;
+                exit(1);
+            }
+        }
+        double ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+        double per_request = ns / (rounds * kPipeline);
+        std::cout << "  " << (fast ? "fast/" : "") << impl << ": " << per_request << " ns/request, "
+                  << data.size() * rounds / (ns / 1e9) / (1 << 20) << " MB/s" << std::endl;
+    }
+}
+
+int main(int argc, char** argv) {
+    size_t rounds = argc > 1 ? strtoul(argv[1], NULL, 10) : 20000;
+    run("browser GET", kBrowserRequest, rounds);
+    run("api POST", kApiRequest, rounds);
+    run("minimal GET", kMinimalRequest, rounds);
+    return 0;
+}
@@ -0,0 +1,154 @@
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include "httpparser.h"
+#include "httprequest.h"
+#include "http_scan.h"
+#include "tcpconnection.h"
+
+/*
+ 快速解析与 http_parser 的差分测试：
+ 随机生成的流水线请求(含不规范的、分块的、折叠的 header 等由快速解析转交 http_parser 的请求)按随机长度分段输入，
+ 逐字节、SSE4.2、AVX2 三种扫描实现下两种解析得到的请求必须一致
+ 用法: http_parser_test [轮数]
+ */
+
+using namespace cweb;
+using namespace cweb::httpserver;
+
+static std::string randomString(const char* alphabet, int n) {
+    std::string s;
+    int size = (int)strlen(alphabet);
+    for(int i = 0; i < n; ++i) {
+        s += alphabet[rand() % size];
+    }
+    return s;
+}
+
+static std::string randomRequest() {
+    static const char* methods[] = {"GET", "POST", "PUT", "DELETE", "HEAD"};
+    static const char* names[] = {"Host", "User-Agent", "Accept", "Accept-Encoding", "Cookie", "X-Custom-Header-Name-Long", "connection", "Content-Type", "Referer"};
+    std::string r = methods[rand() % 5];
+    r += " /" + randomString("abcxyz/._-", rand() % 40);
+    if(rand() % 2) {
+        r += "?a=" + randomString("0123abc", rand() % 5) + "&b=2";
+    }
+    r += std::string(" HTTP/1.") + (rand() % 4 ? "1" : "0") + (rand() % 5 ? "\r\n" : "\n");
+
+    int count = rand() % 12;
+    for(int i = 0; i < count; ++i) {
+        std::string name = names[rand() % 9];
+        if(name == "connection") {
+            r += name + ":" + (rand() % 2 ? " keep-alive" : " close, foo") + "\r\n";
+            continue;
+        }
+        //值前后带随机的空白
+        r += name + ":" + std::string(rand() % 3, ' ') + randomString("abcdefghijklmnopqrstuvwxyz0123456789 ;=,/.\t", rand() % 120)
+            + std::string(rand() % 2, ' ') + std::string(rand() % 2, '\t') + (rand() % 6 ? "\r\n" : "\n");
+    }
+
+    int kind = rand() % 20;
+    if(kind == 0) {
+        return r + "Transfer-Encoding: chunked\r\n\r\n3\r\nabc\r\n0\r\n\r\n";
+    }
+    if(kind == 1) r += "Bad Header: x\r\n";
+    if(kind == 2) r += "X-Fold: a\r\n  b\r\n";
+    std::string body = rand() % 3 == 0 ? randomString("bodyBODY{}\":,", rand() % 100) : "";
+    if(body.size() || rand() % 4 == 0) {
+        r += "Content-Length: " + std::to_string(body.size()) + "\r\n";
+    }
+    r += "\r\n" + body;
+    return r;
+}
+
+static std::string describe(HttpParser& parser, HttpRequest& request) {
+    request.ParseBody();
+    std::ostringstream out;
+    out << request.Method() << "|" << request.Url().ToString() << "|" << request.Path()
+        << "|v" << parser.CheckVersion(1, 1) << "|ka" << parser.KeepAlive() << "|";
+    for(size_t i = 0; i < request.HeaderCount(); ++i) {
+        out << request.HeaderName(i).ToString() << "=" << request.HeaderValue(i).ToString() << ";";
+    }
+    const BinaryData& body = request.BinaryValue();
+    out << "|host=" << request.Header(HeaderHost).ToString() << "|q=" << request.Query("a").ToString()
+        << "|body=" << std::string(body.data ? body.data : "", body.size);
+    return out.str();
+}
+
+//未消费的数据留在缓冲区与后续数据一起解析，chunk 为 0 时一次输入，否则每段随机 1~chunk 字节
+static bool parse(bool fast, const std::string& data, size_t chunk, std::vector<std::string>& out) {
+    HttpParser* current = nullptr;
+    HttpParser parser([&](std::unique_ptr<HttpRequest> request) {
+        out.push_back(describe(*current, *request));
+    }, fast);
+    current = &parser;
+
+    std::string buffer;
+    size_t fed = 0;
+    while(fed < data.size()) {
+        size_t n = chunk ? std::min<size_t>(rand() % chunk + 1, data.size() - fed) : data.size();
+        buffer.append(data, fed, n);
+        fed += n;
+        size_t consumed = 0;
+        if((TcpConnection::MessageState)parser.Parse(buffer.data(), buffer.size(), consumed) == TcpConnection::BAD) {
+            return false;
+        }
+        buffer.erase(0, consumed);
+    }
+    return true;
+}
+
+//不保持连接的请求之后 HttpSession 不再解析，之后的结果不比较
+static bool truncateAtClose(std::vector<std::string>& results) {
+    for(size_t i = 0; i < results.size(); ++i) {
+        if(results[i].find("|ka0|") != std::string::npos) {
+            results.resize(i + 1);
+            return true;
+        }
+    }
+    return false;
+}
+
+int main(int argc, char** argv) {
+    int rounds = argc > 1 ? atoi(argv[1]) : 20000;
+    srand(11);
+    for(int impl = 0; impl < 3; ++impl) {
+        HttpScanImpl selected = SetHttpScanImpl((HttpScanImpl)impl);
+        if(selected != (HttpScanImpl)impl) {
+            std::cout << "skip unsupported scan impl " << impl << std::endl;
+            continue;
+        }
+        for(int i = 0; i < rounds; ++i) {
+            std::string data;
+            int count = rand() % 4 + 1;
+            for(int j = 0; j < count; ++j) {
+                data += randomRequest();
+            }
+            size_t chunk = rand() % 3 ? rand() % 64 : 0;
+            std::vector<std::string> expected, actual;
+            unsigned int seed = rand();
+            srand(seed);
+            bool ok1 = parse(false, data, chunk, expected);
+            srand(seed);
+            bool ok2 = parse(true, data, chunk, actual);
+            bool closed1 = truncateAtClose(expected);
+            bool closed2 = truncateAtClose(actual);
+            if(closed1 || closed2) ok1 = ok2 = true;
+            if(ok1 != ok2 || expected != actual) {
+                std::cout << "mismatch, scan " << HttpScanImplName(selected) << ", chunk " << chunk << "\n" << data << std::endl;
+                for(size_t j = 0; j < std::max(expected.size(), actual.size()); ++j) {
+                    std::cout << (j < expected.size() ? expected[j] : "-") << "\n" << (j < actual.size() ? actual[j] : "-") << "\n" << std::endl;
+                }
+                assert(false);
+                return 1;
+            }
+        }
+        std::cout << HttpScanImplName(selected) << " ok" << std::endl;
+    }
+    return 0;
+}
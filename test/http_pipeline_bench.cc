@@ -0,0 +1,116 @@
+#include <iostream>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <thread>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include "httpserver.h"
+#include "httpsession.h"
+#include "eventloop.h"
+
+/*
+ HTTP/1.1 pipelining 吞吐：同一进程内的客户端每轮在每个连接上发送 depth 个请求，读完全部响应后再发下一轮
+ 服务端 1 个 I/O 线程，响应 13 字节的 plaintext
+ 用法: http_pipeline_bench [秒数]
+ */
+
+using namespace cweb;
+using namespace cweb::httpserver;
+
+static const char* kRequest = "GET /plaintext HTTP/1.1\r\nHost: localhost\r\nUser-Agent: bench\r\nAccept: */*\r\n\r\n";
+static const char* kBody = "Hello, World!";
+//低于 HttpConfig::max_keepalive_requests，到达后换新连接
+static const int kRequestsPerConnection = 992;
+
+static int port = 20000 + getpid() % 20000;
+
+static void reconnect(std::vector<int>& fds, int conns) {
+    for(int fd : fds) close(fd);
+    fds.clear();
+    for(int i = 0; i < conns; ++i) {
+        int fd = socket(AF_INET, SOCK_STREAM, 0);
+        sockaddr_in addr = {};
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(port);
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        if(connect(fd, (sockaddr*)&addr, sizeof(addr)) != 0) {
+            std::cout << "connect error" << std::endl;
+            _exit(1);
+        }
+        int on = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+        fds.push_back(fd);
+    }
+}
+
+static void run(int depth, int conns, int seconds) {
+    std::string batch;
+    for(int i = 0; i < depth; ++i) batch += kRequest;
+    std::vector<int> fds;
+    reconnect(fds, conns);
+    int on_connection = 0;
+    size_t total = 0;
+    char buf[65536];
+    auto start = std::chrono::steady_clock::now();
+    while(std::chrono::steady_clock::now() - start < std::chrono::seconds(seconds)) {
+        if(on_connection + depth > kRequestsPerConnection) {
+            reconnect(fds, conns);
+            on_connection = 0;
+        }
+        on_connection += depth;
+        for(int fd : fds) {
+            send(fd, batch.data(), batch.size(), 0);
+        }
+        for(int fd : fds) {
+            //响应以 body 结尾，数出 body 的个数
+            std::string received;
+            int responses = 0;
+            while(responses < depth) {
+                ssize_t n = recv(fd, buf, sizeof(buf), 0);
+                if(n <= 0) {
+                    std::cout << "recv error" << std::endl;
+                    _exit(1);
+                }
+                received.append(buf, n);
+                responses = 0;
+                for(size_t pos = received.find(kBody); pos != std::string::npos; pos = received.find(kBody, pos + 1)) {
+                    ++responses;
+                }
+            }
+        }
+        total += depth * conns;
+    }
+    double s = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count() / 1e6;
+    std::cout << "depth " << depth << ", " << conns << " connections: " << (size_t)(total / s) << " requests/s" << std::endl;
+    for(int fd : fds) close(fd);
+}
+
+int main(int argc, char** argv) {
+    int seconds = argc > 1 ? atoi(argv[1]) : 3;
+    std::shared_ptr<EventLoop> loop(new EventLoop());
+    HttpServer server(loop, "127.0.0.1", port);
+    server.SetRequestCallback([](std::shared_ptr<HttpSession> session, std::unique_ptr<HttpRequest> request) {
+        uint64_t seq = request->Sequence();
+        session->SendString(StatusOK, kBody, seq);
+        session->FinishResponse(seq);
+    });
+    std::thread t([&]() {
+        server.Start(1);
+        loop->Run();
+    });
+    //server 的线程不退出
+    t.detach();
+    sleep(1);
+
+    for(int conns : {1, 16}) {
+        for(int depth : {1, 16}) {
+            run(depth, conns, seconds);
+        }
+    }
+    std::cout.flush();
+    _exit(0);
+}
@@ -0,0 +1,211 @@
+#include <iostream>
+#include <string>
+#include <vector>
+#include <atomic>
+#include <thread>
+#include <assert.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include "httpparser.h"
+#include "httprequest.h"
+#include "httpserver.h"
+#include "httpsession.h"
+#include "eventloop.h"
+
+/*
+ HTTP/1.1 pipelining：
+ 1. 解析器：流水线请求、在每个字节处切开的请求、升级请求后的多余数据，检查 consumed 与 ReadingHeaders/InMessage
+ 2. 会话：一次读到的一批请求，响应合并为一次 writev
+ 会话部分替换了 readv/writev 计数，需使用线程模式(非 COROUTINE)构建，协程版的 hook 也定义了这两个函数
+ */
+
+using namespace cweb;
+using namespace cweb::httpserver;
+
+static std::atomic<int> readv_calls(0);
+static std::atomic<int> writev_calls(0);
+
+extern "C" ssize_t readv(int fd, const struct iovec* iov, int iovcnt) {
+    ssize_t n = syscall(SYS_readv, fd, iov, iovcnt);
+    if(n > 0) ++readv_calls;
+    return n;
+}
+
+extern "C" ssize_t writev(int fd, const struct iovec* iov, int iovcnt) {
+    ++writev_calls;
+    return syscall(SYS_writev, fd, iov, iovcnt);
+}
+
+struct Message {
+    size_t begin;       //请求开始的位置
+    size_t head_end;    //请求头结束(空行之后)的位置
+    size_t end;
+};
+
+static void appendRequest(std::string& data, std::vector<Message>& messages, const std::string& head, const std::string& body) {
+    Message m;
+    m.begin = data.size();
+    data += head;
+    m.head_end = data.size();
+    data += body;
+    m.end = data.size();
+    messages.push_back(m);
+}
+
+//未消费的数据留在缓冲区，与下一段数据一起再次解析，与 HttpSession 的输入缓冲区一致
+static void testSplit(bool fast, const std::string& data, const std::vector<Message>& messages) {
+    for(size_t k = 1; k < data.size(); ++k) {
+        std::vector<std::string> urls;
+        HttpParser parser([&urls](std::unique_ptr<HttpRequest> request) {
+            urls.push_back(request->Url().ToString());
+        }, fast);
+
+        size_t consumed = 0;
+        assert((TcpConnection::MessageState)parser.Parse(data.data(), k, consumed) != TcpConnection::BAD);
+        assert(consumed <= k);
+        size_t done = 0;
+        bool reading_headers = false, in_message = false;
+        for(const Message& m : messages) {
+            if(m.end <= k) ++done;
+            if(m.begin < k && k < m.head_end) reading_headers = true;
+            if(m.begin < k && k < m.end) in_message = true;
+        }
+        assert(urls.size() == done);
+        assert(parser.ReadingHeaders() == reading_headers);
+        assert(parser.InMessage() == in_message);
+
+        std::string rest = data.substr(consumed);
+        assert((TcpConnection::MessageState)parser.Parse(rest.data(), rest.size(), consumed) != TcpConnection::BAD);
+        assert(consumed == rest.size());
+        assert(urls.size() == messages.size());
+        assert(!parser.ReadingHeaders() && !parser.InMessage());
+        for(size_t i = 0; i < urls.size(); ++i) {
+            assert(urls[i] == "/" + std::to_string(i));
+        }
+    }
+}
+
+static void testParser(bool fast) {
+    std::string data;
+    std::vector<Message> messages;
+    appendRequest(data, messages, "GET /0 HTTP/1.1\r\nHost: x\r\n\r\n", "");
+    appendRequest(data, messages, "POST /1 HTTP/1.1\r\nHost: x\r\nContent-Length: 5\r\n\r\n", "hello");
+    appendRequest(data, messages, "GET /2 HTTP/1.1\r\nHost: x\r\nAccept: */*\r\n\r\n", "");
+
+    //一次读到全部请求
+    std::vector<std::string> bodies;
+    HttpParser parser([&bodies](std::unique_ptr<HttpRequest> request) {
+        request->ParseBody();
+        const BinaryData& body = request->BinaryValue();
+        bodies.push_back(body.data ? std::string(body.data, body.size) : "");
+    }, fast);
+    size_t consumed = 0;
+    assert((TcpConnection::MessageState)parser.Parse(data.data(), data.size(), consumed) != TcpConnection::BAD);
+    assert(consumed == data.size());
+    assert(bodies.size() == 3 && bodies[1] == "hello");
+    assert(!parser.ReadingHeaders() && !parser.InMessage());
+
+    testSplit(fast, data, messages);
+
+    //升级请求之后的数据属于新协议，不被消费
+    std::string upgrade = "GET /ws HTTP/1.1\r\nHost: x\r\nConnection: Upgrade\r\nUpgrade: websocket\r\n\r\n";
+    std::string frame = "\x81\x05hello";
+    std::string input = upgrade + frame;
+    int count = 0;
+    HttpParser upgrade_parser([&count](std::unique_ptr<HttpRequest> request) {
+        ++count;
+    }, fast);
+    assert((TcpConnection::MessageState)upgrade_parser.Parse(input.data(), input.size(), consumed) != TcpConnection::BAD);
+    assert(count == 1);
+    assert(upgrade_parser.IsUpgrade());
+    assert(consumed == upgrade.size());
+}
+
+static int connectTo(int port) {
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if(connect(fd, (sockaddr*)&addr, sizeof(addr)) != 0) {
+        return -1;
+    }
+    return fd;
+}
+
+static std::string readAll(int fd) {
+    std::string out;
+    char buf[65536];
+    ssize_t n;
+    while((n = recv(fd, buf, sizeof(buf), 0)) > 0) {
+        out.append(buf, n);
+    }
+    return out;
+}
+
+static void testSession() {
+    int port = 20000 + getpid() % 20000;
+    std::shared_ptr<EventLoop> loop(new EventLoop());
+    HttpServer server(loop, "127.0.0.1", port);
+    server.SetRequestCallback([](std::shared_ptr<HttpSession> session, std::unique_ptr<HttpRequest> request) {
+        uint64_t seq = request->Sequence();
+        session->SendString(StatusOK, request->Url().ToString(), seq);
+        session->FinishResponse(seq);
+    });
+    std::thread t([&]() {
+        server.Start(1);
+        loop->Run();
+    });
+    //server 的线程不退出
+    t.detach();
+    sleep(1);
+
+    //16 个请求一次发送，按顺序响应，每批读到的请求只写一次
+    std::string requests;
+    for(int i = 0; i < 16; ++i) {
+        requests += "GET /" + std::to_string(i) + " HTTP/1.1\r\nHost: x\r\n";
+        requests += i == 15 ? "Connection: close\r\n\r\n" : "\r\n";
+    }
+    int fd = connectTo(port);
+    assert(fd >= 0);
+    int reads = readv_calls, writes = writev_calls;
+    send(fd, requests.data(), requests.size(), 0);
+    std::string out = readAll(fd);
+    close(fd);
+    size_t pos = 0;
+    for(int i = 0; i < 16; ++i) {
+        std::string body = "\r\n\r\n/" + std::to_string(i);
+        pos = out.find(body, pos);
+        assert(pos != std::string::npos);
+        pos += body.size();
+    }
+    std::cout << "pipeline reads: " << readv_calls - reads << " writes: " << writev_calls - writes << std::endl;
+    assert(writev_calls - writes <= readv_calls - reads);
+
+    //请求在请求头中间断开，前一段数据不产生响应
+    fd = connectTo(port);
+    assert(fd >= 0);
+    std::string split = "GET /split HTTP/1.1\r\nHost: x\r\nConnection: close\r\n\r\n";
+    writes = writev_calls;
+    send(fd, split.data(), 20, 0);
+    usleep(100 * 1000);
+    assert(writev_calls == writes);
+    send(fd, split.data() + 20, split.size() - 20, 0);
+    out = readAll(fd);
+    close(fd);
+    assert(out.find("\r\n\r\n/split") != std::string::npos);
+    assert(writev_calls - writes == 1);
+}
+
+int main() {
+    testParser(false);
+    testParser(true);
+    std::cout << "parser ok" << std::endl;
+    testSession();
+    std::cout << "session ok" << std::endl;
+    std::cout.flush();
+    _exit(0);
+}
@@ -0,0 +1,64 @@
+#include <iostream>
+#include <thread>
+#include <vector>
+#include <atomic>
+#include <assert.h>
+#include "work_stealing_deque.h"
+
+using namespace cweb::util;
+
+static const int kItems = 1000000;
+
+int main() {
+    WorkStealingDeque<int> deque(256);
+    std::vector<int> items(kItems);
+    std::vector<std::atomic<int>> taken(kItems);
+    for(int i = 0; i < kItems; ++i) {
+        items[i] = i;
+        taken[i].store(0);
+    }
+
+    std::atomic<bool> done = {false};
+    std::atomic<int> stolen = {0};
+    std::vector<std::thread> thieves;
+    for(int t = 0; t < 3; ++t) {
+        thieves.push_back(std::thread([&](){
+            while(!done.load() || !deque.Empty()) {
+                int* val = deque.Steal();
+                if(val) {
+                    taken[*val].fetch_add(1);
+                    stolen.fetch_add(1);
+                }
+            }
+        }));
+    }
+
+    //所属线程压入，满了就自己弹出一部分
+    int popped = 0;
+    for(int i = 0; i < kItems; ++i) {
+        while(!deque.Push(&items[i])) {
+            int* val = deque.Pop();
+            if(val) {
+                taken[*val].fetch_add(1);
+                ++popped;
+            }
+        }
+    }
+    int* val;
+    while((val = deque.Pop()) != nullptr) {
+        taken[*val].fetch_add(1);
+        ++popped;
+    }
+    done.store(true);
+    for(std::thread& t : thieves) t.join();
+
+    //每个元素恰好被取出一次
+    for(int i = 0; i < kItems; ++i) {
+        assert(taken[i].load() == 1);
+    }
+    assert(popped + stolen.load() == kItems);
+
+    std::cout << "popped: " << popped << " stolen: " << stolen.load() << std::endl;
+    std::cout << "work stealing deque test passed" << std::endl;
+    return 0;
+}